@@ -25,25 +25,107 @@ SOFTWARE.
 #define SCOPEDMUTEX_H
 
 #include <Arduino.h>
+#include <esp_timer.h>
 #include <freertos/semphr.h>
 
+#include "runtimeMetrics.h"
+
+#ifndef MUTEX_PROFILING
+#define MUTEX_PROFILING false
+#endif
+
+#if MUTEX_PROFILING
+#include "mutexProfiler.h"
+#endif
+
 class ScopedMutex
 {
 private:
     SemaphoreHandle_t &mutex;
     bool locked;
+#if MUTEX_PROFILING
+    lockSite_t *site;
+    int64_t lockedUs = 0;
+#endif
+
+    /* uncontended takes of a tracked mutex cost one extra atomic add */
+    static bool take(SemaphoreHandle_t mutex, TickType_t timeout)
+    {
+        mutexMetrics_t *metrics = metricsFor(mutex);
+        if (!metrics)
+            return xSemaphoreTake(mutex, timeout);
+
+        if (xSemaphoreTake(mutex, 0))
+        {
+            metrics->wait.record(0);
+            return true;
+        }
+
+        bool taken = false;
+        if (timeout)
+        {
+            const int64_t start = esp_timer_get_time();
+            taken = xSemaphoreTake(mutex, timeout);
+            const uint32_t waitUs = esp_timer_get_time() - start;
+            metrics->wait.record(waitUs);
+            taskPhases.lockWaitUs += waitUs;
+        }
+
+        if (!taken)
+            metrics->timeouts.fetch_add(1, std::memory_order_relaxed);
+        return taken;
+    }
 
 public:
+#if MUTEX_PROFILING
+    /* the default arguments capture the call site of every existing ScopedMutex */
+    explicit ScopedMutex(SemaphoreHandle_t &m, TickType_t timeout = portMAX_DELAY,
+                         const char *file = __builtin_FILE(), const int line = __builtin_LINE())
+        : mutex(m), locked(false), site(lockSiteFor(file, line, m))
+    {
+        checkLockOrder(mutex, site);
+
+        const int64_t start = esp_timer_get_time();
+        locked = take(mutex, timeout);
+        lockedUs = esp_timer_get_time();
+
+        if (locked)
+            pushHeldLock(mutex);
+
+        if (!site)
+            return;
+
+        const uint32_t waitUs = lockedUs - start;
+        site->waitTotalUs.fetch_add(waitUs, std::memory_order_relaxed);
+        raiseMax(site->waitMaxUs, waitUs);
+        if (locked)
+            site->acquired.fetch_add(1, std::memory_order_relaxed);
+        else
+            site->timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+#else
     explicit ScopedMutex(SemaphoreHandle_t &m, TickType_t timeout = portMAX_DELAY)
-        : mutex(m), locked(xSemaphoreTake(mutex, timeout)) {}
+        : mutex(m), locked(take(mutex, timeout)) {}
+#endif
 
     ScopedMutex(const ScopedMutex &) = delete;
     ScopedMutex &operator=(const ScopedMutex &) = delete;
 
     ~ScopedMutex()
     {
-        if (locked)
-            xSemaphoreGive(mutex);
+        if (!locked)
+            return;
+
+#if MUTEX_PROFILING
+        popHeldLock(mutex);
+        if (site)
+        {
+            const uint32_t holdUs = esp_timer_get_time() - lockedUs;
+            site->holdTotalUs.fetch_add(holdUs, std::memory_order_relaxed);
+            raiseMax(site->holdMaxUs, holdUs);
+        }
+#endif
+        xSemaphoreGive(mutex);
     }
 
     bool acquired() const { return locked; }
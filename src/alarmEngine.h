@@ -0,0 +1,279 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _ALARMENGINE_H_
+#define _ALARMENGINE_H_
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "channelConfig.h"
+
+static constexpr size_t MAX_ALARMS = 16;
+static constexpr size_t MAX_ALARM_NAME = 16;
+
+enum alarmSource : uint8_t
+{
+    SOURCE_TEMPERATURE,
+    SOURCE_HEAP,
+    SOURCE_RSSI,
+    SOURCE_JITTER,
+    SOURCE_CHANNEL, /* one sample per channel from here */
+};
+
+static constexpr size_t NUMBER_OF_ALARM_SAMPLES = SOURCE_CHANNEL + MAX_CHANNELS;
+static constexpr const char *ALARM_SOURCE_NAME[] = {"temperature", "heap", "rssi", "jitter", "channel"};
+
+enum alarmCheck : uint8_t
+{
+    CHECK_ABOVE,
+    CHECK_BELOW,
+    CHECK_RATE,  /* change per minute, either way */
+    CHECK_STALE, /* seconds without a new sample */
+};
+
+static constexpr const char *ALARM_CHECK_NAME[] = {"above", "below", "rate", "stale"};
+
+struct alarmRule_t
+{
+    char name[MAX_ALARM_NAME];
+    uint8_t sample; /* alarmSource, plus the channel for SOURCE_CHANNEL */
+    alarmCheck check;
+    float limit;
+    float hysteresis; /* how far back past the limit before the alarm clears */
+};
+
+/* the latest value of a source - updatedUs changes with every new sample and is 0 while there is none */
+struct alarmSample_t
+{
+    float value;
+    int64_t updatedUs;
+};
+
+struct alarmState_t
+{
+    bool active;
+    bool notified; /* the state the last notification reported */
+    float value;   /* what the check looked at - the sample, the rate or the age in seconds */
+    int64_t changedUs;
+    int64_t notifiedUs;
+    int64_t seenUs; /* updatedUs of the last sample that was checked */
+    float previousValue;
+    uint32_t raised;
+};
+
+struct alarmEvent_t
+{
+    uint8_t index;
+    bool active;
+    float value;
+    int64_t atUs;
+};
+
+/*
+    A fixed table of rules, each checked once per evaluate() against the newest sample of its source.
+    A rule only looks at a sample once, so a value that is polled faster than it changes is not counted twice.
+    A notification goes out when an alarm differs from what was last reported and the last report is at least
+    holdoff old - an alarm that flaps within the holdoff is reported once, in the state it ends up in.
+    No allocations and at most MAX_ALARMS events per evaluate().
+*/
+class alarmEngine
+{
+public:
+    void setRules(const alarmRule_t *rules, const size_t count, const uint32_t holdoffSec, const int64_t nowUs)
+    {
+        ruleCount = count < MAX_ALARMS ? count : MAX_ALARMS;
+        for (size_t i = 0; i < ruleCount; i++)
+        {
+            rule[i] = rules[i];
+            state[i] = {};
+            state[i].changedUs = nowUs;
+        }
+        holdoffUs = int64_t(holdoffSec) * 1000000;
+        startedUs = nowUs;
+    }
+
+    /* returns the number of events written to event */
+    size_t evaluate(const alarmSample_t *sample, const int64_t nowUs, alarmEvent_t *event)
+    {
+        size_t events = 0;
+        for (size_t i = 0; i < ruleCount; i++)
+        {
+            const alarmRule_t &r = rule[i];
+            alarmState_t &s = state[i];
+            const alarmSample_t &newest = sample[r.sample];
+
+            if (r.check == CHECK_STALE)
+            {
+                s.value = (nowUs - (newest.updatedUs ? newest.updatedUs : startedUs)) / 1e6f;
+                setActive(s, s.active ? s.value > r.limit - r.hysteresis : s.value > r.limit, nowUs);
+            }
+            else if (newest.updatedUs && newest.updatedUs != s.seenUs)
+            {
+                const int64_t previousUs = s.seenUs;
+                s.seenUs = newest.updatedUs;
+
+                if (r.check == CHECK_RATE)
+                {
+                    if (previousUs && newest.updatedUs > previousUs)
+                    {
+                        s.value = fabsf(newest.value - s.previousValue) * 60e6f / (newest.updatedUs - previousUs);
+                        setActive(s, s.active ? s.value > r.limit - r.hysteresis : s.value > r.limit, nowUs);
+                    }
+                    s.previousValue = newest.value;
+                }
+                else
+                {
+                    s.value = newest.value;
+                    if (r.check == CHECK_ABOVE)
+                        setActive(s, s.active ? s.value > r.limit - r.hysteresis : s.value > r.limit, nowUs);
+                    else
+                        setActive(s, s.active ? s.value < r.limit + r.hysteresis : s.value < r.limit, nowUs);
+                }
+            }
+
+            if (s.active != s.notified && (!s.notifiedUs || nowUs - s.notifiedUs >= holdoffUs))
+            {
+                s.notified = s.active;
+                s.notifiedUs = nowUs;
+                event[events++] = {uint8_t(i), s.active, s.value, nowUs};
+            }
+        }
+        return events;
+    }
+
+    size_t size() const { return ruleCount; }
+    const alarmRule_t &ruleAt(const size_t index) const { return rule[index]; }
+    const alarmState_t &stateAt(const size_t index) const { return state[index]; }
+
+private:
+    alarmRule_t rule[MAX_ALARMS];
+    alarmState_t state[MAX_ALARMS];
+    size_t ruleCount = 0;
+    int64_t holdoffUs = 0;
+    int64_t startedUs = 0;
+
+    static void setActive(alarmState_t &s, const bool active, const int64_t nowUs)
+    {
+        if (active == s.active)
+            return;
+
+        s.active = active;
+        s.changedUs = nowUs;
+        if (active)
+            s.raised++;
+    }
+};
+
+static constexpr size_t MAX_WEBHOOK_URL = 96;
+
+/* what /api/alarms shows - published by alarmTask after every evaluation */
+struct alarmStatus_t
+{
+    size_t count;
+    alarmRule_t rule[MAX_ALARMS];
+    alarmState_t state[MAX_ALARMS];
+    char webhook[MAX_WEBHOOK_URL]; /* empty without a webhook */
+    uint32_t holdoffSec;
+    size_t pending;
+    uint32_t backoffMs;
+    uint32_t delivered;
+    uint32_t failures;
+    uint32_t dropped;
+};
+
+/* the temperatures alarms trip at - sensorTask samples faster near these */
+struct temperatureLimits_t
+{
+    size_t count;
+    float value[MAX_ALARMS];
+};
+
+/* 'temperature' or 'channel3' */
+static inline int formatAlarmSource(char *str, const size_t size, const uint8_t sample)
+{
+    if (sample < SOURCE_CHANNEL)
+        return snprintf(str, size, "%s", ALARM_SOURCE_NAME[sample]);
+    return snprintf(str, size, "%s%u", ALARM_SOURCE_NAME[SOURCE_CHANNEL], unsigned(sample - SOURCE_CHANNEL));
+}
+
+/*
+    Events waiting for the webhook, the oldest is dropped when full.
+    After a failed delivery the next attempt waits twice as long as the one before, up to MAX_BACKOFF_MS.
+    Deliveries are at least MIN_INTERVAL_MS apart, also when they succeed.
+*/
+class webhookQueue
+{
+public:
+    static constexpr size_t CAPACITY = 8;
+    static constexpr uint32_t MIN_INTERVAL_MS = 2000;
+    static constexpr uint32_t FIRST_BACKOFF_MS = 5000;
+    static constexpr uint32_t MAX_BACKOFF_MS = 10 * 60 * 1000;
+
+    void push(const alarmEvent_t &event)
+    {
+        if (count == CAPACITY)
+        {
+            head = (head + 1) % CAPACITY;
+            count--;
+            dropped++;
+        }
+        item[(head + count++) % CAPACITY] = event;
+    }
+
+    /* the event to deliver now - nullptr when there is none or it is too early */
+    const alarmEvent_t *due(const int64_t nowUs) const { return count && nowUs >= nextUs ? &item[head] : nullptr; }
+
+    void delivered(const int64_t nowUs)
+    {
+        head = (head + 1) % CAPACITY;
+        count--;
+        backoffMs = 0;
+        nextUs = nowUs + MIN_INTERVAL_MS * 1000LL;
+    }
+
+    void failed(const int64_t nowUs)
+    {
+        backoffMs = !backoffMs ? FIRST_BACKOFF_MS : backoffMs * 2 < MAX_BACKOFF_MS ? backoffMs * 2 : MAX_BACKOFF_MS;
+        nextUs = nowUs + backoffMs * 1000LL;
+        failures++;
+    }
+
+    void clear() { count = head = 0; }
+
+    size_t pending() const { return count; }
+    uint32_t backoff() const { return backoffMs; }
+    uint32_t failures = 0;
+    uint32_t dropped = 0;
+
+private:
+    alarmEvent_t item[CAPACITY];
+    size_t head = 0;
+    size_t count = 0;
+    uint32_t backoffMs = 0;
+    int64_t nextUs = 0;
+};
+
+#endif
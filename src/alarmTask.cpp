@@ -0,0 +1,394 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "alarmTask.hpp"
+
+struct alarmConfig_t
+{
+    alarmRule_t rule[MAX_ALARMS];
+    size_t count;
+    uint32_t holdoffSec;
+    char webhook[MAX_WEBHOOK_URL];
+};
+
+static bool validAlarmName(const char *name)
+{
+    const size_t length = strlen(name);
+    if (!length || length >= MAX_ALARM_NAME)
+        return false;
+
+    for (const char *p = name; *p; p++)
+        if (!isalnum(*p) && *p != '-' && *p != '_')
+            return false;
+
+    return true;
+}
+
+/* 'temperature', 'heap', 'rssi', 'jitter' or 'channel0' to 'channel15' - false when unknown */
+static bool parseAlarmSource(const char *str, uint8_t &sample)
+{
+    for (uint8_t source = 0; source < SOURCE_CHANNEL; source++)
+        if (!strcmp(str, ALARM_SOURCE_NAME[source]))
+        {
+            sample = source;
+            return true;
+        }
+
+    const size_t length = strlen(ALARM_SOURCE_NAME[SOURCE_CHANNEL]);
+    if (strncmp(str, ALARM_SOURCE_NAME[SOURCE_CHANNEL], length) || !isdigit(str[length]))
+        return false;
+
+    const int index = atoi(str + length);
+    if (index >= channelConfig.count)
+        return false;
+
+    sample = SOURCE_CHANNEL + index;
+    return true;
+}
+
+/*
+    One alarm per line - name=source check limit[,hysteresis]
+    hot=temperature above 28,0.3        °C
+    heating=temperature rate 0.5        °C per minute, either way
+    sensor=temperature stale 60         seconds without a reading
+    lowheap=heap below 20000,5000       bytes
+    wifi=rssi below -80,5               dBm
+    jitter=jitter above 2000,500        mean µs the dimmer wakes off its tick
+    dimmer=jitter stale 5               the dimmer stopped
+    blue=channel2 above 95              %
+
+    webhook=http://192.168.0.20:8080/aquarium
+    holdoff=300                         seconds between two notifications of one alarm
+*/
+static bool parseAlarmFile(File &file, alarmConfig_t &config, String &result)
+{
+    log_i("parsing '%s'", file.path());
+
+    int currentLine = 0;
+    while (file.available())
+    {
+        String line = file.readStringUntil('\n');
+        currentLine++;
+
+        const int comment = line.indexOf('#');
+        if (comment != -1)
+            line.remove(comment);
+
+        line.trim();
+        if (line.isEmpty())
+            continue;
+
+        const int sep = line.indexOf('=');
+        if (sep < 1)
+        {
+            result = "invalid line " + String(currentLine);
+            return false;
+        }
+
+        String key = line.substring(0, sep);
+        String value = line.substring(sep + 1);
+        key.trim();
+        value.trim();
+
+        if (key.equalsIgnoreCase("webhook"))
+        {
+            if (!value.startsWith("http://") || value.length() >= MAX_WEBHOOK_URL)
+            {
+                result = "webhook has to be a http:// url in line " + String(currentLine);
+                return false;
+            }
+            strlcpy(config.webhook, value.c_str(), sizeof(config.webhook));
+            continue;
+        }
+
+        if (key.equalsIgnoreCase("holdoff"))
+        {
+            const long seconds = value.toInt();
+            if (seconds < 0 || seconds > 86400)
+            {
+                result = "invalid holdoff in line " + String(currentLine);
+                return false;
+            }
+            config.holdoffSec = seconds;
+            continue;
+        }
+
+        if (config.count == MAX_ALARMS)
+        {
+            result = "more than " + String(MAX_ALARMS) + " alarms at line " + String(currentLine);
+            return false;
+        }
+
+        alarmRule_t &rule = config.rule[config.count];
+        rule = {};
+
+        char source[16], check[8];
+        const int fields = sscanf(value.c_str(), "%15s %7s %f,%f", source, check, &rule.limit, &rule.hysteresis);
+
+        int checkIndex = 0;
+        while (fields >= 3 && checkIndex <= CHECK_STALE && strcmp(check, ALARM_CHECK_NAME[checkIndex]))
+            checkIndex++;
+
+        if (!validAlarmName(key.c_str()) || fields < 3 || !parseAlarmSource(source, rule.sample) || checkIndex > CHECK_STALE ||
+            !isfinite(rule.limit) || !(rule.hysteresis >= 0))
+        {
+            result = "invalid alarm in line " + String(currentLine);
+            return false;
+        }
+
+        strlcpy(rule.name, key.c_str(), sizeof(rule.name));
+        rule.check = alarmCheck(checkIndex);
+        config.count++;
+    }
+
+    result = String(config.count) + " alarms";
+    return true;
+}
+
+static bool loadAlarms(alarmConfig_t &config, String &result)
+{
+    config = {};
+    config.holdoffSec = 300;
+
+    ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+    if (!lock.acquired())
+    {
+        result = "Mutex timeout";
+        return false;
+    }
+
+    phaseTimer storage(taskPhases.storageUs);
+    File file = SD.open(ALARM_FILE, FILE_READ);
+    if (!file)
+    {
+        result = "No alarms";
+        return true;
+    }
+
+    if (parseAlarmFile(file, config, result))
+        return true;
+
+    config.count = 0;
+    return false;
+}
+
+/* the newest value of every source - a source that has nothing new keeps its timestamp so it can go stale */
+static void sampleSources(alarmSample_t *sample, const int64_t nowUs)
+{
+    const sensorState_t sensor = sensorState.read();
+    if (sensor.valid)
+        sample[SOURCE_TEMPERATURE] = {sensor.temperature, sensor.updatedUs};
+
+    sample[SOURCE_HEAP] = {float(heap_caps_get_free_size(MALLOC_CAP_INTERNAL)), nowUs};
+
+    if (WiFi.isConnected())
+        sample[SOURCE_RSSI] = {float(WiFi.RSSI()), nowUs};
+
+    /* the mean wake deviation of the dimmer loops since the last sample */
+    static uint32_t lastLoops = 0;
+    static uint32_t lastJitterUs = 0;
+    const uint32_t loops = dimmerLoops.load(std::memory_order_relaxed);
+    const uint32_t jitterUs = dimmerLoopJitter.totalUs();
+    if (loops != lastLoops)
+    {
+        if (lastLoops)
+            sample[SOURCE_JITTER] = {float(jitterUs - lastJitterUs) / (loops - lastLoops), nowUs};
+        lastLoops = loops;
+        lastJitterUs = jitterUs;
+    }
+
+    static lightState_t light; /* keeps the snapshot off the task stack */
+    lightState.read(light);
+    if (light.updatedUs)
+        for (int i = 0; i < light.count; i++)
+            sample[SOURCE_CHANNEL + i] = {light.level[i], light.updatedUs};
+}
+
+static void notify(const alarmEngine &engine, const alarmEvent_t &event, webhookQueue &webhook, const bool haveWebhook)
+{
+    const alarmRule_t &rule = engine.ruleAt(event.index);
+    if (event.active)
+        log_w("alarm '%s' raised at %.2f", rule.name, event.value);
+    else
+        log_i("alarm '%s' cleared at %.2f", rule.name, event.value);
+
+    websocketMessage msg;
+    msg.type = ALARM_UPDATE;
+    msg.count = 3;
+    msg.value[0] = event.index;
+    msg.value[1] = event.active;
+    msg.value[2] = event.value;
+    alarmToWebsocket.push(msg);
+
+    if (haveWebhook)
+        webhook.push(event);
+}
+
+#ifndef HEADLESS_BUILD
+/* the names of the active alarms over the temperature - an empty banner gives the temperature back */
+static void showBanner(const alarmEngine &engine)
+{
+    static char shown[sizeof(lcdTextMessage_t::str)] = "";
+
+    char banner[sizeof(lcdTextMessage_t::str)] = "";
+    size_t length = 0;
+    for (size_t i = 0; i < engine.size() && length < sizeof(banner); i++)
+        if (engine.stateAt(i).active)
+            length += snprintf(banner + length, sizeof(banner) - length, length ? " %s" : "ALARM %s", engine.ruleAt(i).name);
+
+    if (strcmp(banner, shown))
+    {
+        strlcpy(shown, banner, sizeof(shown));
+        textOnLcd(ALARM_BANNER, banner);
+    }
+}
+#endif
+
+/* at most one POST per call - the queue spaces them out and backs off while the endpoint fails */
+static void deliverWebhook(const alarmConfig_t &config, const alarmEngine &engine, webhookQueue &queue, uint32_t &delivered)
+{
+    const alarmEvent_t *event = queue.due(esp_timer_get_time());
+    if (!event)
+        return;
+
+    if (!WiFi.isConnected())
+    {
+        queue.failed(esp_timer_get_time());
+        return;
+    }
+
+    const alarmRule_t &rule = engine.ruleAt(event->index);
+    char source[24];
+    formatAlarmSource(source, sizeof(source), rule.sample);
+
+    char body[160];
+    const int length = snprintf(body, sizeof(body), "alarm=%s\nstate=%s\nsource=%s\ncheck=%s\nlimit=%.2f\nvalue=%.2f\nuptime=%lli\n",
+                                rule.name, event->active ? "raised" : "cleared", source, ALARM_CHECK_NAME[rule.check], rule.limit,
+                                event->value, (long long)(event->atUs / 1000000));
+
+    HTTPClient http;
+    http.setConnectTimeout(WEBHOOK_TIMEOUT_MS);
+    http.setTimeout(WEBHOOK_TIMEOUT_MS);
+    int code = -1;
+    if (http.begin(config.webhook))
+    {
+        http.addHeader("Content-Type", "text/plain");
+        code = http.POST((uint8_t *)body, length);
+        http.end();
+    }
+
+    if (code >= 200 && code < 300)
+    {
+        queue.delivered(esp_timer_get_time());
+        delivered++;
+        return;
+    }
+
+    queue.failed(esp_timer_get_time());
+    log_w("webhook failed with %i - next attempt in %lu s", code, (unsigned long)(queue.backoff() / 1000));
+}
+
+static void publishStatus(const alarmConfig_t &config, const alarmEngine &engine, const webhookQueue &queue, const uint32_t delivered)
+{
+    static alarmStatus_t status;
+
+    status.count = engine.size();
+    for (size_t i = 0; i < engine.size(); i++)
+    {
+        status.rule[i] = engine.ruleAt(i);
+        status.state[i] = engine.stateAt(i);
+    }
+    strlcpy(status.webhook, config.webhook, sizeof(status.webhook));
+    status.holdoffSec = config.holdoffSec;
+    status.pending = queue.pending();
+    status.backoffMs = queue.backoff();
+    status.delivered = delivered;
+    status.failures = queue.failures;
+    status.dropped = queue.dropped;
+
+    alarmStatus.publish(status);
+}
+
+static void publishTemperatureLimits(const alarmConfig_t &config)
+{
+    temperatureLimits_t limits = {};
+    for (size_t i = 0; i < config.count; i++)
+        if (config.rule[i].sample == SOURCE_TEMPERATURE && config.rule[i].check <= CHECK_BELOW)
+            limits.value[limits.count++] = config.rule[i].limit;
+
+    temperatureLimits.publish(limits);
+}
+
+/* from the httpd task when the alarm file was uploaded */
+void alarmChanged()
+{
+    if (alarmTaskHandle)
+        xTaskNotifyGive(alarmTaskHandle);
+}
+
+void alarmTask(void *parameter)
+{
+    alarmTaskHandle = xTaskGetCurrentTaskHandle();
+
+    waitForBootStages(bootBit(BOOT_STORAGE));
+
+    /* static to keep them off the task stack, which HTTPClient needs */
+    static alarmConfig_t config;
+    static alarmEngine engine;
+    static webhookQueue webhook;
+    static alarmSample_t sample[NUMBER_OF_ALARM_SAMPLES];
+    static alarmEvent_t event[MAX_ALARMS];
+    uint32_t delivered = 0;
+
+    bool reload = true;
+    while (1)
+    {
+        if (reload)
+        {
+            String result;
+            if (loadAlarms(config, result))
+                log_i("%s", result.c_str());
+            else
+                log_w("alarms ignored: %s", result.c_str());
+
+            engine.setRules(config.rule, config.count, config.holdoffSec, esp_timer_get_time());
+            webhook.clear();
+            publishTemperatureLimits(config);
+        }
+
+        const int64_t nowUs = esp_timer_get_time();
+        sampleSources(sample, nowUs);
+
+        const size_t events = engine.evaluate(sample, nowUs, event);
+        for (size_t i = 0; i < events; i++)
+            notify(engine, event[i], webhook, *config.webhook);
+
+#ifndef HEADLESS_BUILD
+        showBanner(engine);
+#endif
+        deliverWebhook(config, engine, webhook, delivered);
+        publishStatus(config, engine, webhook, delivered);
+
+        reload = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ALARM_INTERVAL_MS)) > 0;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _ALARMTASK_HPP_
+#define _ALARMTASK_HPP_
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <esp_heap_caps.h>
+#include <FS.h>
+#include <SD.h>
+#include <freertos/semphr.h>
+
+#include "ScopedMutex.h"
+#include "alarmEngine.h"
+#include "channelConfig.h"
+#include "stateBoard.h"
+#include "lcdMessage.h"
+#include "websocketMessage.h"
+#include "bootState.h"
+#include "runtimeMetrics.h"
+
+extern SemaphoreHandle_t spiMutex;
+extern channelConfig_t channelConfig;
+extern seqlock<lightState_t> lightState;
+extern seqlock<sensorState_t> sensorState;
+extern websocketRing_t alarmToWebsocket;
+
+extern void textOnLcd(const lcdMessageType type, const char *str);
+
+const char *ALARM_FILE = "/default.alm";
+
+static constexpr uint32_t ALARM_INTERVAL_MS = 500;
+static constexpr uint32_t WEBHOOK_TIMEOUT_MS = 2000;
+
+seqlock<alarmStatus_t> alarmStatus;
+seqlock<temperatureLimits_t> temperatureLimits;
+
+static TaskHandle_t alarmTaskHandle = nullptr;
+
+#endif
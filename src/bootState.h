@@ -0,0 +1,51 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _BOOTSTATE_H_
+#define _BOOTSTATE_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+enum bootStage
+{
+    BOOT_STORAGE, /* SD card mounted, timers and moon settings loaded */
+    BOOT_NETWORK, /* WiFi has an IP */
+    BOOT_TIME,    /* clock restored from holdover or synced through NTP */
+    BOOT_DIMMER,
+    BOOT_HTTP,
+    BOOT_LCD,
+    BOOT_SENSOR,
+    NUMBER_OF_BOOT_STAGES
+};
+
+static constexpr const char *bootStageName[NUMBER_OF_BOOT_STAGES] =
+    {"storage", "network", "time", "dimmer", "http", "lcd", "sensor"};
+
+static constexpr EventBits_t bootBit(const bootStage stage) { return 1UL << stage; }
+
+extern int64_t bootStageReadyUs[NUMBER_OF_BOOT_STAGES];
+extern void bootStageReady(const bootStage stage);
+extern void waitForBootStages(const EventBits_t stages);
+
+#endif
@@ -0,0 +1,276 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "calendarTask.hpp"
+
+static bool validProfileName(const char *name)
+{
+    const size_t length = strlen(name);
+    if (!length || length >= MAX_PROFILE_NAME)
+        return false;
+
+    for (const char *p = name; *p; p++)
+        if (!isalnum(*p) && *p != '-' && *p != '_')
+            return false;
+
+    return true;
+}
+
+/*
+    Selects a profile /profiles/<name>.aqu per date, the first matching line wins.
+    Without a match - or without a calendar - /default.aqu runs.
+
+    sat,sun=weekend
+    12-01..02-28=winter         month-day ranges, can wrap past the new year
+    acclimate=2026-11-01,6,40   start date, weeks, intensity % on the first day
+*/
+static bool parseCalendarFile(File &file, scheduleCalendar_t &calendar, String &result)
+{
+    log_i("parsing '%s'", file.path());
+
+    int currentLine = 0;
+    while (file.available())
+    {
+        String line = file.readStringUntil('\n');
+        currentLine++;
+
+        const int comment = line.indexOf('#');
+        if (comment != -1)
+            line.remove(comment);
+
+        line.trim();
+        if (line.isEmpty())
+            continue;
+
+        const int sep = line.indexOf('=');
+        if (sep < 1)
+        {
+            result = "invalid line " + String(currentLine);
+            return false;
+        }
+
+        String key = line.substring(0, sep);
+        String value = line.substring(sep + 1);
+        key.trim();
+        value.trim();
+
+        if (key.equalsIgnoreCase("acclimate"))
+        {
+            int year;
+            unsigned month, day, weeks, from;
+            if (sscanf(value.c_str(), "%d-%u-%u,%u,%u", &year, &month, &day, &weeks, &from) != 5 ||
+                month < 1 || month > 12 || day < 1 || day > 31 || weeks < 1 || weeks > 52 || from > 100)
+            {
+                result = "invalid acclimation at line " + String(currentLine);
+                return false;
+            }
+            calendar.acclimationStart = dayNumber(year, month, day);
+            calendar.acclimationDays = weeks * 7;
+            calendar.acclimationFrom = from / 100.0f;
+            continue;
+        }
+
+        calendarRule_t rule = {};
+        unsigned fromMonth, fromDay, toMonth, toDay;
+        if (sscanf(key.c_str(), "%u-%u..%u-%u", &fromMonth, &fromDay, &toMonth, &toDay) == 4 &&
+            fromMonth >= 1 && fromMonth <= 12 && toMonth >= 1 && toMonth <= 12 && fromDay >= 1 && fromDay <= 31 && toDay >= 1 && toDay <= 31)
+        {
+            rule.fromDate = monthDay(fromMonth, fromDay);
+            rule.toDate = monthDay(toMonth, toDay);
+        }
+        else if (sscanf(key.c_str(), "%u-%u", &fromMonth, &fromDay) == 2 && key.indexOf("..") == -1 &&
+                 fromMonth >= 1 && fromMonth <= 12 && fromDay >= 1 && fromDay <= 31)
+            rule.fromDate = rule.toDate = monthDay(fromMonth, fromDay);
+        else if (!(rule.weekdays = parseWeekdays(key.c_str())))
+        {
+            result = "invalid days or dates at line " + String(currentLine);
+            return false;
+        }
+
+        if (!validProfileName(value.c_str()))
+        {
+            result = "invalid profile name at line " + String(currentLine);
+            return false;
+        }
+        strlcpy(rule.profile, value.c_str(), sizeof(rule.profile));
+
+        if (!calendar.rule.push_back(rule))
+        {
+            result = "too many rules at line " + String(currentLine);
+            return false;
+        }
+    }
+
+    result = "Calendar with " + String(calendar.rule.size()) + " rules";
+    return true;
+}
+
+/* an empty calendar - the default timers at full intensity - when there is no calendar file */
+static bool loadCalendar(scheduleCalendar_t &calendar, String &result)
+{
+    calendar = {};
+
+    ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+    if (!lock.acquired())
+    {
+        result = "Mutex timeout";
+        return false;
+    }
+
+    phaseTimer storage(taskPhases.storageUs);
+    File file = SD.open(CALENDAR_FILE, FILE_READ);
+    if (!file)
+    {
+        result = "No calendar";
+        return true;
+    }
+
+    if (parseCalendarFile(file, calendar, result))
+        return true;
+
+    calendar = {};
+    return false;
+}
+
+/* today's sunrise and sunset at LATITUDE, LONGITUDE in seconds since local midnight */
+static sunTimes_t sunTimesFor(const struct tm &today)
+{
+    const int32_t day = dayNumber(today.tm_year + 1900, today.tm_mon + 1, today.tm_mday);
+    const solarDay_t sun = solarEvents(day, LATITUDE, LONGITUDE);
+
+    struct tm midnight = today;
+    midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+    midnight.tm_isdst = -1;
+    const time_t localMidnight = mktime(&midnight);
+
+    sunTimes_t times;
+    localSolarTimes(sun, day, localMidnight, times.sunrise, times.sunset);
+    return times;
+}
+
+/*
+    Loads the profile for today into channel[], sets the acclimation scale and moves the sun timers to today.
+    The dimmer compiles these into its segment tables on the next tick - as it does for any new schedule.
+    A new profile brings the scale and sun times along, so everything changes under one channelMutex hold and one scheduleVersion bump.
+*/
+static void applyCalendar(const bool reload)
+{
+    static scheduleCalendar_t calendar;
+    static char appliedProfile[MAX_PROFILE_NAME] = ""; /* setup() loaded the default timers */
+
+    String result;
+    if (!loadCalendar(calendar, result))
+        log_w("calendar ignored: %s", result.c_str());
+
+    const time_t now = time(NULL);
+    struct tm today;
+    localtime_r(&now, &today);
+
+    const char *profile = calendar.profileFor(today);
+    const float scale = calendar.scaleFor(today);
+    const sunTimes_t sun = sunTimesFor(today);
+
+    if (reload || strcmp(profile ? profile : "", appliedProfile))
+    {
+        char path[48];
+        if (profile)
+            snprintf(path, sizeof(path), "%s/%s%s", PROFILE_DIRECTORY, profile, PROFILE_EXTENSION);
+        else
+            strlcpy(path, DEFAULT_TIMERFILE, sizeof(path));
+
+        const calendarDay_t day = {scale, sun};
+        if (loadTimerFile(path, result, &day))
+        {
+            strlcpy(appliedProfile, profile ? profile : "", sizeof(appliedProfile));
+            log_i("profile '%s' active at %.0f%%: %s", path, scale * 100, result.c_str());
+        }
+        else
+            log_w("could not load profile '%s': %s", path, result.c_str());
+    }
+
+    ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+    if (!lock.acquired())
+    {
+        log_w("channelMutex timeout - acclimation scale not applied");
+        return;
+    }
+
+    /* a new day with the same profile - or a profile that did not load */
+    bool changed = false;
+    if (scale != scheduleScale)
+    {
+        scheduleScale = scale;
+        changed = true;
+        log_i("acclimation at %.0f%%", scale * 100);
+    }
+
+    sunTimes = sun;
+    if (resolveSunTimers(sun))
+    {
+        changed = true;
+        log_i("sunrise %02i:%02i sunset %02i:%02i", sun.sunrise / 3600, sun.sunrise % 3600 / 60, sun.sunset / 3600, sun.sunset % 3600 / 60);
+    }
+
+    if (changed)
+        scheduleVersion++;
+
+    strlcpy(calendarState.profile, appliedProfile, sizeof(calendarState.profile));
+    calendarState.scale = scale;
+    calendarState.rules = calendar.rule.size();
+    calendarState.appliedAt = now;
+    calendarState.sunrise = sun.sunrise;
+    calendarState.sunset = sun.sunset;
+}
+
+/* until just after the next local midnight, but at most an hour in case the clock steps */
+static uint32_t msUntilMidnight()
+{
+    const time_t now = time(NULL);
+    struct tm localTime;
+    localtime_r(&now, &localTime);
+
+    constexpr uint32_t MAX_SLEEP_SEC = 3600;
+    const uint32_t secondsLeft = 86400 - (localTime.tm_hour * 3600 + localTime.tm_min * 60 + localTime.tm_sec) + 1;
+    return (secondsLeft < MAX_SLEEP_SEC ? secondsLeft : MAX_SLEEP_SEC) * 1000;
+}
+
+/* from the httpd task when the calendar or a profile was uploaded */
+void calendarChanged()
+{
+    if (calendarTaskHandle)
+        xTaskNotifyGive(calendarTaskHandle);
+}
+
+void calendarTask(void *parameter)
+{
+    calendarTaskHandle = xTaskGetCurrentTaskHandle();
+
+    waitForBootStages(bootBit(BOOT_STORAGE) | bootBit(BOOT_TIME));
+
+    bool reload = false;
+    while (1)
+    {
+        applyCalendar(reload);
+        reload = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(msUntilMidnight())) > 0;
+    }
+}
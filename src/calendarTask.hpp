@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _CALENDARTASK_HPP_
+#define _CALENDARTASK_HPP_
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+#include <freertos/semphr.h>
+
+#include "ScopedMutex.h"
+#include "scheduleCalendar.h"
+#include "solarEvents.h"
+#include "lightTimer.h"
+#include "bootState.h"
+#include "runtimeMetrics.h"
+
+extern SemaphoreHandle_t spiMutex;
+extern SemaphoreHandle_t channelMutex;
+extern uint32_t scheduleVersion;
+extern float scheduleScale;
+extern const char *DEFAULT_TIMERFILE;
+
+extern bool loadTimerFile(const char *path, String &result, const calendarDay_t *day);
+extern bool resolveSunTimers(const sunTimes_t &sun);
+
+const char *CALENDAR_FILE = "/default.cal";
+const char *PROFILE_DIRECTORY = "/profiles";
+const char *PROFILE_EXTENSION = ".aqu";
+
+calendarState_t calendarState = {"", 1, 0, 0, 21600, 64800}; /* protected by channelMutex */
+sunTimes_t sunTimes = {21600, 64800};                        /* protected by channelMutex */
+
+static TaskHandle_t calendarTaskHandle = nullptr;
+
+#endif
@@ -0,0 +1,98 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _CHANNELCONFIG_H_
+#define _CHANNELCONFIG_H_
+
+#include <stdint.h>
+#include <soc/soc_caps.h>
+
+#ifdef SOC_LEDC_SUPPORT_HS_MODE
+static constexpr int LEDC_CHANNEL_COUNT = SOC_LEDC_CHANNEL_NUM * 2;
+#else
+static constexpr int LEDC_CHANNEL_COUNT = SOC_LEDC_CHANNEL_NUM;
+#endif
+
+/* storage is sized for every LEDC channel of the SoC - the channels in use are set by CHANNEL_CONFIG_FILE */
+static constexpr int MAX_CHANNELS = LEDC_CHANNEL_COUNT;
+
+static constexpr uint32_t DEFAULT_PWM_FREQUENCY = 1220;
+static constexpr uint8_t DEFAULT_PWM_BITDEPTH = SOC_LEDC_TIMER_BIT_WIDTH < 16 ? SOC_LEDC_TIMER_BIT_WIDTH : 16;
+static constexpr uint8_t DEFAULT_FIRST_LEDC_CHANNEL = 2;
+static constexpr uint32_t LEDC_SOURCE_CLOCK_HZ = 80 * 1000 * 1000; /* APB - see ledcSetClockSource() in setup() */
+
+#if defined(PCA9685_SDA) && defined(PCA9685_SCL)
+static constexpr bool HAVE_PCA9685 = true;
+#else
+static constexpr bool HAVE_PCA9685 = false;
+#endif
+
+#ifndef PCA9685_ADDRESS
+#define PCA9685_ADDRESS 0x40
+#endif
+
+enum outputType : uint8_t
+{
+    OUTPUT_LEDC,
+    OUTPUT_PCA9685
+};
+
+/* without a config file the pins from platformio.ini are used */
+static constexpr uint8_t DEFAULT_LEDPIN[] = {LEDPIN_0, LEDPIN_1, LEDPIN_2, LEDPIN_3, LEDPIN_4};
+
+/*
+    Output settings per channel.
+    Stored as a structure of arrays so the dimmer tick loop walks each setting in contiguous memory.
+    Loaded once at boot - changes are applied after a reboot.
+*/
+struct channelConfig_t
+{
+    int count;
+    outputType output[MAX_CHANNELS];
+    uint8_t pin[MAX_CHANNELS]; /* the output number on a PCA9685 */
+    uint8_t ledcChannel[MAX_CHANNELS];
+    uint32_t frequency[MAX_CHANNELS];
+    uint8_t bitDepth[MAX_CHANNELS];
+    uint32_t maxDuty[MAX_CHANNELS];
+    float gamma[MAX_CHANNELS]; /* 1 is a linear curve */
+
+    void setDefault(const int index, const uint8_t outputPin)
+    {
+        output[index] = OUTPUT_LEDC;
+        pin[index] = outputPin;
+        ledcChannel[index] = (index + DEFAULT_FIRST_LEDC_CHANNEL) % LEDC_CHANNEL_COUNT;
+        frequency[index] = DEFAULT_PWM_FREQUENCY;
+        bitDepth[index] = DEFAULT_PWM_BITDEPTH;
+        maxDuty[index] = (1UL << DEFAULT_PWM_BITDEPTH) - 1;
+        gamma[index] = 1.0f;
+    }
+
+    void setDefaults()
+    {
+        count = sizeof(DEFAULT_LEDPIN) / sizeof(DEFAULT_LEDPIN[0]);
+        for (int index = 0; index < count; index++)
+            setDefault(index, DEFAULT_LEDPIN[index]);
+    }
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _COLORTARGET_H_
+#define _COLORTARGET_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fixedVector.h"
+#include "channelConfig.h"
+
+static constexpr size_t MAX_COLOR_KEYFRAMES = 32; /* including the closing keyframe at 86400 */
+static constexpr float MIN_CCT = 1667;
+static constexpr float MAX_CCT = 25000;
+static constexpr float MAX_WHITE_DISTANCE = 0.0054f; /* uv distance from the locus that still looks white */
+
+struct colorKeyframe_t
+{
+    int time;        /* seconds since midnight */
+    float cct;       /* kelvin */
+    float intensity; /* percent of the brightest mix the fixture makes at this cct */
+};
+
+/* a keyframe resolved to the level of one channel - compiled by segmentTable like a lightTimer_t */
+struct colorLevel_t
+{
+    int time;
+    float percentage;
+};
+
+using colorLevelList_t = fixedVector<colorLevel_t, MAX_COLOR_KEYFRAMES>;
+
+/* CIE 1931 xy on the Planckian locus - the cubic spline of Kim et al. for 1667-25000 K */
+static inline void cctToXy(const float cct, float &x, float &y)
+{
+    const float t = cct;
+    x = t <= 4000 ? -0.2661239e9f / (t * t * t) - 0.2343589e6f / (t * t) + 0.8776956e3f / t + 0.179910f
+                  : -3.0258469e9f / (t * t * t) + 2.1070379e6f / (t * t) + 0.2226347e3f / t + 0.240390f;
+
+    if (t <= 2222)
+        y = ((-1.1063814f * x - 1.34811020f) * x + 2.18555832f) * x - 0.20219683f;
+    else if (t <= 4000)
+        y = ((-0.9549476f * x - 1.37418593f) * x + 2.09137015f) * x - 0.16748867f;
+    else
+        y = ((3.0817580f * x - 5.87338670f) * x + 3.75112997f) * x - 0.37001483f;
+}
+
+/* distance between two chromaticities in the CIE 1960 uv plane */
+static inline float uvDistance(const float x1, const float y1, const float x2, const float y2)
+{
+    const float d1 = -2 * x1 + 12 * y1 + 3;
+    const float d2 = -2 * x2 + 12 * y2 + 3;
+    const float du = 4 * x1 / d1 - 4 * x2 / d2;
+    const float dv = 6 * y1 / d1 - 6 * y2 / d2;
+    return sqrtf(du * du + dv * dv);
+}
+
+/*
+    What every channel of a fixture emits at 100% - as CIE XYZ from the chromaticity and relative flux in the fixture file.
+    Channels without calibration are not driven by colour targets and keep their own timers.
+*/
+struct colorFixture_t
+{
+    float X[MAX_CHANNELS];
+    float Y[MAX_CHANNELS];
+    float Z[MAX_CHANNELS];
+    uint32_t channelMask;
+
+    void set(const int index, const float x, const float y, const float flux)
+    {
+        X[index] = x / y * flux;
+        Y[index] = flux;
+        Z[index] = (1 - x - y) / y * flux;
+        channelMask |= 1UL << index;
+    }
+
+    bool covers(const int index) const { return channelMask & (1UL << index); }
+
+    /*
+        Levels 0-1 per channel that mix to the chromaticity of cct at the highest intensity the fixture can reach there.
+        Nonnegative least squares on XYZ by coordinate descent, with a small ridge term so that more than three channels
+        still have a single answer. The problem is homogeneous - a lower intensity is the same mix scaled down.
+        Returns the uv distance between the mix and the target, or INFINITY when no mix reaches it.
+    */
+    float solve(const float cct, const int count, float *level) const
+    {
+        float x, y;
+        cctToXy(cct, x, y);
+        const float target[3] = {x / y, 1, (1 - x - y) / y};
+
+        float A[MAX_CHANNELS][MAX_CHANNELS] = {};
+        float b[MAX_CHANNELS] = {};
+        float trace = 0;
+        for (int i = 0; i < count; i++)
+        {
+            level[i] = 0;
+            if (!covers(i))
+                continue;
+
+            for (int j = 0; j < count; j++)
+                if (covers(j))
+                    A[i][j] = X[i] * X[j] + Y[i] * Y[j] + Z[i] * Z[j];
+            b[i] = X[i] * target[0] + Y[i] * target[1] + Z[i] * target[2];
+            trace += A[i][i];
+        }
+
+        const float ridge = 1e-4f * trace / __builtin_popcount(channelMask);
+        for (int i = 0; i < count; i++)
+            A[i][i] += ridge;
+
+        constexpr int SWEEPS = 400;
+        for (int sweep = 0; sweep < SWEEPS; sweep++)
+            for (int i = 0; i < count; i++)
+            {
+                if (!covers(i))
+                    continue;
+
+                float gradient = -b[i];
+                for (int j = 0; j < count; j++)
+                    gradient += A[i][j] * level[j];
+
+                const float next = level[i] - gradient / A[i][i];
+                level[i] = next > 0 ? next : 0;
+            }
+
+        float peak = 0;
+        for (int i = 0; i < count; i++)
+            peak = level[i] > peak ? level[i] : peak;
+        if (peak <= 0)
+            return INFINITY;
+
+        float mix[3] = {};
+        for (int i = 0; i < count; i++)
+        {
+            level[i] /= peak;
+            mix[0] += X[i] * level[i];
+            mix[1] += Y[i] * level[i];
+            mix[2] += Z[i] * level[i];
+        }
+
+        const float sum = mix[0] + mix[1] + mix[2];
+        return sum > 0 ? uvDistance(mix[0] / sum, mix[1] / sum, x, y) : INFINITY;
+    }
+};
+
+/*
+    The schedule as (cct, intensity) keyframes, solved once against the fixture into a level curve per channel.
+    The dimmer compiles these curves instead of the channel timers, so a tick is still a plain interpolation.
+*/
+struct colorSchedule_t
+{
+    bool active;
+    colorFixture_t fixture;
+    fixedVector<colorKeyframe_t, MAX_COLOR_KEYFRAMES> keyframe;
+    float distance[MAX_COLOR_KEYFRAMES]; /* of the mix at each keyframe from its target */
+    colorLevelList_t level[MAX_CHANNELS];
+
+    /* the keyframes have to be sorted and closed at 86400 */
+    bool resolve(const int count)
+    {
+        for (int index = 0; index < count; index++)
+            level[index].clear();
+
+        for (size_t k = 0; k < keyframe.size(); k++)
+        {
+            float mix[MAX_CHANNELS];
+            distance[k] = fixture.solve(keyframe[k].cct, count, mix);
+            if (!isfinite(distance[k]))
+                return false;
+
+            for (int index = 0; index < count; index++)
+                if (fixture.covers(index))
+                    level[index].push_back({keyframe[k].time, keyframe[k].intensity * mix[index]});
+        }
+        return true;
+    }
+
+    bool drives(const int index) const { return active && fixture.covers(index); }
+};
+
+#endif
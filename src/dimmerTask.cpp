@@ -25,7 +25,7 @@ SOFTWARE.
 
 static unsigned int msSinceMidnight()
 {
-    // Time should already be synced through SNTP!
+    // Time should already be synced through SNTP or restored by restoreHoldoverTime()!
     struct timeval now;
     gettimeofday(&now, NULL);
 
@@ -43,32 +43,491 @@ static unsigned int msSinceMidnight()
     return millisecondsSinceMidnight;
 }
 
-void dimmerTask(void *parameter)
+static void startTransition(const int index, const unsigned long durationMs)
+{
+    transition[index] = {currentPercentage[index], millis(), durationMs};
+}
+
+static void startTransitions(const uint32_t channelMask, const unsigned long durationMs)
+{
+    for (int index = 0; index < channelConfig.count; index++)
+        if (channelMask & (1UL << index))
+            startTransition(index, durationMs);
+}
+
+/* the per channel stacks only change when a layer starts or ends - not every tick */
+static void rebuildLayerStacks()
+{
+    lightLayer *allLayers[3 + MAX_ACTIVE_SCENES + MAX_CHANNELS];
+    size_t numberOfLayers = 0;
+
+    allLayers[numberOfLayers++] = &scheduleLayer;
+    allLayers[numberOfLayers++] = &effectLayer;
+    allLayers[numberOfLayers++] = &moonLayer;
+    for (auto &scene : sceneLayer)
+        allLayers[numberOfLayers++] = &scene;
+    for (int index = 0; index < channelConfig.count; index++)
+        allLayers[numberOfLayers++] = &overrideLayer[index];
+
+    for (int index = 0; index < channelConfig.count; index++)
+    {
+        size_t &size = layerStackSize[index];
+        size = 0;
+        for (size_t i = 0; i < numberOfLayers && size < MAX_LAYERS_PER_CHANNEL; i++)
+        {
+            lightLayer *layer = allLayers[i];
+            if (!layer->active || !layer->covers(index))
+                continue;
+
+            /* insertion sort - equal priorities keep their order */
+            size_t pos = size++;
+            while (pos > 0 && layerStack[index][pos - 1]->priority > layer->priority)
+            {
+                layerStack[index][pos] = layerStack[index][pos - 1];
+                pos--;
+            }
+            layerStack[index][pos] = layer;
+        }
+    }
+}
+
+static void compileSchedule()
+{
+    for (int index = 0; index < channelConfig.count; index++)
+    {
+        const colorLevelList_t &curve = colorSchedule.level[index];
+        const bool compiled = colorSchedule.drives(index) ? scheduleLayer.table[index].compile(curve.data(), curve.size(), scheduleScale)
+                                                          : scheduleLayer.table[index].compile(channel[index].data(), channel[index].size(), scheduleScale);
+        if (!compiled)
+        {
+            log_e("could not compile the schedule for channel %i", index);
+            scheduleLayer.table[index].setConstant(0);
+        }
+    }
+}
+
+/* channelMutex has to be held by the caller */
+void setManualOverride(const int index, const float percentage, const unsigned long durationMs)
 {
-    static constexpr uint8_t ledPin[NUMBER_OF_CHANNELS] =
-        {LEDPIN_0, LEDPIN_1, LEDPIN_2, LEDPIN_3, LEDPIN_4};
+    constantLayer &layer = overrideLayer[index];
+
+    layer.active = false;
+    if (durationMs)
+    {
+        layer.level = percentage;
+        layer.activate(millis(), durationMs);
+    }
+
+    rebuildLayerStacks();
+    startTransition(index, SCHEDULE_FADE_MS);
+}
+
+/* channelMutex has to be held by the caller */
+void setWeatherEffects(const weatherEffect_t *effect, const bool enabled)
+{
+    effectLayer.channelMask = 0;
+    for (int index = 0; index < channelConfig.count; index++)
+    {
+        effectLayer.effect[index] = effect[index];
+        if (effect[index].enabled())
+            effectLayer.channelMask |= 1UL << index;
+    }
+
+    weatherEffectsOn = enabled;
+    effectLayer.active = enabled && effectLayer.channelMask;
+    rebuildLayerStacks();
+    startTransitions(UINT32_MAX, SCHEDULE_FADE_MS);
+}
+
+/* channelMutex has to be held by the caller */
+bool weatherEffectsActive() { return effectLayer.active; }
+
+/* the switch, also while no channel has effects - channelMutex has to be held by the caller */
+bool weatherEffectsEnabled() { return weatherEffectsOn; }
+
+/* channelMutex has to be held by the caller */
+void getWeatherEffects(weatherEffect_t *effect)
+{
+    std::copy(effectLayer.effect, effectLayer.effect + channelConfig.count, effect);
+}
+
+static uint32_t localDayNumber()
+{
+    const time_t now = time(NULL);
+    struct tm localTime;
+    localtime_r(&now, &localTime);
+    return localTime.tm_year * 366 + localTime.tm_yday;
+}
+
+/* channelMutex has to be held by the caller */
+bool activateScene(const sceneLayer_t &scene, const unsigned long durationMs, String &result)
+{
+    sceneLayer_t *slot = nullptr;
+    for (auto &layer : sceneLayer)
+        if (layer.active && !strcmp(layer.name, scene.name))
+        {
+            slot = &layer; /* restart a running scene */
+            break;
+        }
+
+    for (auto &layer : sceneLayer)
+        if (!slot && !layer.active)
+            slot = &layer;
 
-    static constexpr int PWM_BITDEPTH = min(SOC_LEDC_TIMER_BIT_WIDTH, 16);
-    static constexpr int LEDC_MAX_VALUE = (1 << PWM_BITDEPTH) - 1;
-    static constexpr int freq = 1220;
+    if (!slot)
+    {
+        result = "Too many active scenes";
+        return false;
+    }
+
+    const uint32_t previousMask = slot->active ? slot->channelMask : 0;
+
+    *slot = scene;
+    slot->dayClock = false;
+    slot->activate(millis(), durationMs);
+
+    rebuildLayerStacks();
+    startTransitions(previousMask | slot->channelMask, SCHEDULE_FADE_MS);
+
+    result = "Scene '";
+    result.concat(scene.name);
+    result.concat("' started");
+    return true;
+}
+
+/* channelMutex has to be held by the caller */
+bool stopScene(const char *name, String &result)
+{
+    for (auto &layer : sceneLayer)
+        if (layer.active && !strcmp(layer.name, name))
+        {
+            layer.active = false;
+            rebuildLayerStacks();
+            startTransitions(layer.channelMask, SCHEDULE_FADE_MS);
+
+            result = "Scene '";
+            result.concat(name);
+            result.concat("' stopped");
+            return true;
+        }
+
+    result = "Scene not active";
+    return false;
+}
+
+/*
+    channelMutex has to be held by the caller
+    The schedule as the dimmer runs it - timers or colour targets with the moon floor, without effects, scenes and overrides.
+    Returns the version of the schedule that was sampled, which trails scheduleVersion until the next tick compiles it.
+*/
+uint32_t sampleSchedule(const int index, const uint32_t fromMs, const uint32_t stepMs, const size_t count, float *level)
+{
+    scheduleLayer.table[index].sample(fromMs, stepMs, count, level);
+
+    const float moonLevel = moonLayer.table[index].levelAt(0);
+    for (size_t i = 0; i < count; i++)
+        level[i] = blendLayer(level[i], moonLevel, moonLayer.blend);
+
+    return compiledVersion;
+}
+
+/* channelMutex has to be held by the caller */
+void describeActiveLayers(arenaText &result)
+{
+    const unsigned long now = millis();
+    lightLayer *layers[MAX_ACTIVE_SCENES + MAX_CHANNELS];
+    size_t count = 0;
+
+    for (auto &layer : sceneLayer)
+        layers[count++] = &layer;
+    for (int index = 0; index < channelConfig.count; index++)
+        layers[count++] = &overrideLayer[index];
+
+    result.add("Name,Priority,Blend,Channels,Remaining s\n");
+    for (size_t i = 0; i < count; i++)
+    {
+        const lightLayer &layer = *layers[i];
+        if (!layer.active)
+            continue;
+
+        result.printf("%s,%u,%s,%" PRIX32 ",", layer.name, (unsigned)layer.priority, blendModeName(layer.blend), layer.channelMask);
+        if (layer.expires)
+            result.printf("%li\n", (long)(layer.untilMs - now) / 1000);
+        else
+            result.add("-\n");
+    }
+}
+
+class ledcBackend : public outputBackend
+{
+public:
+    void attach(const uint8_t pin, const uint8_t ledcChannel) { channelOf[pin] = ledcChannel; }
+
+    /* ledcWrite() has no phase - the pulse starts at hpoint */
+    bool write(const uint8_t pin, const uint32_t dutyCycle, const uint32_t phase) override
+    {
+        const ledc_mode_t mode = ledc_mode_t(channelOf[pin] / SOC_LEDC_CHANNEL_NUM);
+        const ledc_channel_t channel = ledc_channel_t(channelOf[pin] % SOC_LEDC_CHANNEL_NUM);
+        return ledc_set_duty_with_hpoint(mode, channel, dutyCycle, phase) == ESP_OK && ledc_update_duty(mode, channel) == ESP_OK;
+    }
+
+private:
+    uint8_t channelOf[SOC_GPIO_PIN_COUNT] = {};
+};
+
+static ledcBackend ledc;
+
+#if defined(PCA9685_SDA) && defined(PCA9685_SCL)
+class wireBus : public i2cBus
+{
+public:
+    explicit wireBus(TwoWire &wire) : wire(wire) {}
+
+protected:
+    bool transfer(const uint8_t address, const uint8_t *data, const size_t length) override
+    {
+        wire.beginTransmission(address);
+        wire.write(data, length);
+        return wire.endTransmission() == 0;
+    }
+
+private:
+    TwoWire &wire;
+};
+
+/* on the second I2C controller - the first can be in use by the rtc */
+static wireBus pca9685Bus(Wire1);
+static pca9685Backend pca9685(pca9685Bus, PCA9685_ADDRESS);
+#endif
+
+static void writeDuty(const int index, const uint32_t dutyCycle)
+{
+    if (dutyCycle == lastDuty[index] && plannedPhase[index] == lastPhase[index])
+        return;
+
+    if (!output[index]->write(channelConfig.pin[index], dutyCycle, plannedPhase[index]))
+        log_w("Error setting duty cycle %i on output %i", dutyCycle, channelConfig.pin[index]);
+    else
+    {
+        lastDuty[index] = dutyCycle;
+        lastPhase[index] = plannedPhase[index];
+    }
+}
+
+/* the hpoint the output has - channels are attached with 0 */
+static inline uint32_t writtenPhase(const int index) { return lastPhase[index] == UINT32_MAX ? 0 : lastPhase[index]; }
+
+/* the external drivers send all duty cycles written this tick in one go */
+static void flushOutputs()
+{
+#if defined(PCA9685_SDA) && defined(PCA9685_SCL)
+    if (!pca9685.flush())
+        log_w("Error writing to PCA9685");
+#endif
+}
+
+static inline ledc_mode_t ledcMode(const int index) { return ledc_mode_t(channelConfig.ledcChannel[index] / SOC_LEDC_CHANNEL_NUM); }
+static inline ledc_channel_t ledcChannel(const int index) { return ledc_channel_t(channelConfig.ledcChannel[index] % SOC_LEDC_CHANNEL_NUM); }
+
+/* unrounded - the dither gets the part between two steps */
+static inline double exactDutyFor(const int index, const float percentage)
+{
+    const double maxDuty = channelConfig.maxDuty[index];
+    if (channelConfig.gamma[index] == 1.0f)
+        return percentage * maxDuty / 100;
+
+    return pow(percentage / 100.0, channelConfig.gamma[index]) * maxDuty;
+}
+
+static inline uint32_t dutyCycleFor(const int index, const float percentage) { return exactDutyFor(index, percentage); }
+
+/* the software path takes over during transitions, scenes, overrides and effects - and on channels with a curve */
+static bool canHardwareFade(const int index, const unsigned long now)
+{
+    const lightTransition_t &t = transition[index];
+    return layerStackSize[index] == 2 && layerStack[index][0] == &scheduleLayer && layerStack[index][1] == &moonLayer &&
+           now - t.startMs >= t.durationMs && channelConfig.gamma[index] == 1.0f && channelConfig.output[index] == OUTPUT_LEDC;
+}
+
+static void stopHardwareFade(const int index)
+{
+    if (!hardwareFade[index].active)
+        return;
+
+    ledc_fade_stop(ledcMode(index), ledcChannel(index));
+    hardwareFade[index].active = false;
+    lastDuty[index] = UINT32_MAX; /* unknown where the fade stopped - force the next write */
+}
+
+/*
+    Program the rest of the current timer segment as one hardware fade.
+    A new fade is only started at segment boundaries or when the output drifts from the fade - a moon update for example.
+*/
+static void updateHardwareFade(const int index, const uint32_t dutyCycle, const unsigned long now, const uint32_t msToday)
+{
+    hardwareFade_t &fade = hardwareFade[index];
+
+    if (fade.active && abs(int32_t(dutyCycle) - int32_t(fade.expectedDuty(now))) <= HARDWARE_FADE_TOLERANCE)
+        return;
+
+    /* the LEDC fade hardware takes at most 1023 PWM cycles per duty step */
+    const uint32_t segmentEndMs = scheduleLayer.table[index].currentSegmentEndMs();
+    uint32_t fadeMs = min(segmentEndMs - min(segmentEndMs, msToday), MAX_HARDWARE_FADE_MS);
+    float endPercentage = max(scheduleLayer.table[index].levelAt(msToday + fadeMs), moonLayer.table[index].levelAt(0));
+    uint32_t endDuty = dutyCycleFor(index, endPercentage);
+    const uint32_t steps = abs(int32_t(endDuty) - int32_t(dutyCycle));
+    const uint32_t maxFadeMs = steps * 1023ULL * 1000 / channelConfig.frequency[index];
+
+    if (fadeMs > maxFadeMs)
+    {
+        fadeMs = maxFadeMs;
+        endPercentage = max(scheduleLayer.table[index].levelAt(msToday + fadeMs), moonLayer.table[index].levelAt(0));
+        endDuty = dutyCycleFor(index, endPercentage);
+    }
+
+    /* the hpoint does not move during a fade and an LEDC pulse cannot run past the end of the period */
+    const bool fitsPeriod = writtenPhase(index) + max(dutyCycle, endDuty) <= channelConfig.maxDuty[index] + 1;
+
+    if (fadeMs < MIN_HARDWARE_FADE_MS || endDuty == dutyCycle || !fitsPeriod)
+    {
+        stopHardwareFade(index);
+        writeDuty(index, dutyCycle);
+        return;
+    }
+
+    const ledc_mode_t mode = ledcMode(index);
+    const ledc_channel_t channel = ledcChannel(index);
+
+    if (fade.active)
+        ledc_fade_stop(mode, channel);
+
+    /* fades from the duty the hardware is at - within tolerance of dutyCycle */
+    if (ledc_set_fade_time_and_start(mode, channel, endDuty, fadeMs, LEDC_FADE_NO_WAIT) != ESP_OK)
+    {
+        log_w("Error starting hardware fade on pin %i - using software writes", channelConfig.pin[index]);
+        fade.active = false;
+        lastDuty[index] = UINT32_MAX;
+        writeDuty(index, dutyCycle);
+        return;
+    }
+
+    fade = {dutyCycle, endDuty, now, fadeMs, true};
+    lastDuty[index] = UINT32_MAX;
+    log_v("ch %i hardware fade %u -> %u in %u ms", index, dutyCycle, endDuty, fadeMs);
+}
+
+/* compare the duty the fade should be at with what the hardware reports */
+static void verifyHardwareFades(const unsigned long now)
+{
+    for (int index = 0; index < channelConfig.count; index++)
+    {
+        hardwareFade_t &fade = hardwareFade[index];
+        if (!fade.active)
+            continue;
+
+        const uint32_t expected = fade.expectedDuty(now);
+        const uint32_t actual = ledc_get_duty(ledcMode(index), ledcChannel(index));
+        if (abs(int32_t(actual) - int32_t(expected)) > HARDWARE_FADE_VERIFY_TOLERANCE)
+        {
+            hardwareFadeMismatches++;
+            log_w("ch %i hardware fade at %u but expected %u - restarting fade", index, actual, expected);
+            stopHardwareFade(index);
+        }
+    }
+}
+
+void dimmerTask(void *parameter)
+{
+    waitForBootStages(bootBit(BOOT_STORAGE) | bootBit(BOOT_TIME));
 
 #ifdef LGFX_M5STACK
     static constexpr int BACKLIGHT_PIN = 32;
-    if (!ledcChangeFrequency(BACKLIGHT_PIN, freq, PWM_BITDEPTH) ||
-        !ledcWrite(BACKLIGHT_PIN, LEDC_MAX_VALUE >> 3))
+    if (!ledcChangeFrequency(BACKLIGHT_PIN, DEFAULT_PWM_FREQUENCY, DEFAULT_PWM_BITDEPTH) ||
+        !ledcWrite(BACKLIGHT_PIN, ((1UL << DEFAULT_PWM_BITDEPTH) - 1) >> 3))
         log_w("Could not capture M5Stack backlight");
 #endif
 
-    for (int index = 0; index < NUMBER_OF_CHANNELS; index++)
-        if (!ledcAttachChannel(ledPin[index], freq, PWM_BITDEPTH, index + 2))
+#if defined(PCA9685_SDA) && defined(PCA9685_SCL)
+    bool pca9685Started = false;
+#endif
+
+    for (int index = 0; index < channelConfig.count; index++)
+    {
+        lastDuty[index] = UINT32_MAX;
+        lastPhase[index] = UINT32_MAX;
+
+#if defined(PCA9685_SDA) && defined(PCA9685_SCL)
+        if (channelConfig.output[index] == OUTPUT_PCA9685)
+        {
+            if (!pca9685Started && (!Wire1.begin(PCA9685_SDA, PCA9685_SCL, 400000) || !pca9685.begin(channelConfig.frequency[index])))
+            {
+                log_e("Error starting PCA9685 at address 0x%02x. system halted", PCA9685_ADDRESS);
+                while (1)
+                    delay(1000);
+            }
+            pca9685Started = true;
+            output[index] = &pca9685;
+            continue;
+        }
+#endif
+
+        if (!ledcAttachChannel(channelConfig.pin[index], channelConfig.frequency[index], channelConfig.bitDepth[index], channelConfig.ledcChannel[index]))
         {
-            log_e("Error setting ledc pin %i. system halted", index);
+            log_e("Error setting ledc pin %i. system halted", channelConfig.pin[index]);
             while (1)
                 delay(1000);
         }
+        ledc.attach(channelConfig.pin[index], channelConfig.ledcChannel[index]);
+        output[index] = &ledc;
+    }
+
+    if (HARDWARE_FADE)
+    {
+        const esp_err_t result = ledc_fade_func_install(0);
+        if (result != ESP_OK && result != ESP_ERR_INVALID_STATE) /* already installed */
+            log_e("could not install ledc fade function - using software writes");
+        hardwareFadeInstalled = result == ESP_OK || result == ESP_ERR_INVALID_STATE;
+    }
+
+    {
+        ScopedMutex lock(channelMutex);
+
+        strcpy(scheduleLayer.name, "schedule");
+        scheduleLayer.priority = SCHEDULE_PRIORITY;
+        scheduleLayer.blend = BLEND_REPLACE;
+        scheduleLayer.dayClock = true;
+
+        strcpy(effectLayer.name, "weather");
+        effectLayer.priority = EFFECT_PRIORITY;
+        effectLayer.dayClock = true;
+        effectLayer.day = localDayNumber();
+
+        strcpy(moonLayer.name, "moon");
+        moonLayer.priority = MOON_PRIORITY;
+        moonLayer.blend = BLEND_MAX;
+
+        for (int index = 0; index < channelConfig.count; index++)
+        {
+            scheduleLayer.channelMask |= 1UL << index;
+            moonLayer.channelMask |= 1UL << index;
+
+            overrideLayer[index].channelMask = 1UL << index;
+            overrideLayer[index].priority = OVERRIDE_PRIORITY;
+            overrideLayer[index].blend = BLEND_REPLACE;
+            snprintf(overrideLayer[index].name, sizeof(overrideLayer[index].name), "override %i", index);
+        }
+
+        scheduleLayer.activate(millis(), 0);
+        moonLayer.activate(millis(), 0);
+        rebuildLayerStacks();
+        compiledVersion = scheduleVersion - 1;
+    }
+
+    bootStageReady(BOOT_DIMMER);
 
     MoonPhase moonPhase;
     moonData_t moon = moonPhase.getPhase();
+    bool moonChanged = true;
 
     constexpr int MOON_UPDATE_INTERVAL_SEC = 15;
     time_t nextMoonUpdate = time(NULL) + MOON_UPDATE_INTERVAL_SEC;
@@ -77,13 +536,52 @@ void dimmerTask(void *parameter)
     constexpr TickType_t ticksToWait = pdMS_TO_TICKS(1000 / TICK_RATE_HZ);
     TickType_t xLastWakeTime = xTaskGetTickCount();
 
+    /* when NTP corrects a holdover time the clock steps - fade to the new levels instead of jumping */
+    constexpr unsigned int MS_PER_DAY = 86400 * 1000U;
+    constexpr unsigned int CLOCK_STEP_THRESHOLD_MS = 2000;
+    constexpr unsigned long CLOCK_STEP_FADE_MS = 30000;
+    bool clockStepped = false;
+    unsigned int lastMsElapsedToday = msSinceMidnight();
+    TickType_t lastTickCount = xLastWakeTime;
+
+    constexpr int64_t TICK_PERIOD_US = 1000000 / TICK_RATE_HZ;
+    int64_t wokeUs = 0;
+
     while (1)
     {
+        /* measured here so passes that end with a continue are counted too */
+        if (wokeUs)
+            dimmerLoopDuration.record(esp_timer_get_time() - wokeUs);
+
         vTaskDelayUntil(&xLastWakeTime, ticksToWait);
 
+        {
+            const int64_t nowUs = esp_timer_get_time();
+            if (wokeUs)
+            {
+                const int64_t interval = nowUs - wokeUs;
+                dimmerLoopJitter.record(interval > TICK_PERIOD_US ? interval - TICK_PERIOD_US : TICK_PERIOD_US - interval);
+                if (interval >= 2 * TICK_PERIOD_US)
+                    dimmerOverruns.fetch_add(1, std::memory_order_relaxed);
+            }
+            wokeUs = nowUs;
+            dimmerLoops.fetch_add(1, std::memory_order_relaxed);
+        }
+
         {
             const auto msElapsedToday = msSinceMidnight();
 
+            const unsigned int expectedMs = (lastMsElapsedToday + pdTICKS_TO_MS(xLastWakeTime - lastTickCount)) % MS_PER_DAY;
+            const unsigned int drift = msElapsedToday > expectedMs ? msElapsedToday - expectedMs : expectedMs - msElapsedToday;
+            lastMsElapsedToday = msElapsedToday;
+            lastTickCount = xLastWakeTime;
+
+            if (min(drift, MS_PER_DAY - drift) > CLOCK_STEP_THRESHOLD_MS)
+            {
+                log_i("clock stepped %u ms - fading to new light levels", drift);
+                clockStepped = true;
+            }
+
             if (!msElapsedToday) /* to prevent flashing lights at 00:00:000 */
                 continue;
 
@@ -92,37 +590,114 @@ void dimmerTask(void *parameter)
             if (!lock.acquired())
                 continue;
 
-            for (int index = 0; index < NUMBER_OF_CHANNELS; index++)
+            const unsigned long now = millis();
+
+            if (compiledVersion != scheduleVersion)
             {
-                int currentTimer = 0;
-                while (channel[index][currentTimer].time * 1000U < msElapsedToday)
-                    currentTimer++;
+                compileSchedule();
+                compiledVersion = scheduleVersion;
+                moonChanged = true;
+                startTransitions(UINT32_MAX, SCHEDULE_FADE_MS);
+            }
 
-                currentTimer = (currentTimer >= channel[index].size()) ? channel[index].size() - 1 : currentTimer;
+            if (clockStepped)
+                startTransitions(UINT32_MAX, CLOCK_STEP_FADE_MS);
 
-                const float newPercentage =
-                    (currentTimer > 0 && channel[index][currentTimer].percentage != channel[index][currentTimer - 1].percentage)
-                        ? mapf(msElapsedToday,
-                               channel[index][currentTimer - 1].time * 1000U,
-                               channel[index][currentTimer].time * 1000U,
-                               channel[index][currentTimer - 1].percentage,
-                               channel[index][currentTimer].percentage)
-                        : channel[index][currentTimer].percentage;
+            if (moonChanged)
+            {
+                for (int index = 0; index < channelConfig.count; index++)
+                    moonLayer.table[index].setConstant(fullMoonLevel[index] * moon.amountLit);
+                effectLayer.day = localDayNumber();
+                moonChanged = false;
+            }
 
-                const float currentMoonLevel = fullMoonLevel[index] * moon.amountLit;
+            uint32_t expiredMask = 0;
+            for (auto &layer : sceneLayer)
+                if (layer.expired(now))
+                {
+                    layer.active = false;
+                    expiredMask |= layer.channelMask;
+                }
+            for (int index = 0; index < channelConfig.count; index++)
+                if (overrideLayer[index].expired(now))
+                {
+                    overrideLayer[index].active = false;
+                    expiredMask |= overrideLayer[index].channelMask;
+                }
+            if (expiredMask)
+            {
+                rebuildLayerStacks();
+                startTransitions(expiredMask, SCHEDULE_FADE_MS);
+            }
 
-                currentPercentage[index] = newPercentage < currentMoonLevel ? currentMoonLevel : newPercentage;
+            uint32_t dutyCycle[MAX_CHANNELS];
+            bool softwareWrite[MAX_CHANNELS];
+            uint32_t fadingMask = 0;
 
-                const int dutyCycle = mapf(currentPercentage[index], 0, 100, 0, LEDC_MAX_VALUE);
+            for (int index = 0; index < channelConfig.count; index++)
+            {
+                float targetPercentage = 0;
+                for (size_t i = 0; i < layerStackSize[index]; i++)
+                {
+                    lightLayer *layer = layerStack[index][i];
+                    targetPercentage = layer->apply(index, targetPercentage, msElapsedToday, now - layer->startMs);
+                }
+
+                currentPercentage[index] = transition[index].blend(targetPercentage, now);
+
+                const double exactDuty = exactDutyFor(index, currentPercentage[index]);
+                dutyCycle[index] = exactDuty;
+                softwareWrite[index] = !(hardwareFadeInstalled && canHardwareFade(index, now));
+
+                if (!softwareWrite[index])
+                {
+                    dither[index].reset();
+                    updateHardwareFade(index, dutyCycle[index], now, msElapsedToday);
+
+                    /* a hardware fade keeps the hpoint it started with - planPulses() places the other channels around it */
+                    if (hardwareFade[index].active)
+                    {
+                        fadingMask |= 1UL << index;
+                        plannedPhase[index] = writtenPhase(index);
+                    }
+                }
+                else
+                {
+                    stopHardwareFade(index);
+                    if (PWM_DITHER)
+                        dutyCycle[index] = dither[index].next(exactDuty, channelConfig.maxDuty[index]);
+                }
+            }
 
-                if (!ledcWrite(ledPin[index], dutyCycle))
-                    log_w("Error setting duty cycle %i on pin %i", dutyCycle, ledPin[index]);
+            lightState_t state;
+            planPulses(channelConfig, dutyCycle, fadingMask, PWM_STAGGER, plannedPhase, state.pulseStart, state.pulseWidth);
+
+            for (int index = 0; index < channelConfig.count; index++)
+                if (softwareWrite[index])
+                    writeDuty(index, dutyCycle[index]);
+            flushOutputs();
+            clockStepped = false;
+
+            state.updatedUs = esp_timer_get_time();
+            state.time = time(NULL);
+            state.scheduleVersion = compiledVersion;
+            state.moonFraction = moon.amountLit;
+            state.count = channelConfig.count;
+            std::copy(currentPercentage, currentPercentage + channelConfig.count, state.level);
+            lightState.publish(state);
+
+            static unsigned long lastVerify = 0;
+            if (hardwareFadeInstalled && now - lastVerify >= HARDWARE_FADE_VERIFY_INTERVAL_MS)
+            {
+                verifyHardwareFades(now);
+                lastVerify = now;
             }
         }
 
         if (time(NULL) >= nextMoonUpdate)
         {
             moon = moonPhase.getPhase();
+            moonChanged = true;
             nextMoonUpdate += MOON_UPDATE_INTERVAL_SEC;
         }
 
@@ -133,13 +708,9 @@ void dimmerTask(void *parameter)
         {
             websocketMessage msg;
             msg.type = LIGHT_UPDATE;
-            snprintf(msg.str, sizeof(msg.str), "LIGHT\n%f\n%f\n%f\n%f\n%f\n",
-                     currentPercentage[0],
-                     currentPercentage[1],
-                     currentPercentage[2],
-                     currentPercentage[3],
-                     currentPercentage[4]);
-            xQueueSend(websocketQueue, &msg, 0);
+            msg.count = channelConfig.count;
+            std::copy(currentPercentage, currentPercentage + channelConfig.count, msg.value);
+            dimmerToWebsocket.push(msg);
             lastWebsocketRefresh = millis();
         }
 
@@ -151,7 +722,7 @@ void dimmerTask(void *parameter)
         {
             lcdMessage_t msg;
             msg.type = lcdMessageType::UPDATE_LIGHTS;
-            xQueueSend(lcdQueue, &msg, 0);
+            dimmerToLcd.push(msg);
             lastLcdRefresh = millis();
         }
 #endif
@@ -26,23 +26,102 @@ SOFTWARE.
 
 #include <esp32-hal.h>
 #include <hal/ledc_types.h>
-#include <vector>
+#include <driver/ledc.h>
 #include <MoonPhase.hpp>
 
+#if defined(PCA9685_SDA) && defined(PCA9685_SCL)
+#include <Wire.h>
+#endif
+
 #include "ScopedMutex.h"
 #include "lightTimer.h"
+#include "colorTarget.h"
+#include "channelConfig.h"
+#include "outputBackend.h"
+#include "dutyDither.h"
+#include "phaseStagger.h"
+#include "lightTransition.h"
+#include "lightLayer.h"
+#include "weatherEffects.h"
 #include "lcdMessage.h"
 #include "websocketMessage.h"
+#include "bootState.h"
+#include "stateBoard.h"
+#include "requestArena.h"
 
 extern float mapf(const float x, const float in_min, const float in_max, const float out_min, const float out_max);
 
-extern QueueHandle_t lcdQueue;
-extern QueueHandle_t websocketQueue;
+extern lcdRing_t dimmerToLcd;
+extern websocketRing_t dimmerToWebsocket;
 
-std::vector<lightTimer_t> channel[NUMBER_OF_CHANNELS];
+channelConfig_t channelConfig; /* set by loadChannelConfig() before any task starts */
+
+timerList_t channel[MAX_CHANNELS];
 SemaphoreHandle_t channelMutex;
+uint32_t scheduleVersion = 0; /* bumped by every writer of channel[], colorSchedule, scheduleScale or fullMoonLevel[] */
+colorSchedule_t colorSchedule; /* protected by channelMutex - replaces the timers of the channels it drives while active */
+float scheduleScale = 1; /* acclimation set by the calendar task - protected by channelMutex */
+static uint32_t compiledVersion; /* of the schedule in scheduleLayer - protected by channelMutex */
+
+static float currentPercentage[MAX_CHANNELS] = {};
+seqlock<lightState_t> lightState;
+
+latencyHistogram dimmerLoopJitter;
+latencyHistogram dimmerLoopDuration;
+std::atomic<uint32_t> dimmerLoops{0};
+std::atomic<uint32_t> dimmerOverruns{0};
+float fullMoonLevel[MAX_CHANNELS] = {};
+
+static outputBackend *output[MAX_CHANNELS];
+static uint32_t lastDuty[MAX_CHANNELS];
+static uint32_t lastPhase[MAX_CHANNELS];
+static uint32_t plannedPhase[MAX_CHANNELS]; /* in duty cycle steps - set every tick by planPulses(), kept during a hardware fade */
+static dutyDither dither[MAX_CHANNELS];
+
+struct hardwareFade_t
+{
+    uint32_t startDuty;
+    uint32_t endDuty;
+    unsigned long startMs;
+    uint32_t durationMs;
+    bool active;
+
+    uint32_t expectedDuty(const unsigned long nowMs) const
+    {
+        const unsigned long elapsed = nowMs - startMs;
+        if (elapsed >= durationMs)
+            return endDuty;
+        return startDuty + (int64_t(endDuty) - int64_t(startDuty)) * int64_t(elapsed) / int64_t(durationMs);
+    }
+};
+
+static constexpr uint32_t MAX_HARDWARE_FADE_MS = 60 * 1000;
+static constexpr uint32_t MIN_HARDWARE_FADE_MS = 100;
+static constexpr int HARDWARE_FADE_TOLERANCE = 2;          /* LSB between the computed output and the running fade */
+static constexpr int HARDWARE_FADE_VERIFY_TOLERANCE = 16;  /* LSB between the expected and the read back duty */
+static constexpr unsigned long HARDWARE_FADE_VERIFY_INTERVAL_MS = 1000;
+
+static hardwareFade_t hardwareFade[MAX_CHANNELS] = {};
+static bool hardwareFadeInstalled = false;
+uint32_t hardwareFadeMismatches = 0;
+
+/* protected by channelMutex */
+static lightTransition_t transition[MAX_CHANNELS] = {};
+
+static constexpr uint8_t SCHEDULE_PRIORITY = 0;
+static constexpr uint8_t EFFECT_PRIORITY = 5;
+static constexpr uint8_t MOON_PRIORITY = 10;
+static constexpr uint8_t OVERRIDE_PRIORITY = 255;
+
+static segmentLayer<MAX_TIMERS_PER_CHANNEL - 1, MAX_CHANNELS> scheduleLayer;
+static weatherEffectLayer<MAX_CHANNELS> effectLayer;
+static bool weatherEffectsOn = true; /* set by an enabled= line in the effects file or POST /api/effects */
+static segmentLayer<1, MAX_CHANNELS> moonLayer;
+static sceneLayer_t sceneLayer[MAX_ACTIVE_SCENES];
+static constantLayer overrideLayer[MAX_CHANNELS];
 
-float currentPercentage[NUMBER_OF_CHANNELS] = {0, 0, 0, 0, 0};
-float fullMoonLevel[NUMBER_OF_CHANNELS] = {0, 0, 0, 0, 0};
+static constexpr size_t MAX_LAYERS_PER_CHANNEL = 3 + MAX_ACTIVE_SCENES + 1;
+static lightLayer *layerStack[MAX_CHANNELS][MAX_LAYERS_PER_CHANNEL];
+static size_t layerStackSize[MAX_CHANNELS] = {};
 
 #endif
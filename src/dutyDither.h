@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _DUTYDITHER_H_
+#define _DUTYDITHER_H_
+
+#include <stdint.h>
+
+/*
+    First order sigma-delta on the duty cycle of one channel.
+    Every tick the output is one of the two duty cycles around the wanted value and the rounding
+    error carries over to the next tick, so the average over some ticks is the wanted value.
+    The error is carried in 1/65536 of a step so it adds up exactly.
+    The duty cycle is a double - a float near the top of a 20 bit channel has no bits left for the part between two steps.
+*/
+class dutyDither
+{
+public:
+    uint32_t next(const double duty, const uint32_t maxDuty)
+    {
+        if (duty <= 0.0)
+        {
+            error = 0;
+            return 0;
+        }
+
+        if (duty >= maxDuty)
+        {
+            error = 0;
+            return maxDuty;
+        }
+
+        /* split before scaling - a 20 bit duty cycle in 1/65536 steps does not fit 32 bits */
+        uint32_t output = duty;
+        error += uint32_t((duty - output) * 65536.0);
+        if (error >= 0x10000)
+        {
+            error -= 0x10000;
+            output++;
+        }
+
+        return output;
+    }
+
+    void reset() { error = 0; }
+
+private:
+    uint32_t error = 0; /* carried fraction of one step in 1/65536 */
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _EVENTSTREAM_H_
+#define _EVENTSTREAM_H_
+
+#include <PsychicHttp.h>
+#include <freertos/semphr.h>
+
+#include "ScopedMutex.h"
+#include "websocketMessage.h"
+
+/*
+    Server-sent events fed from the same messages as the websockets.
+    Every message is formatted once into an event frame that all clients share.
+    The last frames are kept so a client that reconnects with Last-Event-ID gets what it missed.
+*/
+class eventStream
+{
+public:
+    static constexpr size_t MAX_CLIENTS = 8; /* max_open_sockets */
+    static constexpr size_t HISTORY = 16;    /* 2 seconds of light updates */
+    static constexpr size_t FRAME_SIZE = 48 + MAX_CHANNELS * 9;
+
+    bool begin()
+    {
+        mutex = xSemaphoreCreateMutex();
+        return mutex;
+    }
+
+    /* from the httpTask */
+    void publish(const websocketMessage &msg)
+    {
+        ScopedMutex lock(mutex, pdMS_TO_TICKS(100));
+        if (!lock.acquired())
+            return;
+
+        frame_t &frame = history[nextId % HISTORY];
+        frame.id = nextId++;
+        frame.type = msg.type;
+
+        size_t length = snprintf(frame.text, FRAME_SIZE, "id: %" PRIu32 "\nevent: %s\ndata: ", frame.id,
+                                 msg.type == LIGHT_UPDATE ? "light" : "temperature");
+        for (int i = 0; i < msg.count && length < FRAME_SIZE; i++)
+            length += snprintf(frame.text + length, FRAME_SIZE - length, i ? ",%.3f" : "%.3f", msg.value[i]);
+        if (length < FRAME_SIZE)
+            snprintf(frame.text + length, FRAME_SIZE - length, "\n\n");
+
+        latest[msg.type] = frame;
+
+        const unsigned long now = millis();
+        for (auto &client : clients)
+        {
+            if (!client.client)
+                continue;
+
+            /* a light update is a full state so a rate limited client can skip some - temperatures are rare and always sent */
+            if (msg.type == LIGHT_UPDATE)
+            {
+                if (now - client.lastLightMs < client.minIntervalMs)
+                    continue;
+                client.lastLightMs = now;
+            }
+
+            client.client->sendEvent(frame.text);
+        }
+    }
+
+    /* from the httpd onOpen callback - sends what the client missed since lastId */
+    bool addClient(PsychicEventSourceClient *client, const uint32_t minIntervalMs, const uint32_t lastId)
+    {
+        ScopedMutex lock(mutex, pdMS_TO_TICKS(100));
+        if (!lock.acquired())
+            return false;
+
+        for (auto &slot : clients)
+        {
+            if (slot.client)
+                continue;
+
+            slot = {client, minIntervalMs, millis() - minIntervalMs};
+            replay(client, lastId);
+            return true;
+        }
+        return false;
+    }
+
+    void removeClient(PsychicEventSourceClient *client)
+    {
+        ScopedMutex lock(mutex);
+        for (auto &slot : clients)
+            if (slot.client == client)
+                slot.client = nullptr;
+    }
+
+private:
+    struct frame_t
+    {
+        uint32_t id;
+        websocketMessageType type;
+        char text[FRAME_SIZE];
+    };
+
+    struct client_t
+    {
+        PsychicEventSourceClient *client;
+        uint32_t minIntervalMs;
+        unsigned long lastLightMs;
+    };
+
+    SemaphoreHandle_t mutex = nullptr;
+    frame_t history[HISTORY] = {};
+    frame_t latest[2] = {}; /* per websocketMessageType - outlives the history */
+    uint32_t nextId = 1;
+    client_t clients[MAX_CLIENTS] = {};
+
+    void replay(PsychicEventSourceClient *client, const uint32_t lastId)
+    {
+        const uint32_t oldest = nextId > HISTORY ? nextId - HISTORY : 1;
+
+        /* ids restart at boot - an unknown or too old id gets the current state instead */
+        if (lastId && lastId + 1 >= oldest && lastId < nextId)
+        {
+            for (uint32_t id = lastId + 1; id < nextId; id++)
+                client->sendEvent(history[id % HISTORY].text);
+            return;
+        }
+
+        for (const auto &frame : latest)
+            if (frame.id)
+                client->sendEvent(frame.text);
+    }
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _FIXEDVECTOR_H_
+#define _FIXEDVECTOR_H_
+
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+
+/* the parts of std::vector this app uses, on a fixed capacity array instead of the heap */
+template <typename T, size_t CAPACITY>
+class fixedVector
+{
+    static_assert(std::is_trivially_copyable<T>::value, "items are moved with memmove");
+
+public:
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+    bool full() const { return count == CAPACITY; }
+    static constexpr size_t capacity() { return CAPACITY; }
+    void clear() { count = 0; }
+
+    T *data() { return item; }
+    const T *data() const { return item; }
+    iterator begin() { return item; }
+    iterator end() { return item + count; }
+    const_iterator begin() const { return item; }
+    const_iterator end() const { return item + count; }
+
+    T &operator[](const size_t index) { return item[index]; }
+    const T &operator[](const size_t index) const { return item[index]; }
+    T &front() { return item[0]; }
+    T &back() { return item[count - 1]; }
+    const T &front() const { return item[0]; }
+    const T &back() const { return item[count - 1]; }
+
+    /* false when full */
+    bool push_back(const T &value)
+    {
+        if (full())
+            return false;
+
+        item[count++] = value;
+        return true;
+    }
+
+    void pop_back() { count--; }
+
+    /* returns end() when full */
+    iterator insert(iterator pos, const T &value)
+    {
+        if (full())
+            return end();
+
+        memmove(pos + 1, pos, (end() - pos) * sizeof(T));
+        *pos = value;
+        count++;
+        return pos;
+    }
+
+private:
+    T item[CAPACITY];
+    size_t count = 0;
+};
+
+#endif
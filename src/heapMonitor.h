@@ -0,0 +1,68 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _HEAPMONITOR_H_
+#define _HEAPMONITOR_H_
+
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include "stateBoard.h"
+
+static constexpr size_t HEAP_HISTORY_SIZE = 60;
+static constexpr uint32_t HEAP_SAMPLE_INTERVAL_MS = 60 * 1000;
+
+struct heapSample_t
+{
+    uint32_t uptimeSec;
+    uint32_t freeBytes;
+    uint32_t minimumFreeBytes; /* lowest since boot */
+    uint32_t largestFreeBlock;
+};
+
+/* the last HEAP_HISTORY_SIZE samples - oldest first from index (next - count) */
+struct heapHistory_t
+{
+    heapSample_t sample[HEAP_HISTORY_SIZE];
+    uint32_t next;
+    uint32_t count;
+
+    void add(const heapSample_t &value)
+    {
+        sample[next++ % HEAP_HISTORY_SIZE] = value;
+        if (count < HEAP_HISTORY_SIZE)
+            count++;
+    }
+
+    const heapSample_t &at(const uint32_t index) const { return sample[(next - count + index) % HEAP_HISTORY_SIZE]; }
+};
+
+static inline heapSample_t sampleHeap()
+{
+    return {uint32_t(esp_timer_get_time() / 1000000),
+            uint32_t(heap_caps_get_free_size(MALLOC_CAP_INTERNAL)),
+            uint32_t(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL)),
+            uint32_t(heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL))};
+}
+
+#endif
@@ -0,0 +1,174 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "holdoverTask.hpp"
+
+#if defined(RTC_SDA) && defined(RTC_SCL)
+static inline uint8_t bcdToDec(const uint8_t val) { return (val >> 4) * 10 + (val & 0x0F); }
+static inline uint8_t decToBcd(const uint8_t val) { return ((val / 10) << 4) | (val % 10); }
+
+static time_t epochFromUtc(const struct tm &utc)
+{
+    /* newlib has no timegm() - days from civil date, see http://howardhinnant.github.io/date_algorithms.html */
+    const int year = utc.tm_year + 1900 - (utc.tm_mon < 2);
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = year - era * 400;
+    const unsigned month = utc.tm_mon + 1;
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + utc.tm_mday - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    const int64_t days = int64_t(era) * 146097 + doe - 719468;
+
+    return days * 86400 + utc.tm_hour * 3600 + utc.tm_min * 60 + utc.tm_sec;
+}
+
+static bool readRtc(time_t &epoch)
+{
+    Wire.beginTransmission(RTC_I2C_ADDRESS);
+    Wire.write(0x00);
+    if (Wire.endTransmission() != 0 || Wire.requestFrom(RTC_I2C_ADDRESS, (uint8_t)7) != 7)
+        return false;
+
+    uint8_t reg[7];
+    for (int i = 0; i < 7; i++)
+        reg[i] = Wire.read();
+
+    if (reg[0] & 0x80) /* DS1307 clock halt bit - oscillator never started */
+        return false;
+
+    struct tm utc = {};
+    utc.tm_sec = bcdToDec(reg[0] & 0x7F);
+    utc.tm_min = bcdToDec(reg[1] & 0x7F);
+    utc.tm_hour = bcdToDec(reg[2] & 0x3F);
+    utc.tm_mday = bcdToDec(reg[4] & 0x3F);
+    utc.tm_mon = bcdToDec(reg[5] & 0x1F) - 1;
+    utc.tm_year = bcdToDec(reg[6]) + 100;
+
+    epoch = epochFromUtc(utc);
+    return true;
+}
+
+static bool writeRtc(const time_t epoch)
+{
+    struct tm utc;
+    gmtime_r(&epoch, &utc);
+
+    Wire.beginTransmission(RTC_I2C_ADDRESS);
+    Wire.write(0x00);
+    Wire.write(decToBcd(utc.tm_sec));
+    Wire.write(decToBcd(utc.tm_min));
+    Wire.write(decToBcd(utc.tm_hour));
+    Wire.write(decToBcd(utc.tm_wday + 1));
+    Wire.write(decToBcd(utc.tm_mday));
+    Wire.write(decToBcd(utc.tm_mon + 1));
+    Wire.write(decToBcd(utc.tm_year - 100));
+    return Wire.endTransmission() == 0;
+}
+#endif
+
+static void saveHoldoverTime()
+{
+    const time_t now = time(NULL);
+    if (!timeIsValid || now < MIN_VALID_EPOCH)
+        return;
+
+    Preferences prefs;
+    if (!prefs.begin(HOLDOVER_NAMESPACE, false))
+    {
+        log_w("could not open nvs namespace '%s'", HOLDOVER_NAMESPACE);
+        return;
+    }
+    prefs.putLong64(HOLDOVER_EPOCH_KEY, now);
+    prefs.end();
+
+#if defined(RTC_SDA) && defined(RTC_SCL)
+    if (!writeRtc(now))
+        log_w("could not write rtc");
+#endif
+
+    log_d("saved holdover time %lli", (long long)now);
+}
+
+bool restoreHoldoverTime()
+{
+    /* localtime has to work before configTzTime() is called from the NTP setup */
+    setenv("TZ", TIMEZONE, 1);
+    tzset();
+
+    time_t estimate = 0;
+
+#if defined(RTC_SDA) && defined(RTC_SCL)
+    Wire.begin(RTC_SDA, RTC_SCL);
+    if (readRtc(estimate) && estimate >= MIN_VALID_EPOCH)
+        log_i("restoring time from rtc");
+    else
+        estimate = 0;
+#endif
+
+    if (!estimate)
+    {
+        Preferences prefs;
+        if (prefs.begin(HOLDOVER_NAMESPACE, true))
+        {
+            const time_t saved = prefs.getLong64(HOLDOVER_EPOCH_KEY, 0);
+            prefs.end();
+
+            /* the power went off somewhere in the save interval - halfway is the best guess */
+            if (saved >= MIN_VALID_EPOCH)
+                estimate = saved + HOLDOVER_SAVE_INTERVAL_SEC / 2;
+        }
+        if (estimate)
+            log_i("restoring time from nvs");
+    }
+
+    if (!estimate)
+    {
+        log_i("no holdover time available");
+        return false;
+    }
+
+    const struct timeval tv = {.tv_sec = estimate, .tv_usec = 0};
+    if (settimeofday(&tv, NULL))
+    {
+        log_e("could not set holdover time");
+        return false;
+    }
+
+    timeIsValid = true;
+
+    char buffer[32];
+    struct tm localTime;
+    localtime_r(&estimate, &localTime);
+    strftime(buffer, sizeof(buffer), "%F %T", &localTime);
+    log_i("estimated time %s", buffer);
+    return true;
+}
+
+void holdoverTask(void *parameter)
+{
+    /* a task notification - for example after an NTP sync - saves right away */
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HOLDOVER_SAVE_INTERVAL_SEC * 1000));
+        saveHoldoverTime();
+    }
+}
@@ -0,0 +1,43 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _HOLDOVERTASK_HPP_
+#define _HOLDOVERTASK_HPP_
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <sys/time.h>
+
+#if defined(RTC_SDA) && defined(RTC_SCL)
+#include <Wire.h>
+static constexpr uint8_t RTC_I2C_ADDRESS = 0x68; /* DS1307/DS3231 share the same timekeeping registers */
+#endif
+
+static constexpr const char *HOLDOVER_NAMESPACE = "holdover";
+static constexpr const char *HOLDOVER_EPOCH_KEY = "epoch";
+static constexpr int HOLDOVER_SAVE_INTERVAL_SEC = 600;
+static constexpr time_t MIN_VALID_EPOCH = 1735689600; /* 2025-01-01 - anything older is an unset clock */
+
+bool timeIsValid = false;
+
+#endif
@@ -34,9 +34,18 @@ static constexpr char *IF_NONE_MATCH = "If-None-Match";
 
 static constexpr char *COULD_NOT_OPEN = "Could not open file";
 
+static constexpr size_t MAX_REPORTED_TASKS = 32;
+static TaskStatus_t taskStatus[MAX_REPORTED_TASKS]; /* uxTaskGetSystemState() fails when there are more tasks than slots */
+
 static char contentCreationTime[30];
 static char etagValue[16];
 
+/* response bodies are built here instead of on the heap - handlers run one at a time in the httpd task */
+static uint8_t arenaMemory[8192];
+static requestArena arena(arenaMemory, sizeof(arenaMemory));
+
+static seqlock<heapHistory_t> heapMonitor;
+
 static inline bool samePageIsCached(PsychicRequest *request)
 {
     bool modifiedSince = request->hasHeader(IF_MODIFIED_SINCE) && request->header(IF_MODIFIED_SINCE).equals(contentCreationTime);
@@ -70,9 +79,10 @@ bool loadMoonSettings(String &result)
         return false;
     }
 
-    std::array<float, NUMBER_OF_CHANNELS> tempMoonLevel;
+    std::array<float, MAX_CHANNELS> tempMoonLevel;
 
     {
+        phaseTimer storage(taskPhases.storageUs);
         File file = SD.open(MOON_SETTINGS_FILE, FILE_READ);
         if (!file)
         {
@@ -82,7 +92,7 @@ bool loadMoonSettings(String &result)
 
         log_i("parsing '%s'", file.path());
 
-        for (int i = 0; i < NUMBER_OF_CHANNELS; ++i)
+        for (int i = 0; i < channelConfig.count; ++i)
         {
             String header = file.readStringUntil('\n');
             String value = file.readStringUntil('\n');
@@ -124,7 +134,8 @@ bool loadMoonSettings(String &result)
             return false;
         }
 
-        std::copy(tempMoonLevel.begin(), tempMoonLevel.end(), fullMoonLevel);
+        std::copy(tempMoonLevel.begin(), tempMoonLevel.begin() + channelConfig.count, fullMoonLevel);
+        scheduleVersion++;
     }
 
     result = "Moon settings processed";
@@ -139,6 +150,8 @@ bool saveMoonSettings(String &result)
         result = "spiMutex timeout";
         return false;
     }
+
+    phaseTimer storage(taskPhases.storageUs);
     File file = SD.open(MOON_SETTINGS_FILE, FILE_WRITE);
     if (!file)
     {
@@ -154,7 +167,7 @@ bool saveMoonSettings(String &result)
             return false;
         }
 
-        for (int i = 0; i < NUMBER_OF_CHANNELS; ++i)
+        for (int i = 0; i < channelConfig.count; ++i)
         {
             file.printf("[%d]\n", i);
             file.printf("%.6f\n", fullMoonLevel[i]);
@@ -166,237 +179,1437 @@ bool saveMoonSettings(String &result)
     return true;
 }
 
-static void setupWebsocketHandler(PsychicWebSocketHandler &websocketHandler)
+/*
+    Weather effects per channel, all settings are optional
+
+    enabled=1               0 switches all effects off - without it the effects stay as they were
+    [0]
+    seed=1234
+    clouds=40,120           depth %, seconds between cloud passes
+    lightning=6,100         strikes per hour, flash level %
+    flicker=10,21600,23400  depth %, from and to in seconds since midnight
+*/
+bool loadEffectSettings(String &result)
 {
-#define SHOW_WS_CONNECTIONS 0
-#if SHOW_WS_CONNECTIONS
-    websocketHandler.onOpen(
-        [](PsychicWebSocketClient *client)
+    weatherEffect_t effect[MAX_CHANNELS] = {};
+    int enabled = -1;
+
+    {
+        ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+        if (!lock.acquired())
         {
-            log_i("[socket] connection #%u connected from %s", client->socket(), client->remoteIP().toString());
-        });
+            result = "Mutex timeout";
+            return false;
+        }
 
-    websocketHandler.onClose(
-        [](PsychicWebSocketClient *client)
+        phaseTimer storage(taskPhases.storageUs);
+        File file = SD.open(EFFECT_SETTINGS_FILE, FILE_READ);
+        if (!file)
         {
-            log_i("[socket] connection #%u closed", client->socket());
-        });
-#endif
+            result = COULD_NOT_OPEN;
+            return false;
+        }
 
-    websocketHandler.onFrame(
-        [](PsychicWebSocketRequest *request, httpd_ws_frame *frame)
+        log_i("parsing '%s'", file.path());
+
+        int currentChannel = -1;
+        int currentLine = 0;
+        while (file.available())
         {
-            log_i("received websocket frame: %s", reinterpret_cast<char *>(frame->payload));
+            String line = file.readStringUntil('\n');
+            currentLine++;
 
-            String wsResponse = "recieved: \n";
-            wsResponse += reinterpret_cast<char *>(frame->payload);
+            const int comment = line.indexOf('#');
+            if (comment != -1)
+                line.remove(comment);
 
-            return request->reply(wsResponse.c_str());
-        });
+            line.trim();
+            if (line.isEmpty())
+                continue;
+
+            if (line.startsWith("["))
+            {
+                if (sscanf(line.c_str(), "[%d]", &currentChannel) != 1 || currentChannel < 0 || currentChannel >= channelConfig.count)
+                {
+                    result = "invalid channel at line " + String(currentLine);
+                    return false;
+                }
+                effect[currentChannel].seed = currentChannel + 1;
+                continue;
+            }
+
+            weatherEffect_t &fx = effect[currentChannel < 0 ? 0 : currentChannel];
+            unsigned int a = 0, b = 0, c = 0;
+            bool valid = currentChannel >= 0;
+
+            if (sscanf(line.c_str(), "enabled=%u", &a) == 1 && a <= 1)
+            {
+                enabled = a;
+                valid = true;
+            }
+            else if (valid && sscanf(line.c_str(), "seed=%u", &a) == 1)
+                fx.seed = a;
+            else if (valid && sscanf(line.c_str(), "clouds=%u,%u", &a, &b) == 2 && a <= 100 && b > 0 && b <= 3600)
+            {
+                fx.cloudDepth = a;
+                fx.cloudPeriodSec = b;
+            }
+            else if (valid && sscanf(line.c_str(), "lightning=%u,%u", &a, &b) == 2 && a <= 255 && b <= 100)
+            {
+                fx.lightningPerHour = a;
+                fx.lightningLevel = b;
+            }
+            else if (valid && sscanf(line.c_str(), "flicker=%u,%u,%u", &a, &b, &c) == 3 && a <= 100 && b < c && c <= 86400)
+            {
+                fx.flickerDepth = a;
+                fx.flickerFromSec = b;
+                fx.flickerToSec = c;
+            }
+            else
+                valid = false;
+
+            if (!valid)
+            {
+                result = "invalid setting at line " + String(currentLine);
+                return false;
+            }
+        }
+    }
+
+    {
+        ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+        if (!lock.acquired())
+        {
+            result = "channelMutex timeout";
+            return false;
+        }
+
+        setWeatherEffects(effect, enabled < 0 ? weatherEffectsEnabled() : enabled);
+    }
+
+    result = "Weather effects processed";
+    return true;
 }
 
-static std::optional<uint8_t> validateChannel(PsychicRequest *request, PsychicResponse *response)
+/* keeps the switch of POST /api/effects over a reboot */
+bool saveEffectSettings(String &result)
 {
-    constexpr char *CHANNEL = "channel";
-
-    if (!request->hasParam(CHANNEL))
+    ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+    if (!lock.acquired())
     {
-        response->send(400, TEXT_PLAIN, "No channel parameter provided");
-        return std::nullopt;
+        result = "spiMutex timeout";
+        return false;
     }
 
-    const String &channelStr = request->getParam(CHANNEL)->value();
+    phaseTimer storage(taskPhases.storageUs);
+    File file = SD.open(EFFECT_SETTINGS_FILE, FILE_WRITE);
+    if (!file)
+    {
+        result = COULD_NOT_OPEN;
+        return false;
+    }
 
-    if (channelStr.length() != 1 || channelStr[0] < '0' || channelStr[0] > '4')
     {
-        response->send(400, TEXT_PLAIN, "Invalid channel parameter (must be a number 0-4)");
-        return std::nullopt;
+        ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+        if (!lock.acquired())
+        {
+            result = "channelMutex timeout";
+            return false;
+        }
+
+        weatherEffect_t effect[MAX_CHANNELS];
+        getWeatherEffects(effect);
+
+        file.printf("enabled=%i\n", weatherEffectsEnabled());
+        for (int i = 0; i < channelConfig.count; i++)
+        {
+            if (!effect[i].enabled())
+                continue;
+
+            file.printf("[%i]\nseed=%u\n", i, (unsigned)effect[i].seed);
+            file.printf("clouds=%u,%u\n", effect[i].cloudDepth, effect[i].cloudPeriodSec);
+            file.printf("lightning=%u,%u\n", effect[i].lightningPerHour, effect[i].lightningLevel);
+            file.printf("flicker=%u,%u,%u\n", effect[i].flickerDepth, (unsigned)effect[i].flickerFromSec, (unsigned)effect[i].flickerToSec);
+        }
     }
 
-    return channelStr[0] - '0';
+    result = "Saved weather effects to ";
+    result.concat(EFFECT_SETTINGS_FILE);
+    return true;
 }
 
-time_t time_diff(struct tm *start, struct tm *end)
-{
-    return mktime(end) - mktime(start);
-}
+/*
+    Colour targets need two files - the channels of the fixture and the keyframes.
 
-static bool handleFileUpload(const String &data, const String &filePath, String &result)
+    /default.fix - chromaticity and relative flux of every channel at 100%, from a datasheet or a measurement
+    [0]
+    xy=0.157,0.018
+    flux=30
+
+    /default.col - seconds since midnight, colour temperature in K and intensity in %
+    0,2700,0
+    28800,6500,80
+*/
+static bool parseFixtureFile(File &file, colorFixture_t &fixture, String &result)
 {
-    File file = SD.open(MOON_SETTINGS_FILE, FILE_WRITE);
-    if (!file)
+    log_i("parsing '%s'", file.path());
+
+    float x[MAX_CHANNELS] = {}, y[MAX_CHANNELS] = {}, flux[MAX_CHANNELS] = {};
+    uint32_t seen = 0;
+    int currentChannel = -1;
+    int currentLine = 0;
+
+    while (file.available())
     {
-        result = COULD_NOT_OPEN;
+        String line = file.readStringUntil('\n');
+        currentLine++;
+
+        const int comment = line.indexOf('#');
+        if (comment != -1)
+            line.remove(comment);
+
+        line.trim();
+        if (line.isEmpty())
+            continue;
+
+        if (line.startsWith("["))
+        {
+            if (sscanf(line.c_str(), "[%d]", &currentChannel) != 1 || currentChannel < 0 || currentChannel >= channelConfig.count ||
+                seen & (1UL << currentChannel))
+            {
+                result = "invalid or duplicate channel at line " + String(currentLine);
+                return false;
+            }
+            seen |= 1UL << currentChannel;
+            continue;
+        }
+
+        const int index = currentChannel < 0 ? 0 : currentChannel;
+        if (currentChannel < 0 || (sscanf(line.c_str(), "xy=%f,%f", &x[index], &y[index]) != 2 && sscanf(line.c_str(), "flux=%f", &flux[index]) != 1))
+        {
+            result = "invalid setting at line " + String(currentLine);
+            return false;
+        }
+    }
+
+    if (!seen)
+    {
+        result = "no channels in fixture file";
         return false;
     }
 
-    const size_t fileSize = data.length();
+    fixture = {};
+    for (int index = 0; index < channelConfig.count; index++)
+    {
+        if (!(seen & (1UL << index)))
+            continue;
 
-    if (file.write(reinterpret_cast<const uint8_t *>(data.c_str()), fileSize) != fileSize)
+        if (!(x[index] > 0 && y[index] > 0 && x[index] + y[index] <= 1 && flux[index] > 0))
+        {
+            result = "no valid xy and flux for channel " + String(index);
+            return false;
+        }
+        fixture.set(index, x[index], y[index], flux[index]);
+    }
+    return true;
+}
+
+static bool parseKeyframeFile(File &file, fixedVector<colorKeyframe_t, MAX_COLOR_KEYFRAMES> &keyframe, String &result)
+{
+    log_i("parsing '%s'", file.path());
+
+    keyframe.clear();
+    int currentLine = 0;
+
+    while (file.available())
     {
-        result = "File save error";
+        String line = file.readStringUntil('\n');
+        currentLine++;
+
+        const int comment = line.indexOf('#');
+        if (comment != -1)
+            line.remove(comment);
+
+        line.trim();
+        if (line.isEmpty())
+            continue;
+
+        int time;
+        float cct, intensity;
+        if (sscanf(line.c_str(), "%d,%f,%f", &time, &cct, &intensity) != 3 || time < 0 || time > 86399 ||
+            !(cct >= MIN_CCT && cct <= MAX_CCT) || !(intensity >= 0 && intensity <= 100))
+        {
+            result = "invalid keyframe at line " + String(currentLine);
+            return false;
+        }
+
+        auto insertPos = std::lower_bound(keyframe.begin(), keyframe.end(), time, [](const colorKeyframe_t &a, const int time)
+                                          { return a.time < time; });
+
+        if (insertPos != keyframe.end() && insertPos->time == time)
+        {
+            result = "duplicate keyframe at line " + String(currentLine);
+            return false;
+        }
+
+        if (keyframe.size() >= MAX_COLOR_KEYFRAMES - 1)
+        {
+            result = "too many keyframes at line " + String(currentLine);
+            return false;
+        }
+
+        keyframe.insert(insertPos, {time, cct, intensity});
+    }
+
+    if (keyframe.empty())
+    {
+        result = "no keyframes in file";
         return false;
     }
 
-    result = "File save OK";
+    keyframe.push_back({86400, keyframe.front().cct, keyframe.front().intensity});
     return true;
 }
 
-static void setupWebserverHandlers(PsychicHttpServer &server, tm *timeinfo)
+/* solves the keyframes against the fixture here - the dimmer only compiles the resulting curves */
+bool loadColorSettings(String &result)
 {
-    server.on(
-        "/", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+    /* too large for the stack - callers are setup() and the httpd task, never at the same time as each other */
+    static colorSchedule_t staging;
+
+    {
+        ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+        if (!lock.acquired())
         {
-            if (samePageIsCached(request))
-                return response->send(304);
+            result = "Mutex timeout";
+            return false;
+        }
 
-            extern const uint8_t index_start[] asm("_binary_src_webui_index_html_gz_start");
-            extern const uint8_t index_end[] asm("_binary_src_webui_index_html_gz_end");
+        phaseTimer storage(taskPhases.storageUs);
+        File fixtureFile = SD.open(FIXTURE_FILE, FILE_READ);
+        File keyframeFile = SD.open(COLOR_KEYFRAME_FILE, FILE_READ);
+        if (!fixtureFile || !keyframeFile)
+        {
+            result = COULD_NOT_OPEN;
+            return false;
+        }
 
-            addStaticContentHeaders(response);
-            response->addHeader(CONTENT_ENCODING, GZIP);
-            response->setContentType(TEXT_HTML);
-            const size_t size = index_end - index_start;
-            response->setContent(index_start, size);
-            return response->send(); }
+        if (!parseFixtureFile(fixtureFile, staging.fixture, result) || !parseKeyframeFile(keyframeFile, staging.keyframe, result))
+            return false;
+    }
 
-    );
+    if (!staging.resolve(channelConfig.count))
+    {
+        result = "the fixture can not mix one of the colour temperatures";
+        return false;
+    }
 
-    server.on(
-        "/editor", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+    size_t offWhite = 0;
+    for (size_t k = 0; k < staging.keyframe.size(); k++)
+        offWhite += staging.distance[k] > MAX_WHITE_DISTANCE;
+
+    staging.active = true;
+
+    {
+        ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+        if (!lock.acquired())
         {
-            if (samePageIsCached(request))
-                return response->send(304);
+            result = "channelMutex timeout";
+            return false;
+        }
 
-            extern const uint8_t editor_start[] asm("_binary_src_webui_editor_html_gz_start");
-            extern const uint8_t editor_end[] asm("_binary_src_webui_editor_html_gz_end");   
+        colorSchedule = staging;
+        scheduleVersion++;
+    }
 
-            addStaticContentHeaders(response);
-            response->addHeader(CONTENT_ENCODING, GZIP);
-            response->setContentType(TEXT_HTML);
-            const size_t size = editor_end - editor_start;
-            response->setContent(editor_start, size);
-            return response->send(); }
+    result = "Colour schedule processed - " + String(staging.keyframe.size() - 1) + " keyframes";
+    if (offWhite)
+        result.concat(", " + String(offWhite) + " off the white locus - see /api/color");
+    return true;
+}
 
-    );
+/*
+    /default.thm - a heater or chiller on THERMOSTAT_PIN
+    mode=pid            off, hysteresis or pid
+    output=relay        relay or pwm
+    action=heat         heat or cool
+    setpoint=25.0       °C
+    hysteresis=0.4      °C, the whole band - hysteresis mode
+    pid=2,0.001,0       kp per °C, ki per °C second, kd per °C per second - pid mode
+    window=600          seconds - a relay in pid mode is on for a part of every window
+    minon=60            seconds a relay stays on at least
+    minoff=60           and off
+    failsafe=0          output in % when the sensor fails
+*/
+bool loadThermostatSettings(String &result)
+{
+    static uint32_t version = 0;
+    thermostatConfig_t config = DEFAULT_THERMOSTAT;
 
-    server.on(
-        "/fileupload", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+    ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+    if (!lock.acquired())
+    {
+        result = "Mutex timeout";
+        return false;
+    }
+
+    phaseTimer storage(taskPhases.storageUs);
+    File file = SD.open(THERMOSTAT_FILE, FILE_READ);
+    if (!file)
+    {
+        result = COULD_NOT_OPEN;
+        return false;
+    }
+
+    log_i("parsing '%s'", file.path());
+
+    int currentLine = 0;
+    while (file.available())
+    {
+        String line = file.readStringUntil('\n');
+        currentLine++;
+
+        const int comment = line.indexOf('#');
+        if (comment != -1)
+            line.remove(comment);
+
+        line.trim();
+        if (line.isEmpty())
+            continue;
+
+        char word[12] = "";
+        float a = 0, b = 0, c = 0;
+        unsigned int n = 0;
+        bool valid = true;
+
+        if (sscanf(line.c_str(), "mode=%11s", word) == 1)
         {
-            if (samePageIsCached(request))
-                return response->send(304);
+            if (!strcmp(word, "off"))
+                config.mode = THERMOSTAT_OFF;
+            else if (!strcmp(word, "hysteresis"))
+                config.mode = THERMOSTAT_HYSTERESIS;
+            else if (!strcmp(word, "pid"))
+                config.mode = THERMOSTAT_PID;
+            else
+                valid = false;
+        }
+        else if (sscanf(line.c_str(), "output=%11s", word) == 1)
+        {
+            if (!strcmp(word, "relay"))
+                config.output = THERMOSTAT_RELAY;
+            else if (!strcmp(word, "pwm"))
+                config.output = THERMOSTAT_PWM;
+            else
+                valid = false;
+        }
+        else if (sscanf(line.c_str(), "action=%11s", word) == 1)
+        {
+            valid = !strcmp(word, "heat") || !strcmp(word, "cool");
+            config.cooling = !strcmp(word, "cool");
+        }
+        else if (sscanf(line.c_str(), "setpoint=%f", &a) == 1 && a >= 0 && a <= 40)
+            config.setpoint = a;
+        else if (sscanf(line.c_str(), "hysteresis=%f", &a) == 1 && a > 0 && a <= 5)
+            config.hysteresis = a;
+        else if (sscanf(line.c_str(), "pid=%f,%f,%f", &a, &b, &c) == 3 && a >= 0 && b >= 0 && c >= 0)
+        {
+            config.kp = a;
+            config.ki = b;
+            config.kd = c;
+        }
+        else if (sscanf(line.c_str(), "window=%u", &n) == 1 && n >= 10 && n <= 3600)
+            config.windowMs = n * 1000;
+        else if (sscanf(line.c_str(), "minon=%u", &n) == 1 && n <= 3600)
+            config.minOnMs = n * 1000;
+        else if (sscanf(line.c_str(), "minoff=%u", &n) == 1 && n <= 3600)
+            config.minOffMs = n * 1000;
+        else if (sscanf(line.c_str(), "failsafe=%u", &n) == 1 && n <= 100)
+            config.failsafe = n / 100.0f;
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            result = "invalid setting at line " + String(currentLine);
+            return false;
+        }
+    }
 
-            extern const uint8_t upload_start[] asm("_binary_src_webui_fileupload_html_gz_start");
-            extern const uint8_t upload_end[] asm("_binary_src_webui_fileupload_html_gz_end");   
+    /* spiMutex keeps setup() and the httpd task from publishing at the same time */
+    config.version = ++version;
+    thermostatConfig.publish(config);
 
-            addStaticContentHeaders(response);
-            response->addHeader(CONTENT_ENCODING, GZIP);
-            response->setContentType(TEXT_HTML);
-            const size_t size = upload_end - upload_start;
-            response->setContent(upload_start, size);
-            return response->send(); }
+    result = "Thermostat " + String(THERMOSTAT_MODE_NAME[config.mode]) + ", setpoint " + String(config.setpoint, 2) + "°C";
+    return true;
+}
+
+static bool validSceneName(const char *name)
+{
+    const size_t length = strlen(name);
+    if (!length || length >= sizeof(lightLayer::name))
+        return false;
+
+    for (const char *p = name; *p; p++)
+        if (!isalnum(*p) && *p != '-' && *p != '_')
+            return false;
+
+    return true;
+}
+
+/*
+    A scene file holds optional settings followed by timers per channel, relative to the start of the scene.
+    Channels that are not in the file are not affected by the scene.
+
+    priority=50
+    blend=replace
+    duration=900
+    [0]
+    0,0
+    300,80
+*/
+static bool parseSceneFile(File &file, sceneLayer_t &scene, unsigned long &durationMs, String &result)
+{
+    static fixedVector<lightTimer_t, MAX_SCENE_SEGMENTS + 1> timers[MAX_CHANNELS]; /* only used from the httpd task */
+    for (auto &list : timers)
+        list.clear();
+
+    int currentChannel = -1;
+    int currentLine = 0;
+
+    scene.priority = 50;
+    scene.blend = BLEND_REPLACE;
+    scene.channelMask = 0;
+    durationMs = 0;
+
+    while (file.available())
+    {
+        String line = file.readStringUntil('\n');
+        currentLine++;
+
+        const int comment = line.indexOf('#');
+        if (comment != -1)
+            line.remove(comment);
+
+        line.trim();
+        if (line.isEmpty())
+            continue;
+
+        if (line.startsWith("["))
+        {
+            if (sscanf(line.c_str(), "[%d]", &currentChannel) != 1 || currentChannel < 0 || currentChannel >= channelConfig.count)
+            {
+                result = "invalid channel at line " + String(currentLine);
+                return false;
+            }
+            continue;
+        }
+
+        const int sep = line.indexOf('=');
+        if (sep != -1)
+        {
+            String key = line.substring(0, sep);
+            String value = line.substring(sep + 1);
+            key.trim();
+            value.trim();
+
+            bool valid = true;
+            if (key.equalsIgnoreCase("priority"))
+            {
+                const long priority = value.toInt();
+                valid = priority > 0 && priority < 255;
+                scene.priority = priority;
+            }
+            else if (key.equalsIgnoreCase("blend"))
+                scene.blend = parseBlendMode(value.c_str(), valid);
+            else if (key.equalsIgnoreCase("duration"))
+            {
+                const long seconds = value.toInt();
+                valid = seconds >= 0 && seconds <= 86400;
+                durationMs = seconds * 1000UL;
+            }
+            else
+                valid = false;
+
+            if (!valid)
+            {
+                result = "invalid setting at line " + String(currentLine);
+                return false;
+            }
+            continue;
+        }
+
+        int time, percentage;
+        if (currentChannel < 0 || sscanf(line.c_str(), "%d,%d", &time, &percentage) != 2 ||
+            time < 0 || time > 86400 || percentage < 0 || percentage > 100 ||
+            (timers[currentChannel].size() && timers[currentChannel].back().time >= time))
+        {
+            result = "invalid timer at line " + String(currentLine);
+            return false;
+        }
+
+        if (!timers[currentChannel].push_back({time, percentage}))
+        {
+            result = "too many timers for channel " + String(currentChannel);
+            return false;
+        }
+    }
+
+    for (int index = 0; index < channelConfig.count; index++)
+        if (timers[index].size())
+        {
+            scene.table[index].compile(timers[index].data(), timers[index].size());
+            scene.channelMask |= 1UL << index;
+        }
+
+    if (!scene.channelMask)
+    {
+        result = "scene has no timers";
+        return false;
+    }
+
+    return true;
+}
+
+static bool startScene(const char *name, const long durationOverride, String &result)
+{
+    if (!validSceneName(name))
+    {
+        result = "Invalid scene name";
+        return false;
+    }
+
+    static sceneLayer_t scene; /* only used from the httpd task */
+    unsigned long durationMs;
+
+    {
+        ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+        if (!lock.acquired())
+        {
+            result = "spiMutex timeout";
+            return false;
+        }
+
+        char path[64];
+        snprintf(path, sizeof(path), "%s/%s%s", SCENE_DIRECTORY, name, SCENE_EXTENSION);
+
+        phaseTimer storage(taskPhases.storageUs);
+        File file = SD.open(path, FILE_READ);
+        if (!file)
+        {
+            result = COULD_NOT_OPEN;
+            return false;
+        }
+
+        if (!parseSceneFile(file, scene, durationMs, result))
+            return false;
+    }
+
+    snprintf(scene.name, sizeof(scene.name), "%s", name);
+    if (durationOverride >= 0)
+        durationMs = durationOverride * 1000UL;
+
+    ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+    if (!lock.acquired())
+    {
+        result = "channelMutex timeout";
+        return false;
+    }
+
+    return activateScene(scene, durationMs, result);
+}
+
+static bool endScene(const char *name, String &result)
+{
+    ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+    if (!lock.acquired())
+    {
+        result = "channelMutex timeout";
+        return false;
+    }
+
+    return stopScene(name, result);
+}
+
+/*
+    The levels on /websocket are public, starting and stopping scenes is not.
+    A client that sends the login of the web interface with its handshake may control scenes - frames carry no headers.
+    Websocket callbacks all run in the httpd task, so the list needs no lock.
+*/
+static constexpr size_t MAX_OPEN_SOCKETS = 8;
+static int controlSocket[MAX_OPEN_SOCKETS];
+static size_t controlSockets = 0;
+
+static void forgetControlSocket(const int socket)
+{
+    for (size_t i = 0; i < controlSockets; i++)
+        if (controlSocket[i] == socket)
+        {
+            controlSocket[i] = controlSocket[--controlSockets];
+            return;
+        }
+}
+
+static bool isControlSocket(const int socket)
+{
+    for (size_t i = 0; i < controlSockets; i++)
+        if (controlSocket[i] == socket)
+            return true;
+    return false;
+}
+
+class websocketAuthMiddleware : public PsychicMiddleware
+{
+public:
+    esp_err_t run(PsychicRequest *request, PsychicResponse *response, PsychicMiddlewareNext next) override
+    {
+        httpd_req_t *req = request->request();
+        if (req->method == HTTP_GET) /* the handshake - a socket number can be reused by a new client */
+        {
+            const int socket = httpd_req_to_sockfd(req);
+            forgetControlSocket(socket);
+            if (request->authenticate(WEBIF_USER, WEBIF_PASSWORD) && controlSockets < MAX_OPEN_SOCKETS)
+                controlSocket[controlSockets++] = socket;
+        }
+        return next();
+    }
+};
+
+static websocketAuthMiddleware websocketAuth;
+
+static size_t formatWebsocketMessage(const websocketMessage &msg, char *str, const size_t size)
+{
+    if (msg.type == ALARM_UPDATE)
+    {
+        static alarmStatus_t status; /* too large for the httpTask stack */
+        alarmStatus.read(status);
+
+        const size_t index = msg.value[0];
+        return snprintf(str, size, "ALARM\n%s\n%s\n%f\n", index < status.count ? status.rule[index].name : "?",
+                        msg.value[1] ? "raised" : "cleared", msg.value[2]);
+    }
+
+    size_t length = snprintf(str, size, "%s\n", msg.type == LIGHT_UPDATE ? "LIGHT" : "TEMPERATURE");
+    for (int i = 0; i < msg.count && length < size; i++)
+        length += snprintf(str + length, size - length, "%f\n", msg.value[i]);
+    return length;
+}
+
+static void setupWebsocketHandler(PsychicWebSocketHandler &websocketHandler)
+{
+#define SHOW_WS_CONNECTIONS 0
+    websocketHandler.onOpen(
+        [](PsychicWebSocketClient *client)
+        {
+#if SHOW_WS_CONNECTIONS
+            log_i("[socket] connection #%u connected from %s", client->socket(), client->remoteIP().toString());
+#endif
+            /* the temperature is only sent when it changes - a new client gets the latest right away */
+            const sensorState_t sensor = sensorState.read();
+            if (!sensor.valid)
+                return;
+
+            websocketMessage msg;
+            msg.type = TEMPERATURE_UPDATE;
+            msg.count = 1;
+            msg.value[0] = sensor.temperature;
+
+            char str[32];
+            formatWebsocketMessage(msg, str, sizeof(str));
+            client->sendMessage(str);
+        });
+
+    websocketHandler.onClose(
+        [](PsychicWebSocketClient *client)
+        {
+#if SHOW_WS_CONNECTIONS
+            log_i("[socket] connection #%u closed", client->socket());
+#endif
+            forgetControlSocket(client->socket());
+        });
+
+    websocketHandler.onFrame(
+        [](PsychicWebSocketRequest *request, httpd_ws_frame *frame)
+        {
+            log_i("received websocket frame: %s", reinterpret_cast<char *>(frame->payload));
+
+            /* 'SCENE\n<name>[\n<duration>]' starts and 'STOPSCENE\n<name>' ends a scene */
+            char command[16], name[sizeof(lightLayer::name)];
+            long duration = -1;
+            char payload[64];
+            snprintf(payload, sizeof(payload), "%.*s", (int)frame->len, reinterpret_cast<char *>(frame->payload));
+
+            const int fields = sscanf(payload, "%15[A-Z]\n%23[^\n]\n%ld", command, name, &duration);
+            if (fields >= 2 && (!strcmp(command, "SCENE") || !strcmp(command, "STOPSCENE")))
+            {
+                if (!isControlSocket(httpd_req_to_sockfd(request->request())))
+                    return request->reply("You have to log in to start or stop scenes.");
+
+                String result;
+                if (!strcmp(command, "SCENE"))
+                    startScene(name, duration, result);
+                else
+                    endScene(name, result);
+
+                return request->reply(result.c_str());
+            }
+
+            String wsResponse = "recieved: \n";
+            wsResponse += reinterpret_cast<char *>(frame->payload);
+
+            return request->reply(wsResponse.c_str());
+        });
+}
+
+struct ringMetrics_t
+{
+    const char *name;
+    uint32_t depth;
+    uint32_t highWater;
+    uint32_t capacity;
+    uint32_t dropped;
+};
+
+template <typename RING>
+static ringMetrics_t metricsOf(const char *name, const RING &ring)
+{
+    return {name, ring.size(), ring.highWaterMark(), ring.capacity(), ring.droppedItems()};
+}
+
+static std::optional<uint8_t> validateChannel(PsychicRequest *request, PsychicResponse *response)
+{
+    constexpr char *CHANNEL = "channel";
+
+    if (!request->hasParam(CHANNEL))
+    {
+        response->send(400, TEXT_PLAIN, "No channel parameter provided");
+        return std::nullopt;
+    }
+
+    const String &channelStr = request->getParam(CHANNEL)->value();
+
+    char *end;
+    const long index = strtol(channelStr.c_str(), &end, 10);
+    if (channelStr.isEmpty() || *end || index < 0 || index >= channelConfig.count)
+    {
+        char message[64];
+        snprintf(message, sizeof(message), "Invalid channel parameter (must be a number 0-%i)", channelConfig.count - 1);
+        response->send(400, TEXT_PLAIN, message);
+        return std::nullopt;
+    }
+
+    return index;
+}
+
+static bool handleFileUpload(const String &data, const String &filePath, String &result)
+{
+    phaseTimer storage(taskPhases.storageUs);
+    File file = SD.open(filePath, FILE_WRITE);
+    if (!file)
+    {
+        result = COULD_NOT_OPEN;
+        return false;
+    }
+
+    const size_t fileSize = data.length();
+
+    if (file.write(reinterpret_cast<const uint8_t *>(data.c_str()), fileSize) != fileSize)
+    {
+        result = "File save error";
+        return false;
+    }
+
+    result = "File save OK";
+    return true;
+}
+
+static void setupWebserverHandlers(PsychicHttpServer &server)
+{
+    server.on(
+        "/", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            if (samePageIsCached(request))
+                return response->send(304);
+
+            extern const uint8_t index_start[] asm("_binary_src_webui_index_html_gz_start");
+            extern const uint8_t index_end[] asm("_binary_src_webui_index_html_gz_end");
+
+            addStaticContentHeaders(response);
+            response->addHeader(CONTENT_ENCODING, GZIP);
+            response->setContentType(TEXT_HTML);
+            const size_t size = index_end - index_start;
+            response->setContent(index_start, size);
+            return response->send(); }
+
+    );
+
+    server.on(
+        "/editor", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            if (samePageIsCached(request))
+                return response->send(304);
+
+            extern const uint8_t editor_start[] asm("_binary_src_webui_editor_html_gz_start");
+            extern const uint8_t editor_end[] asm("_binary_src_webui_editor_html_gz_end");   
+
+            addStaticContentHeaders(response);
+            response->addHeader(CONTENT_ENCODING, GZIP);
+            response->setContentType(TEXT_HTML);
+            const size_t size = editor_end - editor_start;
+            response->setContent(editor_start, size);
+            return response->send(); }
+
+    );
+
+    server.on(
+        "/fileupload", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            if (samePageIsCached(request))
+                return response->send(304);
+
+            extern const uint8_t upload_start[] asm("_binary_src_webui_fileupload_html_gz_start");
+            extern const uint8_t upload_end[] asm("_binary_src_webui_fileupload_html_gz_end");   
+
+            addStaticContentHeaders(response);
+            response->addHeader(CONTENT_ENCODING, GZIP);
+            response->setContentType(TEXT_HTML);
+            const size_t size = upload_end - upload_start;
+            response->setContent(upload_start, size);
+            return response->send(); }
+
+    );
+
+    server.on(
+        "/moonsetup", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            if (samePageIsCached(request))
+                return response->send(304);
+
+            extern const uint8_t moon_start[] asm("_binary_src_webui_moonsetup_html_gz_start");
+            extern const uint8_t moon_end[] asm("_binary_src_webui_moonsetup_html_gz_end");
+
+            addStaticContentHeaders(response);
+            response->addHeader(CONTENT_ENCODING, GZIP);
+            response->setContentType(TEXT_HTML);
+            const size_t size = moon_end - moon_start;
+            response->setContent(moon_start, size);
+            return response->send(); }
+
+    );
+
+    server.on(
+        "/api/timers", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            auto validChannel = validateChannel(request, response);
+            if (!validChannel)
+                return ESP_OK;
+
+            uint8_t channelIndex = *validChannel;
+
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            {
+                ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                if (!lock.acquired())                    
+                    return response->send(500, TEXT_PLAIN, "Mutex timeout");                    
+
+                for (auto &timer : channel[channelIndex])
+                    if (timer.anchor)
+                        content.printf("%i,%i,%s%+i\n", timer.time, timer.percentage, anchorName(timer), int(timer.offset));
+                    else
+                        content.printf("%i,%i\n", timer.time, timer.percentage);
+            }
+
+            if (content.overflowed())
+                return response->send(500, TEXT_PLAIN, "Response too large");
+            
+            response->addHeader("Cache-Control", "no-store, no-cache, must-revalidate, proxy-revalidate");
+            response->addHeader("Pragma", "no-cache");
+            response->addHeader("Expires", "0");
+            response->setContent(content.c_str());
+            return response->send(); }
 
     );
 
-    server.on(
-        "/moonsetup", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
-        {
-            if (samePageIsCached(request))
-                return response->send(304);
+    server.on(
+              "/api/timers", HTTP_POST, [](PsychicRequest *request, PsychicResponse *response)
+              {
+            auto validChannel = validateChannel(request, response);
+            if (!validChannel)
+                return ESP_OK;
+
+            const uint8_t channelIndex = *validChannel;
+
+            /* PWM steps a timer may be off the line through the timers around it before it is kept */
+            const float tolerance = request->hasParam("tolerance") ? request->getParam("tolerance")->value().toFloat() : TIMER_TOLERANCE_LSB;
+            if (!(tolerance >= 0))
+                return response->send(400, TEXT_PLAIN, "Invalid tolerance");
+
+            simplifyResult_t simplified;
+            {
+                String csvData = request->body();
+
+                /* importedTimers is shared with parseTimerFile() - released before saveDefaultTimers() takes spiMutex again */
+                ScopedMutex importLock(spiMutex, pdMS_TO_TICKS(1000));
+                if (!importLock.acquired())
+                    return response->send(500, TEXT_PLAIN, "Server busy, try again later");
+
+                importList_t &newTimers = importedTimers;
+                newTimers.clear();
+
+                log_d("Parsing timers for channel %i", channelIndex);
+
+                const char *line = csvData.c_str();
+                while (*line)
+                {
+                    const char *lineEnd = strchr(line, '\n');
+                    if (!lineEnd)
+                        break;
+
+                    char *field;
+                    const long time = strtol(line, &field, 10);
+
+                    if (field != line && field < lineEnd && *field == ',')
+                    {
+                        char *anchorField;
+                        const long percentage = strtol(field + 1, &anchorField, 10);
+
+                        if (time > 86400 || percentage > 100)
+                        {
+                            log_e("Timer data value overflow");
+                            return response->send(400, TEXT_PLAIN, "Overflow in timer data");
+                        }
+
+                        /* an optional third field 'sunrise+1800' keeps the timer on the sun */
+                        lightTimer_t timer = {int(time), int(percentage)};
+                        if (anchorField < lineEnd && *anchorField == ',' && !parseAnchor(anchorField + 1, timer))
+                            return response->send(400, TEXT_PLAIN, "Invalid sun anchor");
+
+                        if (!newTimers.push_back(timer))
+                        {
+                            log_e("Staged timerdata has too many timers");
+                            return response->send(400, TEXT_PLAIN, "Too many timers");
+                        }
+
+                        log_v("Staging% 6li,% 4li for channel %i", time, percentage, channelIndex);
+                    }
+
+                    line = lineEnd + 1;
+                }
+
+                if (newTimers.size() < 2 ||
+                    newTimers.front().time != 0 || newTimers.back().time != 86400 ||
+                    newTimers.front().percentage != newTimers.back().percentage)
+                {
+                    log_e("Staged timerdata failed sanity check");
+                    return response->send(400, TEXT_PLAIN, "Data sanity check failed");
+                }
+
+                for (size_t i = 1; i < newTimers.size(); i++)
+                    if (newTimers[i].time < newTimers[i - 1].time ||
+                        (newTimers[i].time == newTimers[i - 1].time && !newTimers[i].anchor && !newTimers[i - 1].anchor))
+                        return response->send(400, TEXT_PLAIN, "Timers not in ascending order");
+
+                simplified = simplifyImportedTimers(channelIndex, tolerance);
+                if (newTimers.size() > MAX_TIMERS_PER_CHANNEL)
+                    return response->send(400, TEXT_PLAIN, "Too many timers - raise the tolerance");
+
+                {
+                    ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                    if (!lock.acquired())
+                        return response->send(500, TEXT_PLAIN, "Mutex timeout");
+
+                    channel[channelIndex].clear();
+                    for (const auto &timer : newTimers)
+                        channel[channelIndex].push_back(timer);
+
+                    resolveSunTimers(sunTimes);
+                    scheduleVersion++;
+                }
+            }
+
+            String result;
+            const bool success = saveDefaultTimers(result);
+            if (simplified.removed)
+                result.concat(" - simplified away " + String(simplified.removed) + " timers, max error " + String(simplified.maxError, 1) + " PWM steps");
+
+            return response->send(success ? 200 : 500, TEXT_PLAIN, result.c_str()); }
+
+              )
+        ->addMiddleware(&basicAuth);
+
+    server.on(
+        "/api/evaluate", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            /* seconds since midnight, to is included */
+            const long from = request->hasParam("from") ? request->getParam("from")->value().toInt() : 0;
+            const long to = request->hasParam("to") ? request->getParam("to")->value().toInt() : 86400;
+            const long step = request->hasParam("step") ? request->getParam("step")->value().toInt() : 10;
+            if (from < 0 || to > 86400 || from > to || step < 1)
+                return response->send(400, TEXT_PLAIN, "Invalid range (from <= to in 0-86400 seconds, step >= 1)");
+
+            uint8_t selected[MAX_CHANNELS];
+            size_t numberOfChannels = 0;
+            if (request->hasParam("channels"))
+            {
+                const String &channels = request->getParam("channels")->value();
+                const char *list = channels.c_str();
+                while (*list)
+                {
+                    char *end;
+                    const long index = strtol(list, &end, 10);
+                    if (end == list || index < 0 || index >= channelConfig.count || numberOfChannels == MAX_CHANNELS || (*end && *end != ','))
+                        return response->send(400, TEXT_PLAIN, "Invalid channels (a comma separated list of channel numbers)");
+
+                    selected[numberOfChannels++] = index;
+                    list = *end ? end + 1 : end;
+                }
+            }
+            else
+                for (int index = 0; index < channelConfig.count; index++)
+                    selected[numberOfChannels++] = index;
+
+            if (!numberOfChannels)
+                return response->send(400, TEXT_PLAIN, "No channels selected");
+
+            const size_t numberOfSamples = (to - from) / step + 1;
+
+            /* one block is sampled under channelMutex and sent without it */
+            constexpr size_t BLOCK = 128;
+            scopedArena scratch(arena);
+            float *level = static_cast<float *>(arena.allocate(BLOCK * sizeof(float)));
+            uint16_t *packed = static_cast<uint16_t *>(arena.allocate(BLOCK * numberOfChannels * sizeof(uint16_t)));
+            if (!level || !packed)
+                return response->send(500, TEXT_PLAIN, "Response too large");
+
+            httpd_req_t *req = request->request();
+            static char samplesHeader[12];
+            static char versionHeader[12];
+            static char channelsHeader[MAX_CHANNELS * 3 + 1];
+            bool headersSet = false;
+            uint32_t version = 0;
+
+            for (size_t first = 0; first < numberOfSamples; first += BLOCK)
+            {
+                const size_t count = min(BLOCK, numberOfSamples - first);
+                const uint32_t fromMs = (from + first * step) * 1000U;
+
+                {
+                    ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                    if (!lock.acquired())
+                    {
+                        if (!headersSet)
+                            return response->send(500, TEXT_PLAIN, "Mutex timeout");
+                        return ESP_FAIL; /* closes the connection - the client sees a short body */
+                    }
+
+                    for (size_t c = 0; c < numberOfChannels; c++)
+                    {
+                        const uint32_t sampled = sampleSchedule(selected[c], fromMs, step * 1000U, count, level);
+                        if (headersSet && sampled != version)
+                            return ESP_FAIL; /* the schedule changed halfway */
+                        version = sampled;
+
+                        for (size_t i = 0; i < count; i++)
+                            packed[i * numberOfChannels + c] = level[i] * 100 + 0.5f;
+                    }
+                }
+
+                if (!headersSet)
+                {
+                    snprintf(samplesHeader, sizeof(samplesHeader), "%u", (unsigned)numberOfSamples);
+                    snprintf(versionHeader, sizeof(versionHeader), "%" PRIu32, version);
+                    size_t length = 0;
+                    for (size_t c = 0; c < numberOfChannels; c++)
+                        length += snprintf(channelsHeader + length, sizeof(channelsHeader) - length, c ? ",%u" : "%u", selected[c]);
+
+                    httpd_resp_set_type(req, "application/octet-stream");
+                    httpd_resp_set_hdr(req, "X-Samples", samplesHeader);
+                    httpd_resp_set_hdr(req, "X-Channels", channelsHeader);
+                    httpd_resp_set_hdr(req, "X-Schedule-Version", versionHeader);
+                    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+                    headersSet = true;
+                }
+
+                if (httpd_resp_send_chunk(req, reinterpret_cast<const char *>(packed), count * numberOfChannels * sizeof(uint16_t)) != ESP_OK)
+                    return ESP_FAIL;
+            }
+
+            return httpd_resp_send_chunk(req, nullptr, 0); }
+
+    );
+
+    server.on(
+        "/api/calendar", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            calendarState_t state;
+            {
+                ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                if (!lock.acquired())
+                    return response->send(500, TEXT_PLAIN, "Mutex timeout");
+
+                state = calendarState;
+            }
+
+            char content[160];
+            snprintf(content, sizeof(content), "profile=%s\nscale=%.2f\nrules=%u\napplied=%lli\nsunrise=%02i:%02i\nsunset=%02i:%02i\n",
+                     *state.profile ? state.profile : "default", state.scale, (unsigned)state.rules, (long long)state.appliedAt,
+                     state.sunrise / 3600, state.sunrise % 3600 / 60, state.sunset / 3600, state.sunset % 3600 / 60);
+
+            return response->send(200, TEXT_PLAIN, content); }
+
+    );
+
+    server.on(
+        "/api/alarms", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            static alarmStatus_t status; /* too large for the httpd stack */
+            alarmStatus.read(status);
+            const int64_t nowUs = esp_timer_get_time();
+
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            for (size_t i = 0; i < status.count; i++)
+            {
+                const alarmRule_t &rule = status.rule[i];
+                const alarmState_t &state = status.state[i];
+
+                char source[24];
+                formatAlarmSource(source, sizeof(source), rule.sample);
+                content.printf("%s,%s,%s,%g,%g,%s,%.2f,%li,%" PRIu32 "\n", rule.name, source, ALARM_CHECK_NAME[rule.check], rule.limit,
+                               rule.hysteresis, state.active ? "raised" : "ok", state.value, (long)((nowUs - state.changedUs) / 1000000), state.raised);
+            }
+            content.printf("webhook,%s\nholdoff,%" PRIu32 "\npending,%u\nbackoffMs,%" PRIu32 "\ndelivered,%" PRIu32 "\nfailures,%" PRIu32 "\ndropped,%" PRIu32 "\n",
+                           *status.webhook ? status.webhook : "-", status.holdoffSec, (unsigned)status.pending, status.backoffMs,
+                           status.delivered, status.failures, status.dropped);
+
+            if (content.overflowed())
+                return response->send(500, TEXT_PLAIN, "Response too large");
+
+            response->addHeader("Cache-Control", "no-store");
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+
+    server.on(
+        "/api/thermostat", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            const thermostatConfig_t config = thermostatConfig.read();
+            const thermostatState_t state = thermostatState.read();
+            const long age = state.updatedUs ? long((esp_timer_get_time() - state.updatedUs) / 1000) : -1;
+
+            char content[256];
+            snprintf(content, sizeof(content),
+                     "mode=%s\naction=%s\noutput=%s\nsetpoint=%.2f\ntemperature=%.2f\ndemand=%.1f\nlevel=%.1f\nintegral=%.1f\nfailsafe=%i\nage=%li\n",
+                     THERMOSTAT_MODE_NAME[config.mode], config.cooling ? "cool" : "heat", THERMOSTAT_OUTPUT_NAME[config.output], config.setpoint,
+                     state.temperature, state.demand * 100, state.output * 100, state.integral * 100, state.failsafe, age);
+
+            return response->send(200, TEXT_PLAIN, content); }
+
+    );
+
+    server.on(
+        "/api/moonlevels", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            {
+                ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                if (!lock.acquired())
+                    return response->send(500, TEXT_PLAIN, "Mutex timeout");
+
+                for (int i = 0; i < channelConfig.count; i++)
+                    content.printf(i ? ",%.2f" : "%.2f", fullMoonLevel[i]);
+            }
+
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+
+    server.on(
+              "/api/moonlevels", HTTP_POST, [](PsychicRequest *request, PsychicResponse *response)
+              {
+                  String body = request->body();
+                  float newLevels[MAX_CHANNELS];
+
+                  int start = 0, count = 0;
+                  while (count < channelConfig.count)
+                  {
+                      int comma = body.indexOf(',', start);
+                      String valueStr = (comma == -1) ? body.substring(start) : body.substring(start, comma);
+                      start = comma + 1;
+
+                      float value = valueStr.toFloat();
+                      if (value < 0.0f || value > 1.0f)
+                          return response->send(400, TEXT_PLAIN, "Invalid values");
+
+                      newLevels[count++] = value;
+                      if (comma == -1)
+                          break;
+                  }
+
+                  if (count != channelConfig.count)
+                      return response->send(400, TEXT_PLAIN, "Incorrect number of values");
+
+                  {
+                    ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                    if (!lock.acquired())
+                        return response->send(500, TEXT_PLAIN, "Mutex timeout");
+
+                      for (int i = 0; i < channelConfig.count; i++)
+                          fullMoonLevel[i] = newLevels[i];
+
+                      scheduleVersion++;
+                  }
+
+                  String result;
+                  const bool success = saveMoonSettings(result);
+
+                  return response->send(success ? 200 : 500, TEXT_PLAIN, result.c_str()); }
+
+              )
+        ->addMiddleware(&basicAuth);
+
+    server.on(
+              "/api/override", HTTP_POST, [](PsychicRequest *request, PsychicResponse *response)
+              {
+                  auto validChannel = validateChannel(request, response);
+                  if (!validChannel)
+                      return ESP_OK;
+
+                  const uint8_t channelIndex = *validChannel;
+
+                  /* no or zero duration ends the override and fades back to the schedule */
+                  const long duration = request->hasParam("duration") ? request->getParam("duration")->value().toInt() : 0;
+                  if (duration < 0 || duration > 86400)
+                      return response->send(400, TEXT_PLAIN, "Invalid duration (must be 0-86400 seconds)");
+
+                  float level = 0;
+                  if (duration)
+                  {
+                      if (!request->hasParam("level"))
+                          return response->send(400, TEXT_PLAIN, "No level parameter provided");
+
+                      level = request->getParam("level")->value().toFloat();
+                      if (!isfinite(level) || level < 0.0f || level > 100.0f)
+                          return response->send(400, TEXT_PLAIN, "Invalid level (must be between 0 and 100)");
+                  }
+
+                  {
+                      ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                      if (!lock.acquired())
+                          return response->send(500, TEXT_PLAIN, "Mutex timeout");
 
-            extern const uint8_t moon_start[] asm("_binary_src_webui_moonsetup_html_gz_start");
-            extern const uint8_t moon_end[] asm("_binary_src_webui_moonsetup_html_gz_end");
+                      setManualOverride(channelIndex, level, duration * 1000UL);
+                  }
 
-            addStaticContentHeaders(response);
-            response->addHeader(CONTENT_ENCODING, GZIP);
-            response->setContentType(TEXT_HTML);
-            const size_t size = moon_end - moon_start;
-            response->setContent(moon_start, size);
-            return response->send(); }
+                  return response->send(200, TEXT_PLAIN, duration ? "Override set" : "Override cleared"); }
 
-    );
+              )
+        ->addMiddleware(&basicAuth);
 
     server.on(
-        "/api/timers", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        "/api/effects", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
         {
-            auto validChannel = validateChannel(request, response);
-            if (!validChannel)
-                return ESP_OK;
+            weatherEffect_t effect[MAX_CHANNELS];
+            bool enabled, active;
 
-            uint8_t channelIndex = *validChannel;
+            {
+                ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                if (!lock.acquired())
+                    return response->send(500, TEXT_PLAIN, "Mutex timeout");
 
-            String content;
-            content.reserve(256);
+                getWeatherEffects(effect);
+                enabled = weatherEffectsEnabled();
+                active = weatherEffectsActive();
+            }
+
+            scopedArena scratch(arena);
+            arenaText content(arena);
 
+            content.add(enabled ? "enabled=1\n" : "enabled=0\n");
+            if (enabled && !active)
+                content.add("# no channel has effects\n");
+            for (int i = 0; i < channelConfig.count; i++)
             {
-                ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
-                if (!lock.acquired())                    
-                    return response->send(500, TEXT_PLAIN, "Mutex timeout");                    
+                if (!effect[i].enabled())
+                    continue;
 
-                for (auto &timer : channel[channelIndex])
-                    content += String(timer.time) + "," + String(timer.percentage) + "\n";
+                content.printf("[%i]\nseed=%u\n", i, (unsigned)effect[i].seed);
+                content.printf("clouds=%u,%u\n", effect[i].cloudDepth, effect[i].cloudPeriodSec);
+                content.printf("lightning=%u,%u\n", effect[i].lightningPerHour, effect[i].lightningLevel);
+                content.printf("flicker=%u,%u,%u\n", effect[i].flickerDepth, (unsigned)effect[i].flickerFromSec, (unsigned)effect[i].flickerToSec);
             }
-            
-            response->addHeader("Cache-Control", "no-store, no-cache, must-revalidate, proxy-revalidate");
-            response->addHeader("Pragma", "no-cache");
-            response->addHeader("Expires", "0");
-            response->setContent(content.c_str());
-            return response->send(); }
+
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
 
     );
 
     server.on(
-              "/api/timers", HTTP_POST, [](PsychicRequest *request, PsychicResponse *response)
+              "/api/effects", HTTP_POST, [](PsychicRequest *request, PsychicResponse *response)
               {
-            auto validChannel = validateChannel(request, response);
-            if (!validChannel)
-                return ESP_OK;
+                  if (!request->hasParam("enabled"))
+                      return response->send(400, TEXT_PLAIN, "No enabled parameter provided");
 
-            const uint8_t channelIndex = *validChannel;
+                  const bool enabled = request->getParam("enabled")->value().toInt();
+
+                  {
+                      ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                      if (!lock.acquired())
+                          return response->send(500, TEXT_PLAIN, "Mutex timeout");
 
-            String csvData = request->body();
+                      weatherEffect_t effect[MAX_CHANNELS];
+                      getWeatherEffects(effect);
+                      setWeatherEffects(effect, enabled);
+                  }
 
-            std::vector<lightTimer_t> newTimers;
-            int startIdx = 0;
-            int endIdx = csvData.indexOf('\n');
+                  String result;
+                  if (!saveEffectSettings(result))
+                      return response->send(500, TEXT_PLAIN, result.c_str());
 
-            log_d("Parsing timers for channel %i", channelIndex);
+                  return response->send(200, TEXT_PLAIN, enabled ? "Weather effects enabled" : "Weather effects disabled"); }
 
-            while (endIdx != -1)
-            {
-                String line = csvData.substring(startIdx, endIdx);
+              )
+        ->addMiddleware(&basicAuth);
 
-                if (line.length() == 0)
-                    continue;
+    server.on(
+        "/api/color", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            scopedArena scratch(arena);
+            arenaText content(arena);
 
-                int commaIdx = line.indexOf(',');
+            /* ?cct= and ?intensity= solve one target against the loaded fixture without applying it */
+            if (request->hasParam("cct"))
+            {
+                const float cct = request->getParam("cct")->value().toFloat();
+                const float intensity = request->hasParam("intensity") ? request->getParam("intensity")->value().toFloat() : 100;
+                if (!(cct >= MIN_CCT && cct <= MAX_CCT) || !(intensity >= 0 && intensity <= 100))
+                    return response->send(400, TEXT_PLAIN, "Invalid cct or intensity");
 
-                if (commaIdx != -1)
+                colorFixture_t fixture;
                 {
-                    int time = strtol(line.substring(0, commaIdx).c_str(), NULL, 10);
-                    int percentage = strtol(line.substring(commaIdx + 1).c_str(), NULL, 10);
+                    ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                    if (!lock.acquired())
+                        return response->send(500, TEXT_PLAIN, "Mutex timeout");
 
-                    if (time > 86400 || percentage > 100)
-                    {
-                        log_e("Timer data value overflow");
-                        return response->send(400, TEXT_PLAIN, "Overflow in timer data");
-                    }
+                    fixture = colorSchedule.fixture;
+                }
 
-                    newTimers.push_back({time, percentage});
+                if (!fixture.channelMask)
+                    return response->send(404, TEXT_PLAIN, "No fixture loaded");
 
-                    log_v("Staging% 6i,% 4i for channel %i", time, percentage, channelIndex);
-                }
+                float mix[MAX_CHANNELS];
+                const float distance = fixture.solve(cct, channelConfig.count, mix);
 
-                startIdx = endIdx + 1;
-                endIdx = csvData.indexOf('\n', startIdx);
-            }
+                content.printf("%.0f,%.2f,%.4f", cct, intensity, distance);
+                for (int i = 0; i < channelConfig.count; i++)
+                    if (fixture.covers(i))
+                        content.printf(",%.2f", intensity * mix[i]);
+                content.add("\n");
 
-            if (newTimers.size() < 2 ||
-                newTimers.front().time != 0 || newTimers.back().time != 86400 ||
-                newTimers.front().percentage != newTimers.back().percentage)
-            {
-                log_e("Staged timerdata failed sanity check");
-                return response->send(400, TEXT_PLAIN, "Data sanity check failed");
+                return response->send(200, TEXT_PLAIN, content.c_str());
             }
 
             {
@@ -404,80 +1617,130 @@ static void setupWebserverHandlers(PsychicHttpServer &server, tm *timeinfo)
                 if (!lock.acquired())
                     return response->send(500, TEXT_PLAIN, "Mutex timeout");
 
-                channel[channelIndex].clear();
-                for (auto &timer : newTimers)
-                    channel[channelIndex].push_back(timer);
+                const colorSchedule_t &schedule = colorSchedule;
+                if (!schedule.fixture.channelMask)
+                    return response->send(404, TEXT_PLAIN, "No colour schedule loaded");
+
+                content.add(schedule.active ? "# active\n" : "# inactive - the channels run on their timers\n");
+                content.add("time,cct,intensity,distance");
+                for (int i = 0; i < channelConfig.count; i++)
+                    if (schedule.fixture.covers(i))
+                        content.printf(",%i", i);
+                content.add("\n");
+
+                for (size_t k = 0; k < schedule.keyframe.size(); k++)
+                {
+                    const colorKeyframe_t &keyframe = schedule.keyframe[k];
+                    content.printf("%i,%.0f,%.2f,%.4f", keyframe.time, keyframe.cct, keyframe.intensity, schedule.distance[k]);
+                    for (int i = 0; i < channelConfig.count; i++)
+                        if (schedule.fixture.covers(i))
+                            content.printf(",%.2f", schedule.level[i][k].percentage);
+                    content.add("\n");
+                }
             }
 
-            String result;
-            const bool success = saveDefaultTimers(result);
+            if (content.overflowed())
+                return response->send(500, TEXT_PLAIN, "Response too large");
 
-            return response->send(success ? 200 : 500, TEXT_PLAIN, result.c_str()); }
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+
+    server.on(
+              "/api/color", HTTP_POST, [](PsychicRequest *request, PsychicResponse *response)
+              {
+                  if (!request->hasParam("mode"))
+                      return response->send(400, TEXT_PLAIN, "No mode parameter provided");
+
+                  const String mode = request->getParam("mode")->value();
+                  String result;
+                  bool success = true;
+
+                  if (mode.equalsIgnoreCase("color"))
+                      success = loadColorSettings(result);
+                  else if (mode.equalsIgnoreCase("channels"))
+                  {
+                      ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
+                      if (!lock.acquired())
+                          return response->send(500, TEXT_PLAIN, "Mutex timeout");
+
+                      colorSchedule.active = false;
+                      scheduleVersion++;
+                      result = "Channels run on their timers";
+                  }
+                  else
+                      return response->send(400, TEXT_PLAIN, "Invalid mode (must be color or channels)");
+
+                  return response->send(success ? 200 : 500, TEXT_PLAIN, result.c_str()); }
 
               )
         ->addMiddleware(&basicAuth);
 
     server.on(
-        "/api/moonlevels", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        "/api/scenes", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
         {
-            String responseStr;
-            responseStr.reserve(NUMBER_OF_CHANNELS * 8);
+            scopedArena scratch(arena);
+            arenaText content(arena);
 
             {
                 ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
                 if (!lock.acquired())
                     return response->send(500, TEXT_PLAIN, "Mutex timeout");
 
-                for (int i = 0; i < NUMBER_OF_CHANNELS; i++)
+                describeActiveLayers(content);
+            }
+
+            content.add("\nAvailable scenes\n");
+
+            {
+                ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+                if (!lock.acquired())
+                    return response->send(500, TEXT_PLAIN, "Mutex timeout");
+
+                phaseTimer storage(taskPhases.storageUs);
+                File dir = SD.open(SCENE_DIRECTORY);
+                if (dir && dir.isDirectory())
                 {
-                    responseStr += String(fullMoonLevel[i]);
-                    if (i < NUMBER_OF_CHANNELS - 1)
-                        responseStr += ",";
+                    File entry = dir.openNextFile();
+                    while (entry)
+                    {
+                        const char *fileName = entry.name();
+                        const int nameLength = strlen(fileName) - strlen(SCENE_EXTENSION);
+                        if (nameLength > 0 && !strcmp(fileName + nameLength, SCENE_EXTENSION))
+                            content.printf("%.*s\n", nameLength, fileName);
+                        entry = dir.openNextFile();
+                    }
                 }
             }
 
-            return response->send(200, TEXT_PLAIN, responseStr.c_str()); }
+            if (content.overflowed())
+                return response->send(500, TEXT_PLAIN, "Response too large");
+
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
 
     );
 
     server.on(
-              "/api/moonlevels", HTTP_POST, [](PsychicRequest *request, PsychicResponse *response)
+              "/api/scene", HTTP_POST, [](PsychicRequest *request, PsychicResponse *response)
               {
-                  String body = request->body();
-                  float newLevels[NUMBER_OF_CHANNELS];
+                  String result;
 
-                  int start = 0, count = 0;
-                  while (count < NUMBER_OF_CHANNELS)
+                  if (request->hasParam("stop"))
                   {
-                      int comma = body.indexOf(',', start);
-                      String valueStr = (comma == -1) ? body.substring(start) : body.substring(start, comma);
-                      start = comma + 1;
-
-                      float value = valueStr.toFloat();
-                      if (value < 0.0f || value > 1.0f)
-                          return response->send(400, TEXT_PLAIN, "Invalid values");
-
-                      newLevels[count++] = value;
-                      if (comma == -1)
-                          break;
+                      const bool success = endScene(request->getParam("stop")->value().c_str(), result);
+                      return response->send(success ? 200 : 404, TEXT_PLAIN, result.c_str());
                   }
 
-                  if (count != NUMBER_OF_CHANNELS)
-                      return response->send(400, TEXT_PLAIN, "Incorrect number of values");
-
-                  {
-                    ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
-                    if (!lock.acquired())
-                        return response->send(500, TEXT_PLAIN, "Mutex timeout");
-
-                      for (int i = 0; i < NUMBER_OF_CHANNELS; i++)
-                          fullMoonLevel[i] = newLevels[i];
-                  }
+                  if (!request->hasParam("name"))
+                      return response->send(400, TEXT_PLAIN, "No name parameter provided");
 
-                  String result;
-                  const bool success = saveMoonSettings(result);
+                  /* a duration parameter overrides the duration in the scene file */
+                  const long duration = request->hasParam("duration") ? request->getParam("duration")->value().toInt() : -1;
+                  if (duration > 86400)
+                      return response->send(400, TEXT_PLAIN, "Invalid duration (must be 0-86400 seconds)");
 
-                  return response->send(success ? 200 : 500, TEXT_PLAIN, result.c_str()); }
+                  const bool success = startScene(request->getParam("name")->value().c_str(), duration, result);
+                  return response->send(success ? 200 : 400, TEXT_PLAIN, result.c_str()); }
 
               )
         ->addMiddleware(&basicAuth);
@@ -513,9 +1776,30 @@ static void setupWebserverHandlers(PsychicHttpServer &server, tm *timeinfo)
                       return response->send(500, TEXT_PLAIN, result.c_str());
 
                   if (!strcmp(DEFAULT_TIMERFILE, filePath.c_str()))
+                  {
                       success = loadDefaultTimers(result);
+                      calendarChanged(); /* back to the profile of today if that is another one */
+                  }
+                  else if (!strcmp(CALENDAR_FILE, filePath.c_str()) || filePath.startsWith(String(PROFILE_DIRECTORY) + "/"))
+                  {
+                      calendarChanged();
+                      result = "Calendar will be applied";
+                  }
                   else if (!strcmp(MOON_SETTINGS_FILE, filePath.c_str()))
                       success = loadMoonSettings(result);
+                  else if (!strcmp(EFFECT_SETTINGS_FILE, filePath.c_str()))
+                      success = loadEffectSettings(result);
+                  else if (!strcmp(COLOR_KEYFRAME_FILE, filePath.c_str()) || !strcmp(FIXTURE_FILE, filePath.c_str()))
+                      success = loadColorSettings(result);
+                  else if (!strcmp(THERMOSTAT_FILE, filePath.c_str()))
+                      success = loadThermostatSettings(result);
+                  else if (!strcmp(ALARM_FILE, filePath.c_str()))
+                  {
+                      alarmChanged();
+                      result = "Alarms will be applied";
+                  }
+                  else if (!strcmp(CHANNEL_CONFIG_FILE, filePath.c_str()))
+                      result = "Channel config saved - reboot to apply";
 
                   return response->send(success ? 200 : 500, TEXT_PLAIN, result.c_str()); }
 
@@ -523,15 +1807,10 @@ static void setupWebserverHandlers(PsychicHttpServer &server, tm *timeinfo)
         ->addMiddleware(&basicAuth);
 
     server.on(
-        "/api/uptime", HTTP_GET, [&timeinfo](PsychicRequest *request, PsychicResponse *response)
+        "/api/uptime", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
         {
-            time_t now;
-            time(&now);
-
-            struct tm currentTime;
-            gmtime_r(&now, &currentTime);
-
-            time_t uptimeSeconds = time_diff(timeinfo, &currentTime);
+            /* not wall clock based - the clock can step when NTP corrects a holdover time */
+            time_t uptimeSeconds = esp_timer_get_time() / 1000000;
 
             int years = uptimeSeconds / (60 * 60 * 24 * 365);
             uptimeSeconds %= (60 * 60 * 24 * 365);
@@ -542,18 +1821,304 @@ static void setupWebserverHandlers(PsychicHttpServer &server, tm *timeinfo)
             int minutes = uptimeSeconds / 60;
             int seconds = uptimeSeconds % 60;
 
-            String uptimeString = "";
+            char uptimeString[96] = "";
+            size_t length = 0;
             if (years > 0)
-                uptimeString += String(years) + " years, ";
+                length += snprintf(uptimeString + length, sizeof(uptimeString) - length, "%i years, ", years);
             if (days > 0)
-                uptimeString += String(days) + " days, ";
+                length += snprintf(uptimeString + length, sizeof(uptimeString) - length, "%i days, ", days);
             if (hours > 0)
-                uptimeString += String(hours) + " hours, ";
+                length += snprintf(uptimeString + length, sizeof(uptimeString) - length, "%i hours, ", hours);
             if (minutes > 0)
-                uptimeString += String(minutes) + " minutes and ";
-            uptimeString += String(seconds) + " seconds";
+                length += snprintf(uptimeString + length, sizeof(uptimeString) - length, "%i minutes and ", minutes);
+            snprintf(uptimeString + length, sizeof(uptimeString) - length, "%i seconds", seconds);
+
+            return response->send(200, TEXT_PLAIN, uptimeString); }
+
+    );
+
+    server.on(
+        "/api/state", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            /* consistent snapshots without taking channelMutex */
+            const lightState_t light = lightState.read();
+            const sensorState_t sensor = sensorState.read();
+            const int64_t nowUs = esp_timer_get_time();
+
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            content.printf("time,%li\nlevels", (long)light.time);
+            for (int i = 0; i < light.count; i++)
+                content.printf(",%.3f", light.level[i]);
+            content.printf("\nmoon,%.3f\nscheduleVersion,%" PRIu32 "\n", light.moonFraction, light.scheduleVersion);
+            if (light.updatedUs)
+                content.printf("levelsAgeMs,%li\n", (long)((nowUs - light.updatedUs) / 1000));
+            else
+                content.add("levelsAgeMs,-\n");
+            if (sensor.valid)
+                content.printf("temperature,%.2f\n", sensor.temperature);
+            else
+                content.add("temperature,-\n");
+            if (sensor.updatedUs)
+                content.printf("temperatureAgeMs,%li\n", (long)((nowUs - sensor.updatedUs) / 1000));
+            else
+                content.add("temperatureAgeMs,-\n");
+            if (sensor.valid)
+                content.printf("temperatureRaw,%.2f\ntemperatureRate,%.3f\ntemperatureQuality,%u\nsampleIntervalMs,%lu\n",
+                               sensor.raw, sensor.rate, sensor.quality, (unsigned long)sensor.intervalMs);
+
+            response->addHeader("Cache-Control", "no-store");
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+
+    server.on(
+        "/api/pulses", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            static lightState_t light; /* too large for the httpd stack */
+            lightState.read(light);
+
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            content.add("Channel,Start %,Width %\n");
+            for (int i = 0; i < light.count; i++)
+                content.printf("%i,%.2f,%.2f\n", i, light.pulseStart[i] * 100, light.pulseWidth[i] * 100);
+
+            /* only channels that share a period keep their relative phase - see periodGroupOf() */
+            content.add("\nFirst channel,Channels,Peak channels on in phase,Peak channels on now\n");
+            for (int first = 0; first < light.count; first++)
+            {
+                float inPhase[MAX_CHANNELS] = {};
+                float start[MAX_CHANNELS];
+                float width[MAX_CHANNELS];
+                size_t members = 0;
+                bool isFirst = true;
+
+                for (int i = 0; i < light.count; i++)
+                {
+                    if (periodGroupOf(channelConfig, i) != periodGroupOf(channelConfig, first))
+                        continue;
+                    if (i < first)
+                    {
+                        isFirst = false;
+                        break;
+                    }
+                    start[members] = light.pulseStart[i];
+                    width[members++] = light.pulseWidth[i];
+                }
+
+                if (isFirst)
+                    content.printf("%i,%u,%i,%i\n", first, (unsigned)members, peakOverlap(inPhase, width, members), peakOverlap(start, width, members));
+            }
+
+            response->addHeader("Cache-Control", "no-store");
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+
+    server.on(
+        "/api/channels", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            content.add("Channel,Output,Pin,LEDC,Frequency,Bits,Curve\n");
+            for (int i = 0; i < channelConfig.count; i++)
+            {
+                const bool pca9685 = channelConfig.output[i] == OUTPUT_PCA9685;
+                content.printf("%i,%s,%u,", i, pca9685 ? "pca9685" : "ledc", channelConfig.pin[i]);
+                if (pca9685)
+                    content.add("-,");
+                else
+                    content.printf("%u,", channelConfig.ledcChannel[i]);
+                content.printf("%" PRIu32 ",%u,", channelConfig.frequency[i], channelConfig.bitDepth[i]);
+                if (channelConfig.gamma[i] == 1.0f)
+                    content.add("linear\n");
+                else
+                    content.printf("%.2f\n", channelConfig.gamma[i]);
+            }
+
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+
+    server.on(
+        "/api/boot", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            content.add("Stage,Ready ms\n");
+            for (int stage = 0; stage < NUMBER_OF_BOOT_STAGES; stage++)
+                if (bootStageReadyUs[stage])
+                    content.printf("%s,%li\n", bootStageName[stage], (long)(bootStageReadyUs[stage] / 1000));
+                else
+                    content.printf("%s,-\n", bootStageName[stage]);
+
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+
+    server.on(
+        "/metrics", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            content.printf("aquacontrol_uptime_seconds %" PRIu32 "\n", (uint32_t)(esp_timer_get_time() / 1000000));
+
+            content.add("# TYPE aquacontrol_dimmer_loops_total counter\n");
+            content.printf("aquacontrol_dimmer_loops_total %" PRIu32 "\n", dimmerLoops.load(std::memory_order_relaxed));
+            content.add("# TYPE aquacontrol_dimmer_overruns_total counter\n");
+            content.printf("aquacontrol_dimmer_overruns_total %" PRIu32 "\n", dimmerOverruns.load(std::memory_order_relaxed));
+            content.add("# TYPE aquacontrol_dimmer_loop_jitter_seconds histogram\n");
+            addHistogram(content, "aquacontrol_dimmer_loop_jitter", "", dimmerLoopJitter);
+            content.printf("aquacontrol_dimmer_loop_jitter_max_seconds %.6f\n", dimmerLoopJitter.highestUs() / 1e6);
+            content.add("# TYPE aquacontrol_dimmer_loop_duration_seconds histogram\n");
+            addHistogram(content, "aquacontrol_dimmer_loop_duration", "", dimmerLoopDuration);
+            content.printf("aquacontrol_dimmer_loop_duration_max_seconds %.6f\n", dimmerLoopDuration.highestUs() / 1e6);
+
+            /* the exposition format wants every metric family as one group */
+            content.add("# TYPE aquacontrol_mutex_wait_seconds histogram\n");
+            for (const auto &metrics : mutexMetrics)
+                if (metrics.handle.load(std::memory_order_relaxed))
+                {
+                    char labels[48];
+                    snprintf(labels, sizeof(labels), "mutex=\"%s\"", metrics.name);
+                    addHistogram(content, "aquacontrol_mutex_wait", labels, metrics.wait);
+                }
+            for (const auto &metrics : mutexMetrics)
+                if (metrics.handle.load(std::memory_order_relaxed))
+                    content.printf("aquacontrol_mutex_wait_max_seconds{mutex=\"%s\"} %.6f\n", metrics.name, metrics.wait.highestUs() / 1e6);
+            content.add("# TYPE aquacontrol_mutex_timeouts_total counter\n");
+            for (const auto &metrics : mutexMetrics)
+                if (metrics.handle.load(std::memory_order_relaxed))
+                    content.printf("aquacontrol_mutex_timeouts_total{mutex=\"%s\"} %" PRIu32 "\n", metrics.name, metrics.timeouts.load(std::memory_order_relaxed));
+
+            const ringMetrics_t ring[] = {metricsOf("dimmerToLcd", dimmerToLcd),
+                                          metricsOf("sensorToLcd", sensorToLcd),
+                                          metricsOf("textToLcd", textToLcd),
+                                          metricsOf("dimmerToWebsocket", dimmerToWebsocket),
+                                          metricsOf("sensorToWebsocket", sensorToWebsocket)};
+            for (const auto &r : ring)
+                content.printf("aquacontrol_ring_depth{ring=\"%s\"} %" PRIu32 "\n", r.name, r.depth);
+            for (const auto &r : ring)
+                content.printf("aquacontrol_ring_high_water{ring=\"%s\"} %" PRIu32 "\n", r.name, r.highWater);
+            for (const auto &r : ring)
+                content.printf("aquacontrol_ring_capacity{ring=\"%s\"} %" PRIu32 "\n", r.name, r.capacity);
+            content.add("# TYPE aquacontrol_ring_dropped_total counter\n");
+            for (const auto &r : ring)
+                content.printf("aquacontrol_ring_dropped_total{ring=\"%s\"} %" PRIu32 "\n", r.name, r.dropped);
+
+            const heapSample_t heap = sampleHeap();
+            content.printf("aquacontrol_heap_free_bytes %" PRIu32 "\n", heap.freeBytes);
+            content.printf("aquacontrol_heap_minimum_free_bytes %" PRIu32 "\n", heap.minimumFreeBytes);
+            content.printf("aquacontrol_heap_largest_free_block_bytes %" PRIu32 "\n", heap.largestFreeBlock);
+
+            uint32_t totalRunTime;
+            const UBaseType_t tasks = uxTaskGetSystemState(taskStatus, MAX_REPORTED_TASKS, &totalRunTime);
+            for (UBaseType_t i = 0; i < tasks; i++)
+                content.printf("aquacontrol_task_stack_free_bytes{task=\"%s\"} %u\n",
+                               taskStatus[i].pcTaskName, (unsigned)taskStatus[i].usStackHighWaterMark);
+            content.add("# TYPE aquacontrol_task_runtime_total counter\n");
+            for (UBaseType_t i = 0; i < tasks; i++)
+                content.printf("aquacontrol_task_runtime_total{task=\"%s\"} %" PRIu32 "\n",
+                               taskStatus[i].pcTaskName, (uint32_t)taskStatus[i].ulRunTimeCounter);
+            if (tasks)
+                content.printf("aquacontrol_runtime_total %" PRIu32 "\n", totalRunTime);
+
+            if (content.overflowed())
+                return response->send(500, TEXT_PLAIN, "Response too large");
+
+            response->addHeader("Cache-Control", "no-store");
+            return response->send(200, "text/plain; version=0.0.4", content.c_str()); }
+
+    );
+
+    server.on(
+        "/api/httpstats", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            describeHttpStats(content);
+
+            response->addHeader("Cache-Control", "no-store");
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+
+#if MUTEX_PROFILING
+    server.on(
+        "/api/mutexstats", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            content.add("Mutex,Site,Acquired,Timeouts,Wait avg us,Wait max us,Hold avg us,Hold max us\n");
+            for (const auto &site : lockSites)
+            {
+                const char *file = site.file.load(std::memory_order_acquire);
+                if (!file)
+                    break;
+
+                const mutexMetrics_t *metrics = metricsFor(site.mutex);
+                const uint32_t acquired = site.acquired.load(std::memory_order_relaxed);
+                const uint32_t attempts = acquired + site.timeouts.load(std::memory_order_relaxed);
+                content.printf("%s,%s:%i,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+                               metrics ? metrics->name : "untracked", fileNameOf(file), site.line,
+                               acquired, attempts - acquired,
+                               attempts ? site.waitTotalUs.load(std::memory_order_relaxed) / attempts : 0, site.waitMaxUs.load(std::memory_order_relaxed),
+                               acquired ? site.holdTotalUs.load(std::memory_order_relaxed) / acquired : 0, site.holdMaxUs.load(std::memory_order_relaxed));
+            }
+
+            content.add("\nHeld,Then taken\n");
+            for (size_t taken = 0; taken < MAX_TRACKED_MUTEXES; taken++)
+                for (size_t held = 0; held < MAX_TRACKED_MUTEXES; held++)
+                    if (lockOrder[taken].load(std::memory_order_relaxed) & (1UL << held))
+                        content.printf("%s,%s\n", mutexMetrics[held].name, mutexMetrics[taken].name);
+
+            const lockSite_t *inversion = lastInversionSite.load();
+            content.printf("\nLock order inversions,%" PRIu32 "\n", lockOrderInversions.load(std::memory_order_relaxed));
+            if (inversion)
+                content.printf("Last inversion at,%s:%i\n", fileNameOf(inversion->file.load()), inversion->line);
+            content.printf("Sites not recorded,%" PRIu32 "\n", lockSitesDropped.load(std::memory_order_relaxed));
+
+            if (content.overflowed())
+                return response->send(500, TEXT_PLAIN, "Response too large");
+
+            response->addHeader("Cache-Control", "no-store");
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
+
+    );
+#endif
+
+    server.on(
+        "/api/heap", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
+        {
+            static heapHistory_t history; /* too large for the httpd stack */
+            heapMonitor.read(history);
+
+            scopedArena scratch(arena);
+            arenaText content(arena);
+
+            const heapSample_t now = sampleHeap();
+            content.add("Arena size,High water,Overflows\n");
+            content.printf("%u,%u,%" PRIu32 "\n\n", (unsigned)arena.capacity(), (unsigned)arena.highWaterMark(), arena.overflowCount());
+            content.add("Uptime s,Free,Minimum free,Largest block\n");
+            for (uint32_t i = 0; i < history.count; i++)
+            {
+                const heapSample_t &sample = history.at(i);
+                content.printf("%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+                               sample.uptimeSec, sample.freeBytes, sample.minimumFreeBytes, sample.largestFreeBlock);
+            }
+            content.printf("%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+                           now.uptimeSec, now.freeBytes, now.minimumFreeBytes, now.largestFreeBlock);
 
-            return response->send(200, TEXT_PLAIN, uptimeString.c_str()); }
+            response->addHeader("Cache-Control", "no-store");
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
 
     );
 
@@ -574,38 +2139,30 @@ static void setupWebserverHandlers(PsychicHttpServer &server, tm *timeinfo)
         "/api/taskstats", HTTP_GET, [](PsychicRequest *request, PsychicResponse *response)
         {
             uint32_t totalRunTime;
-            UBaseType_t taskCount = uxTaskGetNumberOfTasks();
-
-
-            TaskStatus_t *pxTaskStatusArray = (TaskStatus_t *)heap_caps_malloc(taskCount * sizeof(TaskStatus_t), MALLOC_CAP_INTERNAL);
-            if (!pxTaskStatusArray) {
-                return response->send(500, TEXT_PLAIN, "Memory allocation failed");
-            }
 
-            UBaseType_t retrievedTasks = uxTaskGetSystemState(pxTaskStatusArray, taskCount, &totalRunTime);
+            UBaseType_t retrievedTasks = uxTaskGetSystemState(taskStatus, MAX_REPORTED_TASKS, &totalRunTime);
             if (totalRunTime == 0 || retrievedTasks == 0) {
-                heap_caps_free(pxTaskStatusArray);
                 return response->send(500, TEXT_PLAIN, "Failed to get task stats");
             }
 
-            String csvResponse = "Name,State,Priority,Stack,Runtime,CPU%\n";
+            scopedArena scratch(arena);
+            arenaText content(arena);
 
-            for (UBaseType_t i = 0; i < retrievedTasks; i++) {
-                const char *taskName = pxTaskStatusArray[i].pcTaskName;
-
-                float cpuPercent = ((float)pxTaskStatusArray[i].ulRunTimeCounter / (float)totalRunTime) * 100.0f;
+            content.add("Name,State,Priority,Stack,Runtime,CPU%\n");
 
-                csvResponse += String(taskName) + "," +
-                            String(pxTaskStatusArray[i].eCurrentState) + "," +
-                            String(pxTaskStatusArray[i].uxCurrentPriority) + "," +
-                            String(pxTaskStatusArray[i].usStackHighWaterMark) + "," +
-                            String(pxTaskStatusArray[i].ulRunTimeCounter) + "," +
-                            String(cpuPercent, 2) + "\n";
+            for (UBaseType_t i = 0; i < retrievedTasks; i++) {
+                float cpuPercent = ((float)taskStatus[i].ulRunTimeCounter / (float)totalRunTime) * 100.0f;
+
+                content.printf("%s,%i,%u,%u,%" PRIu32 ",%.2f\n",
+                               taskStatus[i].pcTaskName,
+                               taskStatus[i].eCurrentState,
+                               (unsigned)taskStatus[i].uxCurrentPriority,
+                               (unsigned)taskStatus[i].usStackHighWaterMark,
+                               (uint32_t)taskStatus[i].ulRunTimeCounter,
+                               cpuPercent);
             }
 
-            heap_caps_free(pxTaskStatusArray);
-
-            return response->send(200, TEXT_PLAIN, csvResponse.c_str()); }
+            return response->send(200, TEXT_PLAIN, content.c_str()); }
 
     );
 
@@ -652,35 +2209,94 @@ static void setupWebserverHandlers(PsychicHttpServer &server, tm *timeinfo)
 #endif
 }
 
+static eventStream events;
+static uint32_t requestedEventIntervalMs; /* set by the /api/events middleware right before onOpen runs */
+
+static void setupEventSource(PsychicHttpServer &server, PsychicEventSource &eventSource)
+{
+    eventSource.onOpen(
+        [](PsychicEventSourceClient *client)
+        {
+            if (!events.addClient(client, requestedEventIntervalMs, client->lastId()))
+            {
+                log_w("no room for event client #%u", client->socket());
+                client->close();
+            }
+        });
+
+    eventSource.onClose(
+        [](PsychicEventSourceClient *client)
+        {
+            events.removeClient(client);
+        });
+
+    server.on("/api/events", HTTP_GET, &eventSource)
+        ->addMiddleware(
+            [](PsychicRequest *request, PsychicResponse *response, PsychicMiddlewareNext next)
+            {
+                requestedEventIntervalMs = 0;
+                if (request->hasParam("hz"))
+                {
+                    const float hz = request->getParam("hz")->value().toFloat();
+                    if (!isfinite(hz) || hz <= 0.0f || hz > 100.0f)
+                        return response->send(400, TEXT_PLAIN, "Invalid hz (must be above 0 and up to 100)");
+                    requestedEventIntervalMs = 1000.0f / hz;
+                }
+                return next();
+            });
+}
+
+static void sendToWebsockets(PsychicWebSocketHandler &websocketHandler, const websocketMessage &msg)
+{
+    if (!websocketHandler.count())
+        return;
+
+    char str[16 + MAX_CHANNELS * 12];
+    formatWebsocketMessage(msg, str, sizeof(str));
+
+    log_v("websocket update: %s", str);
+    websocketHandler.sendAll(str);
+}
+
 void httpTask(void *parameter)
 {
-    if (!websocketQueue)
-    {
-        log_e("fatal error. No websocketqueue. system halted.");
-        while (1)
-            delay(100);
-    }
+    waitForBootStages(bootBit(BOOT_NETWORK));
 
-    const time_t rawTime = time(NULL);
-    struct tm *timeinfo = gmtime(&rawTime);
-    strftime(contentCreationTime, sizeof(contentCreationTime), "%a, %d %b %Y %X GMT", timeinfo);
+    /* the clock might not be synced yet - the firmware build time identifies the embedded pages */
+    const esp_app_desc_t *appDescription = esp_app_get_description();
+    char buildTime[32];
+    snprintf(buildTime, sizeof(buildTime), "%s %s", appDescription->date, appDescription->time);
+
+    struct tm timeinfo = {};
+    strptime(buildTime, "%b %d %Y %H:%M:%S", &timeinfo);
+    timeinfo.tm_isdst = -1;
+    mktime(&timeinfo); /* fills in the weekday */
+    strftime(contentCreationTime, sizeof(contentCreationTime), "%a, %d %b %Y %X GMT", &timeinfo);
 
     generateETag(contentCreationTime);
 
     static PsychicHttpServer server;
     static PsychicWebSocketHandler websocketHandler;
+    static PsychicEventSource eventSource;
 
-    server.config.max_uri_handlers = 15;
-    server.config.max_open_sockets = 8;
+    server.config.max_uri_handlers = 35;
+    server.config.max_open_sockets = MAX_OPEN_SOCKETS;
 
 #if defined(LGFX_ESP32_S3_BOX_LITE)
     server.config.stack_size = 12288;
 #endif
 
+    server.addMiddleware(&httpTrace);
+
     setupWebsocketHandler(websocketHandler);
-    server.on("/websocket", HTTP_GET, &websocketHandler);
+    server.on("/websocket", HTTP_GET, &websocketHandler)->addMiddleware(&websocketAuth);
 
-    setupWebserverHandlers(server, timeinfo);
+    if (events.begin())
+        setupEventSource(server, eventSource);
+    else
+        log_e("could not create event stream mutex - /api/events disabled");
+
+    setupWebserverHandlers(server);
     DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
 
     basicAuth.setUsername(WEBIF_USER);
@@ -692,29 +2308,45 @@ void httpTask(void *parameter)
     server.begin();
 
     log_i("HTTP server started at %s", WiFi.localIP().toString());
+    bootStageReady(BOOT_HTTP);
+
+    dimmerToWebsocket.setConsumer(xTaskGetCurrentTaskHandle());
+    sensorToWebsocket.setConsumer(xTaskGetCurrentTaskHandle());
+    alarmToWebsocket.setConsumer(xTaskGetCurrentTaskHandle());
+
+    static heapHistory_t history;
+    history.add(sampleHeap());
+    heapMonitor.publish(history);
+    TickType_t lastHeapSample = xTaskGetTickCount();
 
     while (1)
     {
         static websocketMessage msg;
-        if (xQueueReceive(websocketQueue, &msg, portMAX_DELAY))
+
+        while (dimmerToWebsocket.pop(msg))
         {
-            switch (msg.type)
-            {
-            case LIGHT_UPDATE:
-                log_v("light update msg received: %s", msg.str);
-                if (websocketHandler.count())
-                    websocketHandler.sendAll(msg.str);
-                break;
+            sendToWebsockets(websocketHandler, msg);
+            events.publish(msg);
+        }
+
+        while (sensorToWebsocket.pop(msg))
+        {
+            sendToWebsockets(websocketHandler, msg);
+            events.publish(msg);
+        }
 
-            case TEMPERATURE_UPDATE:
-                log_v("temperature update msg received: %s", msg.str);
-                if (websocketHandler.count())
-                    websocketHandler.sendAll(msg.str);
-                break;
+        while (alarmToWebsocket.pop(msg))
+            sendToWebsockets(websocketHandler, msg);
 
-            default:
-                break;
-            }
+        const TickType_t sinceSample = xTaskGetTickCount() - lastHeapSample;
+        if (sinceSample >= pdMS_TO_TICKS(HEAP_SAMPLE_INTERVAL_MS))
+        {
+            history.add(sampleHeap());
+            heapMonitor.publish(history);
+            lastHeapSample += pdMS_TO_TICKS(HEAP_SAMPLE_INTERVAL_MS);
+            continue;
         }
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HEAP_SAMPLE_INTERVAL_MS) - sinceSample);
     }
 }
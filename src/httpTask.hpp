@@ -28,32 +28,90 @@ SOFTWARE.
 #include <FS.h>
 #include <SD.h>
 #include <optional>
+#include <esp_app_desc.h>
 #include <freertos/semphr.h>
 
 #include <PsychicHttp.h>
 
 #include "ScopedMutex.h"
 #include "lightTimer.h"
+#include "timerSimplifier.h"
+#include "channelConfig.h"
+#include "lightLayer.h"
+#include "weatherEffects.h"
+#include "colorTarget.h"
+#include "thermostat.h"
+#include "alarmEngine.h"
+#include "scheduleCalendar.h"
+#include "lcdMessage.h"
 #include "websocketMessage.h"
+#include "bootState.h"
+#include "stateBoard.h"
+#include "requestArena.h"
+#include "heapMonitor.h"
+#include "runtimeMetrics.h"
+#include "httpTrace.h"
+#include "eventStream.h"
+#include "phaseStagger.h"
 
 extern const char *WEBIF_USER;
 extern const char *WEBIF_PASSWORD;
 
-extern std::vector<lightTimer_t> channel[NUMBER_OF_CHANNELS];
-extern float fullMoonLevel[NUMBER_OF_CHANNELS];
+extern channelConfig_t channelConfig;
+extern timerList_t channel[MAX_CHANNELS];
+extern importList_t importedTimers;
+extern float fullMoonLevel[MAX_CHANNELS];
 extern SemaphoreHandle_t channelMutex;
+extern uint32_t scheduleVersion;
+extern colorSchedule_t colorSchedule;
+extern calendarState_t calendarState;
+extern sunTimes_t sunTimes;
+extern const char *CALENDAR_FILE;
+extern const char *PROFILE_DIRECTORY;
 extern SemaphoreHandle_t spiMutex;
+extern seqlock<lightState_t> lightState;
+extern seqlock<sensorState_t> sensorState;
+extern seqlock<thermostatConfig_t> thermostatConfig;
+extern seqlock<thermostatState_t> thermostatState;
+extern seqlock<alarmStatus_t> alarmStatus;
+extern const char *ALARM_FILE;
+extern lcdRing_t dimmerToLcd;
+extern lcdRing_t sensorToLcd;
+extern lcdTextRing_t textToLcd;
+extern const char *CHANNEL_CONFIG_FILE;
 
 extern bool saveDefaultTimers(String &result);
 extern bool loadDefaultTimers(String &result);
+extern simplifyResult_t simplifyImportedTimers(const int index, const float toleranceLsb);
+extern bool resolveSunTimers(const sunTimes_t &sun);
 extern void messageOnLcd(const char *str);
 extern bool startSensor();
+extern void calendarChanged();
+extern void alarmChanged();
+extern void setManualOverride(const int index, const float percentage, const unsigned long durationMs);
+extern bool activateScene(const sceneLayer_t &scene, const unsigned long durationMs, String &result);
+extern bool stopScene(const char *name, String &result);
+extern void describeActiveLayers(arenaText &result);
+extern uint32_t sampleSchedule(const int index, const uint32_t fromMs, const uint32_t stepMs, const size_t count, float *level);
+extern void setWeatherEffects(const weatherEffect_t *effect, const bool enabled);
+extern void getWeatherEffects(weatherEffect_t *effect);
+extern bool weatherEffectsActive();
+extern bool weatherEffectsEnabled();
 
-QueueHandle_t websocketQueue = xQueueCreate(6, sizeof(websocketMessage));
+websocketRing_t dimmerToWebsocket;
+websocketRing_t sensorToWebsocket;
+websocketRing_t alarmToWebsocket;
 
 const char *MOON_SETTINGS_FILE = "/default.mnl";
+const char *EFFECT_SETTINGS_FILE = "/default.fx";
+const char *COLOR_KEYFRAME_FILE = "/default.col";
+const char *FIXTURE_FILE = "/default.fix";
+const char *THERMOSTAT_FILE = "/default.thm";
 const char *DEFAULT_TIMERFILE = "/default.aqu";
+const char *SCENE_DIRECTORY = "/scenes";
+const char *SCENE_EXTENSION = ".scn";
 
-AuthenticationMiddleware basicAuth;
+timedAuthMiddleware basicAuth;
+httpTraceMiddleware httpTrace;
 
 #endif
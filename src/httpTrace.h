@@ -0,0 +1,221 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _HTTPTRACE_H_
+#define _HTTPTRACE_H_
+
+#include <errno.h>
+#include <esp_http_server.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
+#include <PsychicHttp.h>
+
+#include "runtimeMetrics.h"
+#include "requestArena.h"
+
+/*
+    Request latency per route and the slowest requests since boot.
+    Everything here runs in the httpd task, which handles one request at a time.
+*/
+
+static constexpr size_t MAX_TRACED_ROUTES = 32; /* later routes are counted as 'other' */
+static constexpr size_t SLOWEST_REQUESTS = 8;
+static constexpr size_t HTTP_BUCKETS = 7;
+static constexpr uint32_t HTTP_BOUND_MS[HTTP_BUCKETS] = {1, 5, 10, 50, 100, 500, 1000};
+
+struct routeStats_t
+{
+    char route[32];
+    int method;
+    uint32_t count;
+    uint32_t bucket[HTTP_BUCKETS + 1];
+    uint32_t totalMs;
+    uint32_t maxUs;
+};
+
+struct slowRequest_t
+{
+    char route[32];
+    int method;
+    uint32_t uptimeSec;
+    uint32_t totalUs;
+    taskPhases_t phase;
+};
+
+static routeStats_t routeStats[MAX_TRACED_ROUTES + 1];
+static size_t tracedRoutes = 0;
+static slowRequest_t slowestRequest[SLOWEST_REQUESTS];
+
+/* same as the httpd default send - timed to split socket writes from handler time */
+static int timedSend(httpd_handle_t, int sockfd, const char *buffer, size_t length, int flags)
+{
+    phaseTimer send(taskPhases.sendUs);
+
+    if (!buffer)
+        return HTTPD_SOCK_ERR_INVALID;
+
+    const int sent = ::send(sockfd, buffer, length, flags);
+    if (sent < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+
+    return sent;
+}
+
+static routeStats_t &statsFor(const char *route, const int method)
+{
+    for (size_t i = 0; i < tracedRoutes; i++)
+        if (routeStats[i].method == method && !strcmp(routeStats[i].route, route))
+            return routeStats[i];
+
+    if (tracedRoutes == MAX_TRACED_ROUTES)
+    {
+        routeStats_t &other = routeStats[MAX_TRACED_ROUTES];
+        if (!*other.route)
+        {
+            strlcpy(other.route, "other", sizeof(other.route));
+            other.method = -1;
+        }
+        return other;
+    }
+
+    routeStats_t &stats = routeStats[tracedRoutes++];
+    strlcpy(stats.route, route, sizeof(stats.route));
+    stats.method = method;
+    return stats;
+}
+
+static void recordRequest(const char *route, const int method, const uint32_t totalUs, const taskPhases_t &phase)
+{
+    routeStats_t &stats = statsFor(route, method);
+    const uint32_t totalMs = totalUs / 1000;
+    size_t index = 0;
+    while (index < HTTP_BUCKETS && totalMs >= HTTP_BOUND_MS[index])
+        index++;
+    stats.bucket[index]++;
+    stats.count++;
+    stats.totalMs += totalMs;
+    if (totalUs > stats.maxUs)
+        stats.maxUs = totalUs;
+
+    slowRequest_t *fastest = &slowestRequest[0];
+    for (auto &request : slowestRequest)
+        if (request.totalUs < fastest->totalUs)
+            fastest = &request;
+
+    if (totalUs <= fastest->totalUs)
+        return;
+
+    strlcpy(fastest->route, route, sizeof(fastest->route));
+    fastest->method = method;
+    fastest->uptimeSec = esp_timer_get_time() / 1000000;
+    fastest->totalUs = totalUs;
+    fastest->phase = phase;
+}
+
+/* server wide - wraps the route middleware and the handler */
+class httpTraceMiddleware : public PsychicMiddleware
+{
+public:
+    esp_err_t run(PsychicRequest *request, PsychicResponse *response, PsychicMiddlewareNext next) override
+    {
+        httpd_req_t *req = request->request();
+        httpd_sess_set_send_override(req->handle, httpd_req_to_sockfd(req), timedSend);
+
+        const taskPhases_t before = taskPhases;
+        const int64_t start = esp_timer_get_time();
+
+        const esp_err_t result = next();
+
+        const uint32_t totalUs = esp_timer_get_time() - start;
+        const taskPhases_t phase = {taskPhases.authUs - before.authUs,
+                                    taskPhases.lockWaitUs - before.lockWaitUs,
+                                    taskPhases.storageUs - before.storageUs,
+                                    taskPhases.sendUs - before.sendUs};
+
+        /* the route without the query string */
+        char route[sizeof(routeStats_t::route)];
+        const size_t length = strcspn(req->uri, "?");
+        strlcpy(route, req->uri, min(length + 1, sizeof(route)));
+
+        recordRequest(route, req->method, totalUs, phase);
+        return result;
+    }
+};
+
+/* basic auth that adds the time it takes to the auth phase */
+class timedAuthMiddleware : public AuthenticationMiddleware
+{
+public:
+    esp_err_t run(PsychicRequest *request, PsychicResponse *response, PsychicMiddlewareNext next) override
+    {
+        const int64_t start = esp_timer_get_time();
+        bool passed = false;
+
+        const esp_err_t result = AuthenticationMiddleware::run(request, response, [&]()
+                                                               {
+            passed = true;
+            taskPhases.authUs += esp_timer_get_time() - start;
+            return next(); });
+
+        if (!passed)
+            taskPhases.authUs += esp_timer_get_time() - start;
+
+        return result;
+    }
+};
+
+static void describeHttpStats(arenaText &content)
+{
+    content.add("Method,Route,Requests,Avg ms,Max ms");
+    for (size_t i = 0; i < HTTP_BUCKETS; i++)
+        content.printf(",<%" PRIu32 " ms", HTTP_BOUND_MS[i]);
+    content.add(",slower\n");
+
+    for (const auto &stats : routeStats)
+    {
+        if (!stats.count)
+            continue;
+
+        content.printf("%s,%s,%" PRIu32 ",%" PRIu32 ",%.1f", stats.method < 0 ? "*" : http_method_str((http_method)stats.method), stats.route,
+                       stats.count, stats.totalMs / stats.count, stats.maxUs / 1000.0f);
+        for (const auto count : stats.bucket)
+            content.printf(",%" PRIu32, count);
+        content.add("\n");
+    }
+
+    content.add("\nSlowest requests\nUptime s,Method,Route,Total ms,Auth ms,Lock wait ms,SD ms,Send ms,Other ms\n");
+    for (const auto &request : slowestRequest)
+    {
+        if (!request.totalUs)
+            continue;
+
+        const taskPhases_t &phase = request.phase;
+        const uint32_t accounted = phase.authUs + phase.lockWaitUs + phase.storageUs + phase.sendUs;
+        content.printf("%" PRIu32 ",%s,%s,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", request.uptimeSec,
+                       http_method_str((http_method)request.method), request.route, request.totalUs / 1000.0f,
+                       phase.authUs / 1000.0f, phase.lockWaitUs / 1000.0f, phase.storageUs / 1000.0f, phase.sendUs / 1000.0f,
+                       request.totalUs > accounted ? (request.totalUs - accounted) / 1000.0f : 0.0f);
+    }
+}
+
+#endif
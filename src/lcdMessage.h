@@ -24,21 +24,36 @@ SOFTWARE.
 #ifndef _LCDMESSAGE_H_
 #define _LCDMESSAGE_H_
 
+#include "spscRing.h"
+
 enum lcdMessageType
 {
     SET_BRIGHTNESS,
     LCD_SYSTEM_MESSAGE,
     UPDATE_LIGHTS,
     TEMPERATURE,
-    SHOW_IP
+    SHOW_IP,
+    ALARM_BANNER
 };
 
 struct lcdMessage_t
+{
+    lcdMessageType type;
+    union
+    {
+        int32_t int1;
+        float float1;
+    };
+};
+
+/* system messages, the ip address and the alarm banner - see messageOnLcd(), showIPonDisplay() and alarmTask */
+struct lcdTextMessage_t
 {
     lcdMessageType type;
     char str[64];
-    int32_t int1;
-    float float1;
 };
 
+using lcdRing_t = spscRing<lcdMessage_t, 4>;
+using lcdTextRing_t = spscRing<lcdTextMessage_t, 8>;
+
 #endif
\ No newline at end of file
@@ -29,12 +29,20 @@ float mapf(const float x, const float in_min, const float in_max, const float ou
     return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
 
-void messageOnLcd(const char *str)
+void textOnLcd(const lcdMessageType type, const char *str)
 {
-    lcdMessage_t msg;
+    lcdTextMessage_t msg;
+    msg.type = type;
     snprintf(msg.str, sizeof(msg.str), "%s", str);
-    msg.type = lcdMessageType::LCD_SYSTEM_MESSAGE;
-    xQueueSend(lcdQueue, &msg, portMAX_DELAY);
+
+    ScopedMutex lock(lcdTextMutex);
+    if (!textToLcd.push(msg))
+        log_w("lcd text ring full - dropped '%s'", str);
+}
+
+void messageOnLcd(const char *str)
+{
+    textOnLcd(lcdMessageType::LCD_SYSTEM_MESSAGE, str);
 }
 
 void pushSpriteLocked(LGFX_Sprite &sprite, int32_t y)
@@ -99,20 +107,26 @@ static void updateLights()
     lightBars.clear();
 
     const int BAR_HEIGHT = lightBars.height() - font.yAdvance - 3;
-    constexpr const int BAR_WIDTH = 38;
-    const int DISTANCE = lightBars.width() / NUMBER_OF_CHANNELS;
+    static lightState_t state; /* keeps the snapshot off the small lcdTask stack */
+    lightState.read(state);
+    if (!state.count)
+        return;
+
+    const int DISTANCE = lightBars.width() / state.count;
     const int HALF_DISTANCE = DISTANCE / 2;
-    for (int ch = 0; ch < NUMBER_OF_CHANNELS; ch++)
+    const int BAR_WIDTH = min(38, DISTANCE - 4);
+    const char *format = DISTANCE >= 48 ? "%03.2f%%" : "%.0f"; /* the labels of more than 6 channels have to be shorter */
+    for (int ch = 0; ch < state.count; ch++)
     {
         char buffer[16];
-        snprintf(buffer, sizeof(buffer), "%03.2f%%", currentPercentage[ch]);
+        snprintf(buffer, sizeof(buffer), format, state.level[ch]);
 
         int w = 0;
         lightBars.textLength(buffer, w);
         const int THIS_OFFSET = HALF_DISTANCE + (ch * DISTANCE);
         lightBars.drawCenterString(buffer, THIS_OFFSET - (w / 2), lightBars.height() - font.yAdvance, &font);
 
-        const int filledHeight = mapf(currentPercentage[ch], 0, 100, 0, BAR_HEIGHT);
+        const int filledHeight = mapf(state.level[ch], 0, 100, 0, BAR_HEIGHT);
         lightBars.drawRect(THIS_OFFSET - (BAR_WIDTH / 2), BAR_HEIGHT, BAR_WIDTH, -BAR_HEIGHT, 1);
         lightBars.fillRect(THIS_OFFSET - (BAR_WIDTH / 2), BAR_HEIGHT, BAR_WIDTH, -filledHeight, 1);
     }
@@ -120,6 +134,9 @@ static void updateLights()
     pushSpriteLocked(lightBars, yPos);
 }
 
+/* shown instead of the temperature while not empty */
+static char alarmBanner[sizeof(lcdTextMessage_t::str)] = "";
+
 static void showTemp(const float temperature)
 {
     const GFXfont &font = DejaVu24Modded;
@@ -140,11 +157,13 @@ static void showTemp(const float temperature)
     temp.setTextColor(0, 3);
     temp.setTextDatum(CC_DATUM);
 
-    const size_t bgColor = (temperature == -127.0) ? 3 : 2;
+    const size_t bgColor = (temperature == -127.0 || *alarmBanner) ? 3 : 2;
     temp.clear(bgColor);
     temp.setTextColor(0, bgColor);
 
-    if (temperature != -127.0)
+    if (*alarmBanner)
+        temp.drawString(alarmBanner, temp.width() >> 1, 3 + (font.yAdvance >> 1), &DejaVu18);
+    else if (temperature != -127.0)
     {
         char buffer[10];
         snprintf(buffer, sizeof(buffer), "%.2f°C", temperature);
@@ -183,39 +202,74 @@ void showIP(const char *ip)
     pushSpriteLocked(ipAddress, 0);
 }
 
-void handleNextMessage()
+static float lastTemperature = -127.0; /* to redraw under a new or cleared alarm banner */
+
+static void handleMessage(const lcdMessage_t &msg)
 {
-    lcdMessage_t msg;
-    if (xQueueReceive(lcdQueue, &msg, 0))
+    switch (msg.type)
     {
-        switch (msg.type)
-        {
-        case lcdMessageType::SET_BRIGHTNESS:
-            lcd.setBrightness(msg.int1);
-            break;
+    case lcdMessageType::SET_BRIGHTNESS:
+        lcd.setBrightness(msg.int1);
+        break;
 
-        case lcdMessageType::LCD_SYSTEM_MESSAGE:
-            showSystemMessage(msg.str);
-            break;
+    case lcdMessageType::UPDATE_LIGHTS:
+        updateLights();
+        break;
 
-        case lcdMessageType::UPDATE_LIGHTS:
-            updateLights();
-            break;
+    case lcdMessageType::TEMPERATURE:
+        lastTemperature = msg.float1;
+        showTemp(msg.float1);
+        break;
 
-        case lcdMessageType::SHOW_IP:
-            showIP(msg.str);
-            break;
+    default:
+        break;
+    }
+}
+
+static void handleTextMessage(lcdTextMessage_t &msg)
+{
+    switch (msg.type)
+    {
+    case lcdMessageType::LCD_SYSTEM_MESSAGE:
+        showSystemMessage(msg.str);
+        break;
 
-        case lcdMessageType::TEMPERATURE:
-            showTemp(msg.float1);
-            break;
+    case lcdMessageType::SHOW_IP:
+        showIP(msg.str);
+        break;
 
-        default:
-            break;
-        }
+    case lcdMessageType::ALARM_BANNER:
+        strlcpy(alarmBanner, msg.str, sizeof(alarmBanner));
+        showTemp(lastTemperature);
+        break;
+
+    default:
+        break;
     }
 }
 
+static void handlePendingMessages()
+{
+    static lcdTextMessage_t text;
+    while (textToLcd.pop(text))
+        handleTextMessage(text);
+
+    lcdMessage_t msg;
+    while (sensorToLcd.pop(msg))
+        handleMessage(msg);
+
+    /* only the last light update matters */
+    bool updateLightBars = false;
+    while (dimmerToLcd.pop(msg))
+        if (msg.type == lcdMessageType::UPDATE_LIGHTS)
+            updateLightBars = true;
+        else
+            handleMessage(msg);
+
+    if (updateLightBars)
+        updateLights();
+}
+
 void lcdTask(void *parameter)
 {
     {
@@ -224,11 +278,15 @@ void lcdTask(void *parameter)
     }
 
     log_i("lcd init done");
+    bootStageReady(BOOT_LCD);
+
+    textToLcd.setConsumer(xTaskGetCurrentTaskHandle());
+    sensorToLcd.setConsumer(xTaskGetCurrentTaskHandle());
+    dimmerToLcd.setConsumer(xTaskGetCurrentTaskHandle());
 
     while (1)
     {
-        lcdMessage_t dummy;
-        if (xQueuePeek(lcdQueue, &dummy, portMAX_DELAY))
-            handleNextMessage();
+        handlePendingMessages();
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
 }
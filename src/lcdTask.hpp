@@ -30,13 +30,20 @@ SOFTWARE.
 #include <WiFi.h>
 
 #include "lcdMessage.h"
+#include "bootState.h"
+#include "channelConfig.h"
+#include "stateBoard.h"
 #include "fonts/DejaVu24-modded.h" /* contains percent sign and a modified superscript 2 - to subscript*/
                                    /* modded with https://tchapi.github.io/Adafruit-GFX-Font-Customiser/ */
 
-extern float currentPercentage[NUMBER_OF_CHANNELS];
+extern seqlock<lightState_t> lightState;
 extern SemaphoreHandle_t spiMutex;
 
-QueueHandle_t lcdQueue = xQueueCreate(6, sizeof(lcdMessage_t));
+lcdRing_t dimmerToLcd;
+lcdRing_t sensorToLcd;
+lcdTextRing_t textToLcd; /* any task can send text - producers are serialized by lcdTextMutex */
+
+static SemaphoreHandle_t lcdTextMutex = xSemaphoreCreateMutex();
 
 static LGFX lcd;
 
@@ -0,0 +1,138 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _LIGHTLAYER_H_
+#define _LIGHTLAYER_H_
+
+#include <string.h>
+#include <strings.h>
+
+#include "segmentTable.h"
+#include "channelConfig.h"
+
+enum layerBlendMode : uint8_t
+{
+    BLEND_REPLACE,
+    BLEND_MAX,
+    BLEND_MIN
+};
+
+static inline float blendLayer(const float below, const float level, const layerBlendMode mode)
+{
+    switch (mode)
+    {
+    case BLEND_MAX:
+        return level > below ? level : below;
+    case BLEND_MIN:
+        return level < below ? level : below;
+    default:
+        return level;
+    }
+}
+
+/*
+    One source of light levels in the dimmer compositor.
+    Layers are stacked per channel in ascending priority and each layer blends its level onto the result below.
+*/
+class lightLayer
+{
+public:
+    virtual ~lightLayer() = default;
+
+    /* msToday is used by layers on the day clock, msActive - time since activate() - by all others */
+    virtual float evaluate(const int channel, const uint32_t msToday, const uint32_t msActive) = 0;
+
+    /* the level of this layer on top of the level below */
+    virtual float apply(const int channel, const float below, const uint32_t msToday, const uint32_t msActive)
+    {
+        return blendLayer(below, evaluate(channel, msToday, msActive), blend);
+    }
+
+    void activate(const unsigned long nowMs, const unsigned long durationMs)
+    {
+        startMs = nowMs;
+        untilMs = nowMs + durationMs;
+        expires = durationMs > 0;
+        active = true;
+    }
+
+    bool expired(const unsigned long nowMs) const { return active && expires && (long)(nowMs - untilMs) >= 0; }
+    bool covers(const int channel) const { return channelMask & (1UL << channel); }
+
+    char name[24] = {};
+    uint8_t priority = 0;
+    layerBlendMode blend = BLEND_REPLACE;
+    bool active = false;
+    bool expires = false;
+    bool dayClock = false; /* evaluated on time since midnight instead of time since activation */
+    unsigned long startMs = 0;
+    unsigned long untilMs = 0;
+    uint32_t channelMask = 0;
+};
+
+template <size_t SEGMENTS, size_t CHANNELS>
+class segmentLayer : public lightLayer
+{
+public:
+    float evaluate(const int channel, const uint32_t msToday, const uint32_t msActive) override
+    {
+        return table[channel].evaluate(dayClock ? msToday : msActive);
+    }
+
+    segmentTable<SEGMENTS> table[CHANNELS];
+};
+
+/* a single level - used for manual overrides */
+class constantLayer : public lightLayer
+{
+public:
+    float evaluate(const int /*channel*/, const uint32_t /*msToday*/, const uint32_t /*msActive*/) override { return level; }
+
+    float level = 0;
+};
+
+static constexpr size_t MAX_ACTIVE_SCENES = 4;
+static constexpr size_t MAX_SCENE_SEGMENTS = 16;
+
+using sceneLayer_t = segmentLayer<MAX_SCENE_SEGMENTS, MAX_CHANNELS>;
+
+static inline layerBlendMode parseBlendMode(const char *str, bool &valid)
+{
+    valid = true;
+    if (!strcasecmp(str, "max"))
+        return BLEND_MAX;
+    if (!strcasecmp(str, "min"))
+        return BLEND_MIN;
+    if (!strcasecmp(str, "replace"))
+        return BLEND_REPLACE;
+    valid = false;
+    return BLEND_REPLACE;
+}
+
+static inline const char *blendModeName(const layerBlendMode mode)
+{
+    return mode == BLEND_MAX ? "max" : mode == BLEND_MIN ? "min"
+                                                         : "replace";
+}
+
+#endif
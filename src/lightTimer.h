@@ -24,10 +24,81 @@ SOFTWARE.
 #ifndef _LIGHTTIMER_H_
 #define _LIGHTTIMER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fixedVector.h"
+
+static constexpr size_t MAX_TIMERS_PER_CHANNEL = 100; /* including the closing timer at 86400 */
+
+enum timerAnchor : uint8_t
+{
+    ANCHOR_MIDNIGHT,
+    ANCHOR_SUNRISE,
+    ANCHOR_SUNSET
+};
+
 struct lightTimer_t
 {
     int time;        /* time in seconds since midnight so range is 0-86400 */
     int percentage; /* in percentage so range is 0-100 */
+    int offset : 24; /* seconds from the anchor - time is resolved from these once a day */
+    unsigned anchor : 8;
+};
+
+/* 'sunrise', 'sunset-3600' or 'sunrise+1800' to the anchor and offset of timer - false when str is none of these */
+static inline bool parseAnchor(const char *str, lightTimer_t &timer)
+{
+    size_t length;
+    if (!strncmp(str, "sunrise", 7))
+    {
+        timer.anchor = ANCHOR_SUNRISE;
+        length = 7;
+    }
+    else if (!strncmp(str, "sunset", 6))
+    {
+        timer.anchor = ANCHOR_SUNSET;
+        length = 6;
+    }
+    else
+        return false;
+
+    const char *rest = str + length;
+    long offset = 0;
+    if (*rest == '+' || *rest == '-')
+    {
+        char *end;
+        offset = strtol(rest, &end, 10);
+        if (end == rest + 1 || offset < -86399 || offset > 86399)
+            return false;
+        rest = end;
+    }
+
+    timer.offset = offset;
+    return !*rest || *rest == ',' || *rest == '\r' || *rest == '\n' || *rest == ' ';
+}
+
+static inline const char *anchorName(const lightTimer_t &timer) { return timer.anchor == ANCHOR_SUNRISE ? "sunrise" : "sunset"; }
+
+/* seconds since local midnight - set once a day by the calendar task */
+struct sunTimes_t
+{
+    int sunrise;
+    int sunset;
 };
 
+/* the time of an anchored timer on a day with these sun times - kept within the day */
+static inline int resolvedTime(const lightTimer_t &timer, const sunTimes_t &sun)
+{
+    if (timer.anchor == ANCHOR_MIDNIGHT)
+        return timer.time;
+
+    const int time = (timer.anchor == ANCHOR_SUNRISE ? sun.sunrise : sun.sunset) + timer.offset;
+    return time < 0 ? 0 : time > 86399 ? 86399 : time;
+}
+
+using timerList_t = fixedVector<lightTimer_t, MAX_TIMERS_PER_CHANNEL>;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _LIGHTTRANSITION_H_
+#define _LIGHTTRANSITION_H_
+
+struct lightTransition_t
+{
+    float from;               /* output level in percent when the transition started */
+    unsigned long startMs;    /* millis() at start */
+    unsigned long durationMs; /* 0 means no transition */
+
+    /* linear blend from 'from' to a - possibly moving - target */
+    inline float blend(const float target, const unsigned long nowMs) const
+    {
+        const unsigned long elapsed = nowMs - startMs;
+        return elapsed < durationMs ? from + (target - from) * (float(elapsed) / float(durationMs)) : target;
+    }
+};
+
+#endif
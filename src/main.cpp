@@ -27,51 +27,167 @@ SOFTWARE.
 #include <FS.h>
 #include <SD.h>
 #include <esp_sntp.h>
+#include <driver/gpio.h>
 #include <NetworkEvents.h>
 #include <freertos/semphr.h>
-#include <vector>
+#include <algorithm>
 
 #include "ScopedMutex.h"
 #include "secrets.h"
 #include "lcdMessage.h"
 #include "lightTimer.h"
+#include "timerSimplifier.h"
+#include "channelConfig.h"
+#include "outputBackend.h"
+#include "bootState.h"
+#include "scheduleCalendar.h"
 
 SemaphoreHandle_t spiMutex;
 
 extern const char *DEFAULT_TIMERFILE;
 
-extern QueueHandle_t lcdQueue;
 extern void messageOnLcd(const char *str);
+extern void textOnLcd(const lcdMessageType type, const char *str);
 
 extern void dimmerTask(void *parameter);
 extern void httpTask(void *parameter);
 extern void lcdTask(void *parameter);
 extern void sensorTask(void *parameter);
+extern void holdoverTask(void *parameter);
+extern void calendarTask(void *parameter);
+extern void alarmTask(void *parameter);
+extern bool restoreHoldoverTime();
 extern bool loadMoonSettings(String &result);
+extern bool loadEffectSettings(String &result);
+extern bool loadColorSettings(String &result);
+extern bool loadThermostatSettings(String &result);
 
-extern std::vector<lightTimer_t> channel[NUMBER_OF_CHANNELS];
+extern channelConfig_t channelConfig;
+extern timerList_t channel[MAX_CHANNELS];
 extern SemaphoreHandle_t channelMutex;
-extern float fullMoonLevel[NUMBER_OF_CHANNELS];
+extern uint32_t scheduleVersion;
+extern float scheduleScale;
+extern float fullMoonLevel[MAX_CHANNELS];
+extern bool timeIsValid;
+extern sunTimes_t sunTimes;
 
 bool sensorTaskRunning = false;
 static TaskHandle_t sensorTaskHandle = nullptr;
 static SemaphoreHandle_t sensorTaskMutex = xSemaphoreCreateMutex();
+static TaskHandle_t holdoverTaskHandle = nullptr;
+static EventGroupHandle_t bootEvents = xEventGroupCreate();
+
+int64_t bootStageReadyUs[NUMBER_OF_BOOT_STAGES] = {};
+mutexMetrics_t mutexMetrics[MAX_TRACKED_MUTEXES];
+thread_local taskPhases_t taskPhases;
 
 constexpr const char *DEFAULT_NETFILE = "/default.net";
+const char *CHANNEL_CONFIG_FILE = "/default.chn";
 
 static void showIPonDisplay()
 {
-    lcdMessage_t msg;
-    msg.type = SHOW_IP;
-    snprintf(msg.str, sizeof(msg.str), "%s", WiFi.localIP().toString().c_str());
-    xQueueSend(lcdQueue, &msg, portMAX_DELAY);
+#ifndef HEADLESS_BUILD
+    textOnLcd(SHOW_IP, WiFi.localIP().toString().c_str());
+#endif
+}
+
+void bootStageReady(const bootStage stage)
+{
+    if (xEventGroupGetBits(bootEvents) & bootBit(stage))
+        return;
+
+    bootStageReadyUs[stage] = esp_timer_get_time();
+    xEventGroupSetBits(bootEvents, bootBit(stage));
+    log_i("boot stage '%s' ready after %lli ms", bootStageName[stage], bootStageReadyUs[stage] / 1000);
+}
+
+void trackMutex(const SemaphoreHandle_t mutex, const char *name)
+{
+    for (auto &metrics : mutexMetrics)
+        if (!metrics.handle.load())
+        {
+            metrics.name = name;
+            metrics.handle.store(mutex);
+            return;
+        }
+
+    log_w("no room to track mutex '%s'", name);
 }
 
+#if MUTEX_PROFILING
+lockSite_t lockSites[MAX_LOCK_SITES];
+std::atomic<uint32_t> lockSitesDropped{0};
+std::atomic<uint32_t> lockOrder[MAX_TRACKED_MUTEXES];
+std::atomic<uint32_t> lockOrderInversions{0};
+std::atomic<uint32_t> inversionReported[MAX_TRACKED_MUTEXES];
+std::atomic<const lockSite_t *> lastInversionSite{nullptr};
+thread_local heldLocks_t heldLocks;
+
+lockSite_t *lockSiteFor(const char *file, const int line, const SemaphoreHandle_t mutex)
+{
+    for (auto &site : lockSites)
+    {
+        const char *siteFile = site.file.load(std::memory_order_acquire);
+        if (!siteFile)
+            break;
+        if (siteFile == file && site.line == line && site.mutex == mutex)
+            return &site;
+    }
+
+    /* first time this site locks - rare enough for a critical section */
+    static portMUX_TYPE siteLock = portMUX_INITIALIZER_UNLOCKED;
+    lockSite_t *found = nullptr;
+    portENTER_CRITICAL(&siteLock);
+    for (auto &site : lockSites)
+    {
+        const char *siteFile = site.file.load(std::memory_order_relaxed);
+        if (siteFile == file && site.line == line && site.mutex == mutex)
+        {
+            found = &site;
+            break;
+        }
+        if (!siteFile)
+        {
+            site.line = line;
+            site.mutex = mutex;
+            site.file.store(file, std::memory_order_release);
+            found = &site;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&siteLock);
+
+    if (!found)
+        lockSitesDropped.fetch_add(1, std::memory_order_relaxed);
+    return found;
+}
+#endif
+
+void waitForBootStages(const EventBits_t stages)
+{
+    xEventGroupWaitBits(bootEvents, stages, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+static void ntpCb(void *cb_arg);
+
 static void WiFiEvent(arduino_event_id_t event)
 {
     switch (event)
     {
     case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+        showIPonDisplay();
+        if (!(xEventGroupGetBits(bootEvents) & bootBit(BOOT_NETWORK)))
+        {
+#ifndef HEADLESS_BUILD
+            if (!timeIsValid)
+                messageOnLcd("Syncing clock...");
+#endif
+            log_i("syncing NTP");
+            sntp_set_time_sync_notification_cb((sntp_sync_time_cb_t)ntpCb);
+            configTzTime(TIMEZONE, NTP_POOL);
+        }
+        bootStageReady(BOOT_NETWORK);
+        break;
     case ARDUINO_EVENT_WIFI_STA_LOST_IP:
         showIPonDisplay();
         break;
@@ -82,19 +198,12 @@ static void WiFiEvent(arduino_event_id_t event)
 
 static void startDimmerTask()
 {
-    static TaskHandle_t dimmerTaskHandle = NULL;
-    if (dimmerTaskHandle && (eTaskGetState(dimmerTaskHandle) == eRunning))
-    {
-        log_e("can not start dimmerTask - task already running");
-        return;
-    }
-
     const auto taskResult = xTaskCreatePinnedToCore(dimmerTask,
                                                     "dimmerTask",
                                                     1024 * 8,
                                                     NULL,
                                                     tskIDLE_PRIORITY + 5,
-                                                    &dimmerTaskHandle,
+                                                    NULL,
                                                     APP_CPU_NUM);
     if (taskResult != pdPASS)
     {
@@ -104,42 +213,72 @@ static void startDimmerTask()
     }
 }
 
+static void startHttpTask()
+{
+    const BaseType_t result = xTaskCreate(httpTask,
+                                          "httpTask",
+                                          4096,
+                                          NULL,
+                                          tskIDLE_PRIORITY,
+                                          NULL);
+    if (result != pdPASS)
+    {
+        log_e("could not start httpTask. system halted!");
+        while (1)
+            delay(100);
+    }
+}
+
 struct WiFisecrets
 {
-    String ssid;
-    String psk;
+    char ssid[33]; /* 32 characters max */
+    char psk[64];  /* 63 characters max */
 };
 
+static char *trimmed(char *str)
+{
+    while (isspace((unsigned char)*str))
+        str++;
+
+    char *end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1]))
+        *--end = 0;
+
+    return str;
+}
+
 bool parseWiFisecrets(File &file, String &result, WiFisecrets &secrets)
 {
     secrets = {};
     while (file.available())
     {
-        String line = file.readStringUntil('\n');
-        line.trim();
-        if (line.isEmpty() || line.startsWith("#")) // skip blanks/comments
+        char buffer[128];
+        const size_t length = file.readBytesUntil('\n', buffer, sizeof(buffer) - 1);
+        buffer[length] = 0;
+
+        char *line = trimmed(buffer);
+        if (!*line || *line == '#') // skip blanks/comments
             continue;
 
-        int sep = line.indexOf('=');
-        if (sep == -1)
+        char *sep = strchr(line, '=');
+        if (!sep)
         {
-            result = "Invalid line in WiFi secrets file: " + line;
+            result = "Invalid line in WiFi secrets file: " + String(line);
             return false;
         }
 
-        String key = line.substring(0, sep);
-        String value = line.substring(sep + 1);
-        key.trim();
-        value.trim();
+        *sep = 0;
+        const char *key = trimmed(line);
+        const char *value = trimmed(sep + 1);
 
-        if (key.equalsIgnoreCase("SSID"))
-            secrets.ssid = value;
+        if (!strcasecmp(key, "SSID"))
+            strlcpy(secrets.ssid, value, sizeof(secrets.ssid));
 
-        else if (key.equalsIgnoreCase("PSK"))
-            secrets.psk = value;
+        else if (!strcasecmp(key, "PSK"))
+            strlcpy(secrets.psk, value, sizeof(secrets.psk));
     }
 
-    if (secrets.ssid.isEmpty() || secrets.psk.isEmpty())
+    if (!*secrets.ssid || !*secrets.psk)
     {
         result = "Missing SSID or PSK in WiFi secrets file";
         return false;
@@ -168,28 +307,238 @@ bool loadSecretsFromSD(String &result, WiFisecrets &secrets)
     return success;
 }
 
+/*
+    Output settings per channel, channels are numbered from 0 without gaps.
+    Only pin - or pca for a PCA9685 output - is required, see channelConfig_t::setDefault() for the defaults.
+
+    [0]
+    pin=3
+    ledc=2          LEDC channel, two neighbouring LEDC channels (0/1, 2/3...) share a timer
+    frequency=1220  Hz
+    bits=16         PWM bit depth
+    curve=linear    or a gamma exponent like 2.2
+    [1]
+    pca=0           output 0-15 on the PCA9685, always 12 bit and all outputs share one frequency
+*/
+static bool parseChannelConfig(File &file, channelConfig_t &config, String &result)
+{
+    config.count = 0;
+    bool havePin[MAX_CHANNELS] = {};
+    int currentLine = 0;
+
+    while (file.available())
+    {
+        String line = file.readStringUntil('\n');
+        currentLine++;
+
+        const int comment = line.indexOf('#');
+        if (comment != -1)
+            line.remove(comment);
+
+        line.trim();
+        if (line.isEmpty())
+            continue;
+
+        if (line.startsWith("["))
+        {
+            int index;
+            if (sscanf(line.c_str(), "[%d]", &index) != 1 || index != config.count || index >= MAX_CHANNELS)
+            {
+                result = "invalid or out of order channel at line " + String(currentLine);
+                return false;
+            }
+            config.setDefault(index, 0);
+            config.count++;
+            continue;
+        }
+
+        const int sep = line.indexOf('=');
+        if (!config.count || sep == -1)
+        {
+            result = "invalid line " + String(currentLine);
+            return false;
+        }
+
+        const int index = config.count - 1;
+        String key = line.substring(0, sep);
+        String value = line.substring(sep + 1);
+        key.trim();
+        value.trim();
+
+        const long number = value.toInt();
+        bool valid = true;
+        if (key.equalsIgnoreCase("pin"))
+        {
+            valid = number >= 0 && number < GPIO_NUM_MAX && GPIO_IS_VALID_OUTPUT_GPIO(number);
+            config.pin[index] = number;
+            havePin[index] = true;
+        }
+        else if (key.equalsIgnoreCase("pca"))
+        {
+            valid = HAVE_PCA9685 && number >= 0 && number < pca9685Backend::OUTPUTS;
+            config.output[index] = OUTPUT_PCA9685;
+            config.pin[index] = number;
+            havePin[index] = true;
+        }
+        else if (key.equalsIgnoreCase("ledc"))
+        {
+            valid = number >= 0 && number < LEDC_CHANNEL_COUNT;
+            config.ledcChannel[index] = number;
+        }
+        else if (key.equalsIgnoreCase("frequency"))
+        {
+            valid = number > 0 && number <= 40000;
+            config.frequency[index] = number;
+        }
+        else if (key.equalsIgnoreCase("bits"))
+        {
+            valid = number > 0 && number <= SOC_LEDC_TIMER_BIT_WIDTH;
+            config.bitDepth[index] = number;
+            config.maxDuty[index] = (1UL << number) - 1;
+        }
+        else if (key.equalsIgnoreCase("curve"))
+        {
+            const float gamma = value.equalsIgnoreCase("linear") ? 1.0f : value.toFloat();
+            valid = gamma >= 0.5f && gamma <= 4.0f;
+            config.gamma[index] = gamma;
+        }
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            result = "invalid setting at line " + String(currentLine);
+            return false;
+        }
+    }
+
+    if (!config.count)
+    {
+        result = "no channels in file";
+        return false;
+    }
+
+    for (int index = 0; index < config.count; index++)
+    {
+        if (!havePin[index])
+        {
+            result = "no pin set for channel " + String(index);
+            return false;
+        }
+
+        if (config.output[index] == OUTPUT_PCA9685)
+        {
+            config.bitDepth[index] = pca9685Backend::BITDEPTH;
+            config.maxDuty[index] = pca9685Backend::MAX_DUTY;
+
+            for (int other = 0; other < index; other++)
+                if (config.output[other] == OUTPUT_PCA9685 &&
+                    (config.pin[other] == config.pin[index] || config.frequency[other] != config.frequency[index]))
+                {
+                    result = "channel " + String(index) + " uses the same PCA9685 output or another frequency than channel " + String(other);
+                    return false;
+                }
+
+            if (config.frequency[index] < pca9685Backend::MIN_FREQUENCY || config.frequency[index] > pca9685Backend::MAX_FREQUENCY)
+            {
+                result = "PCA9685 frequency out of range for channel " + String(index);
+                return false;
+            }
+            continue;
+        }
+
+        if ((uint64_t)config.frequency[index] << config.bitDepth[index] > LEDC_SOURCE_CLOCK_HZ)
+        {
+            result = "frequency too high for the bit depth of channel " + String(index);
+            return false;
+        }
+
+        for (int other = 0; other < index; other++)
+        {
+            if (config.output[other] != OUTPUT_LEDC)
+                continue;
+
+            if (config.pin[other] == config.pin[index] || config.ledcChannel[other] == config.ledcChannel[index])
+            {
+                result = "channel " + String(index) + " uses the same pin or LEDC channel as channel " + String(other);
+                return false;
+            }
+
+            /* the Arduino core gives every pair of LEDC channels its own timer */
+            if (config.ledcChannel[other] / 2 == config.ledcChannel[index] / 2 &&
+                (config.frequency[other] != config.frequency[index] || config.bitDepth[other] != config.bitDepth[index]))
+            {
+                result = "channel " + String(index) + " shares a LEDC timer with channel " + String(other) + " but has a different frequency or bit depth";
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* called from setup() before any task that uses channelConfig is started */
+bool loadChannelConfig(String &result)
+{
+    channelConfig.setDefaults();
+
+    ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
+    if (!lock.acquired())
+    {
+        result = "Mutex timeout";
+        return false;
+    }
+
+    File file = SD.open(CHANNEL_CONFIG_FILE, FILE_READ);
+    if (!file)
+    {
+        result = "No channel config - using " + String(channelConfig.count) + " channels from platformio.ini";
+        return false;
+    }
+
+    log_i("parsing '%s'", file.path());
+
+    static channelConfig_t config;
+    if (!parseChannelConfig(file, config, result))
+    {
+        result = "Invalid channel config: " + result + " - using defaults";
+        return false;
+    }
+
+    channelConfig = config;
+    result = "Configured " + String(channelConfig.count) + " channels";
+    return true;
+}
+
 static void ntpCb(void *cb_arg)
 {
     log_i("NTP synced");
     sntp_set_time_sync_notification_cb(NULL);
 
-    const BaseType_t result = xTaskCreate(httpTask,
-                                          "httpTask",
-                                          4096,
-                                          NULL,
-                                          tskIDLE_PRIORITY,
-                                          NULL);
-    if (result != pdPASS)
-    {
-        log_e("could not start httpTask. system halted!");
-        while (1)
-            delay(100);
-    }
+    timeIsValid = true;
+    if (holdoverTaskHandle)
+        xTaskNotifyGive(holdoverTaskHandle);
+
+    bootStageReady(BOOT_TIME);
+}
+
+/* staging for parseTimerFile() and POST /api/timers - protected by spiMutex, which every import holds */
+importList_t importedTimers;
+static timerSimplifier<MAX_IMPORTED_TIMERS> simplifier;
+
+/* DEFAULT_TIMERFILE or the profile the calendar selected - used by loadTimerFile() and saveDefaultTimers(), protected by spiMutex */
+static char timerFileInUse[48];
 
-    startDimmerTask();
+/* drops the timers in importedTimers that are within toleranceLsb PWM steps of the line through the timers around them */
+simplifyResult_t simplifyImportedTimers(const int index, const float toleranceLsb)
+{
+    const float gamma = channelConfig.gamma[index];
+    const float maxDuty = channelConfig.maxDuty[index];
+    return simplifier.simplify(importedTimers, toleranceLsb, [gamma, maxDuty](const float percentage)
+                               { return gamma == 1.0f ? percentage / 100 * maxDuty : powf(percentage / 100, gamma) * maxDuty; });
 }
 
-static bool parseTimerFile(File &file, String &result)
+static bool parseTimerFile(File &file, String &result, const calendarDay_t *day)
 {
     log_i("parsing '%s'", file.path());
 
@@ -198,7 +547,10 @@ static bool parseTimerFile(File &file, String &result)
     constexpr int MAX_PERCENTAGE = 100;
     constexpr int MIN_PERCENTAGE = 0;
     constexpr int MIN_CHANNEL = 0;
-    constexpr int MAX_CHANNEL = NUMBER_OF_CHANNELS - 1;
+    const int MAX_CHANNEL = channelConfig.count - 1;
+
+    size_t removedTimers = 0;
+    float maxError = 0;
 
     {
         ScopedMutex lock(channelMutex, pdMS_TO_TICKS(1000));
@@ -208,9 +560,17 @@ static bool parseTimerFile(File &file, String &result)
             return false;
         }
 
-        for (int i = 0; i < NUMBER_OF_CHANNELS;)
+        for (int i = 0; i < channelConfig.count;)
             channel[i++].clear();
 
+        if (day)
+        {
+            scheduleScale = day->scale;
+            sunTimes = day->sun;
+        }
+
+        scheduleVersion++;
+
         String line = file.readStringUntil('\n');
         int currentLine = 1;
 
@@ -223,7 +583,11 @@ static bool parseTimerFile(File &file, String &result)
                 continue;
             }
 
-            if (line.length() < 3 || line[0] != '[' || !isdigit(line[1]) || line[2] != ']')
+            unsigned int headerEnd = 1;
+            while (headerEnd < line.length() && isdigit(line[headerEnd]))
+                headerEnd++;
+
+            if (line.length() < 3 || line[0] != '[' || headerEnd == 1 || headerEnd == line.length() || line[headerEnd] != ']')
             {
                 result = "invalid section header at line " + String(currentLine);
                 return false;
@@ -238,10 +602,15 @@ static bool parseTimerFile(File &file, String &result)
 
             log_v("current channel: %i", currentChannel);
 
+            /* a channel can have more than one section */
+            importedTimers.clear();
+            for (const auto &timer : channel[currentChannel])
+                importedTimers.push_back(timer);
+
             line = file.readStringUntil('\n');
             currentLine++;
 
-            while ((line.length() && isdigit(line[0])) || line.isEmpty())
+            while ((line.length() && (isdigit(line[0]) || line.startsWith("sun"))) || line.isEmpty())
             {
                 if (line.isEmpty())
                 {
@@ -264,7 +633,15 @@ static bool parseTimerFile(File &file, String &result)
                     return false;
                 }
 
-                const int time = line.toInt();
+                lightTimer_t timer = {};
+                if (isdigit(line[0]))
+                    timer.time = line.toInt();
+                else if (parseAnchor(line.c_str(), timer))
+                    timer.time = resolvedTime(timer, sunTimes);
+                else
+                    timer.time = -1;
+
+                const int time = timer.time;
                 if (time > MAX_SECONDS_IN_A_DAY || time < 0)
                 {
                     result = "invalid time value in line " + String(currentLine) + " parsing channel " + String(currentChannel);
@@ -279,27 +656,57 @@ static bool parseTimerFile(File &file, String &result)
                 }
 
                 auto insertPos =
-                    std::lower_bound(channel[currentChannel].begin(), channel[currentChannel].end(),
-                                     lightTimer_t{time, percentage}, [](const lightTimer_t &a, const lightTimer_t &b)
+                    std::lower_bound(importedTimers.begin(), importedTimers.end(),
+                                     timer, [](const lightTimer_t &a, const lightTimer_t &b)
                                      { return a.time < b.time; });
 
-                if (insertPos != channel[currentChannel].end() && insertPos->time == time)
+                if (importedTimers.size() >= MAX_IMPORTED_TIMERS - 1)
+                {
+                    result = "too many timers at line " + String(currentLine) + " for channel " + String(currentChannel);
+                    return false;
+                }
+
+                /* a sun timer can land on the time of another timer on some days */
+                if (insertPos != importedTimers.end() && insertPos->time == time && !timer.anchor && !insertPos->anchor)
                 {
                     result = "duplicate timer entry at line " + String(currentLine) + " for channel " + String(currentChannel) + " at time " + String(time);
                     return false;
                 }
 
                 log_v("adding timer for channel %i time: %i, percent: %i", currentChannel, time, percentage);
-                channel[currentChannel].insert(insertPos, {time, percentage});
+                timer.percentage = percentage;
+                importedTimers.insert(insertPos, timer);
 
                 line = file.readStringUntil('\n');
                 currentLine++;
                 if (line.isEmpty() && !file.available())
                     break;
             }
+
+            if (importedTimers.empty())
+                continue;
+
+            /* simplified with the closing timer in place so the last timers can join the wrap to midnight */
+            importedTimers.push_back({MAX_TIME, importedTimers.front().percentage});
+            const simplifyResult_t simplified = simplifyImportedTimers(currentChannel, TIMER_TOLERANCE_LSB);
+            importedTimers.pop_back();
+
+            removedTimers += simplified.removed;
+            maxError = max(maxError, simplified.maxError);
+
+            if (importedTimers.size() > MAX_TIMERS_PER_CHANNEL - 1)
+            {
+                result = "too many timers for channel " + String(currentChannel) + " - " + String(importedTimers.size()) +
+                         " after simplification, raise TIMER_TOLERANCE_LSB";
+                return false;
+            }
+
+            channel[currentChannel].clear();
+            for (const auto &timer : importedTimers)
+                channel[currentChannel].push_back(timer);
         }
 
-        for (int index = 0; index < NUMBER_OF_CHANNELS; index++)
+        for (int index = 0; index < channelConfig.count; index++)
             if (channel[index].size())
                 channel[index].push_back({MAX_TIME, channel[index][0].percentage});
             else
@@ -309,6 +716,8 @@ static bool parseTimerFile(File &file, String &result)
             }
     }
     result = "Timers processed";
+    if (removedTimers)
+        result.concat(" - simplified away " + String(removedTimers) + " timers, max error " + String(maxError, 1) + " PWM steps");
     return true;
 }
 
@@ -322,7 +731,11 @@ bool saveDefaultTimers(String &result)
         return false;
     }
 
-    File file = SD.open(DEFAULT_TIMERFILE, FILE_WRITE);
+    /* the editor edits the profile that runs now */
+    const char *path = *timerFileInUse ? timerFileInUse : DEFAULT_TIMERFILE;
+
+    phaseTimer storage(taskPhases.storageUs);
+    File file = SD.open(path, FILE_WRITE);
     if (!file)
     {
         result = "Could not open file";
@@ -338,22 +751,25 @@ bool saveDefaultTimers(String &result)
             return false;
         }
 
-        for (int i = 0; i < NUMBER_OF_CHANNELS; ++i)
+        for (int i = 0; i < channelConfig.count; ++i)
         {
             file.printf("[%d]\n", i); // Write channel header
             for (const auto &timer : channel[i])
-                if (timer.time != 86400)
+                if (timer.anchor)
+                    file.printf("%s%+d,%d\n", anchorName(timer), int(timer.offset), timer.percentage);
+                else if (timer.time != 86400)
                     file.printf("%d,%d\n", timer.time, timer.percentage);
         }
     }
 
     result = "Saved timers to ";
-    result.concat(DEFAULT_TIMERFILE);
+    result.concat(path);
     log_i("%s", result.c_str());
     return true;
 }
 
-bool loadDefaultTimers(String &result)
+/* day is nullptr for an upload of default.aqu - that keeps what the calendar set */
+bool loadTimerFile(const char *path, String &result, const calendarDay_t *day)
 {
     ScopedMutex lock(spiMutex, pdMS_TO_TICKS(1000));
     if (!lock.acquired())
@@ -362,16 +778,53 @@ bool loadDefaultTimers(String &result)
         return false;
     }
 
-    File file = SD.open(DEFAULT_TIMERFILE, FILE_READ);
+    phaseTimer storage(taskPhases.storageUs);
+    File file = SD.open(path, FILE_READ);
     if (!file)
     {
         result = "Could not open file";
         return false;
     }
-    const bool success = parseTimerFile(file, result);
+    const bool success = parseTimerFile(file, result, day);
+    if (success)
+        strlcpy(timerFileInUse, path, sizeof(timerFileInUse));
     return success;
 }
 
+bool loadDefaultTimers(String &result) { return loadTimerFile(DEFAULT_TIMERFILE, result, nullptr); }
+
+/* moves the sun timers to the times of sun and keeps every channel sorted - channelMutex has to be held by the caller */
+bool resolveSunTimers(const sunTimes_t &sun)
+{
+    bool moved = false;
+    for (int index = 0; index < channelConfig.count; index++)
+    {
+        timerList_t &timers = channel[index];
+        if (timers.size() < 2)
+            continue;
+
+        const size_t closing = timers.size() - 1; /* the timer at 86400 stays last */
+        for (size_t i = 0; i < closing; i++)
+        {
+            const int time = resolvedTime(timers[i], sun);
+            moved |= time != timers[i].time;
+            timers[i].time = time;
+        }
+
+        /* the order only changes when a sun timer passes another timer, so this is a few compares */
+        for (size_t i = 1; i < closing; i++)
+        {
+            const lightTimer_t timer = timers[i];
+            size_t j = i;
+            for (; j > 0 && timers[j - 1].time > timer.time; j--)
+                timers[j] = timers[j - 1];
+            timers[j] = timer;
+        }
+        timers[closing].percentage = timers[0].percentage;
+    }
+    return moved;
+}
+
 bool startSensor()
 {
     ScopedMutex lock(sensorTaskMutex);
@@ -422,11 +875,12 @@ void setup(void)
 
     log_i("aquacontrol32-pio");
 
-    SPI.begin(SCK, MISO, MOSI);
-    SPI.setHwCs(true);
-    
-    if (!SD.begin(SDCARD_SS))
-        log_e("SD init failed");
+    if (!bootEvents)
+    {
+        log_e("Failed to create boot event group! system halted!");
+        while (1)
+            delay(100);
+    }
 
     if (!sensorTaskMutex)
     {
@@ -444,6 +898,7 @@ void setup(void)
             delay(100);
     }
     xSemaphoreGive(spiMutex);
+    trackMutex(spiMutex, "spiMutex");
 
     channelMutex = xSemaphoreCreateMutex();
     if (!channelMutex)
@@ -453,31 +908,39 @@ void setup(void)
             delay(100);
     }
     xSemaphoreGive(channelMutex);
+    trackMutex(channelMutex, "channelMutex");
 
-    for (int ch = 0; ch < NUMBER_OF_CHANNELS; ch++)
-    {
-        channel[ch].push_back({0, 0});
-        channel[ch].push_back({86400, 0});
-    }
+    SPI.begin(SCK, MISO, MOSI);
+    SPI.setHwCs(true);
+
+    if (!SD.begin(SDCARD_SS))
+        log_e("SD init failed");
 
     {
         String result;
-        loadDefaultTimers(result);
+        loadChannelConfig(result);
         log_i("%s", result.c_str());
     }
 
-    log_i("ch 0: %i timers", channel[0].size());
-    log_i("ch 1: %i timers", channel[1].size());
-    log_i("ch 2: %i timers", channel[2].size());
-    log_i("ch 3: %i timers", channel[3].size());
-    log_i("ch 4: %i timers", channel[4].size());
+    for (int ch = 0; ch < channelConfig.count; ch++)
+    {
+        channel[ch].push_back({0, 0});
+        channel[ch].push_back({86400, 0});
+    }
 
+    if (!ledcSetClockSource(LEDC_USE_APB_CLK))
     {
-        String result;
-        loadMoonSettings(result);
-        log_i("%s", result.c_str());
+        log_e("could not set ledc clock source. system halted!");
+        while (1)
+            delay(100);
     }
 
+    /* every task below waits for the boot stages it depends on - see bootState.h */
+
+    if (restoreHoldoverTime())
+        bootStageReady(BOOT_TIME);
+
+    /* the network connects while the settings below are read - after the holdover time, which would overwrite an early NTP sync */
     btStop();
 
     WiFi.onEvent(WiFiEvent);
@@ -485,10 +948,12 @@ void setup(void)
 
     WiFisecrets secrets;
     String error;
-    if (loadSecretsFromSD(error, secrets))
+    const bool haveSecretsOnSD = loadSecretsFromSD(error, secrets);
+
+    if (haveSecretsOnSD)
     {
-        log_i("Using WiFi secrets from sdcard for %s", secrets.ssid.c_str());
-        WiFi.begin(secrets.ssid.c_str(), secrets.psk.c_str());
+        log_i("Using WiFi secrets from sdcard for %s", secrets.ssid);
+        WiFi.begin(secrets.ssid, secrets.psk);
     }
     else
     {
@@ -502,21 +967,20 @@ void setup(void)
 
     WiFi.setSleep(false);
 
-    if (!ledcSetClockSource(LEDC_USE_APB_CLK))
-    {
-        log_e("could not set ledc clock source. system halted!");
-        while (1)
-            delay(100);
-    }
+    if (xTaskCreate(holdoverTask, "holdoverTask", 1024 * 3, NULL, tskIDLE_PRIORITY, &holdoverTaskHandle) != pdPASS)
+        log_w("could not start holdoverTask - time will not be saved");
 
-#ifndef HEADLESS_BUILD
-    if (!lcdQueue)
-    {
-        log_e("no lcd queue. system halted!");
-        while (1)
-            delay(100);
-    }
+    if (xTaskCreate(calendarTask, "calendarTask", 1024 * 4, NULL, tskIDLE_PRIORITY, NULL) != pdPASS)
+        log_w("could not start calendarTask - only the default timers will run");
+
+    /* HTTPClient for the webhook needs the stack */
+    if (xTaskCreate(alarmTask, "alarmTask", 1024 * 6, NULL, tskIDLE_PRIORITY, NULL) != pdPASS)
+        log_w("could not start alarmTask - there will be no alarms");
 
+    startDimmerTask(); /* storage + time */
+    startHttpTask();   /* network */
+
+#ifndef HEADLESS_BUILD
     showIPonDisplay();
 
     BaseType_t result = xTaskCreatePinnedToCore(lcdTask,
@@ -539,22 +1003,48 @@ void setup(void)
         while (1)
             delay(100);
     }
-
-    messageOnLcd("Wifi connecting...");
 #endif
 
-    while (!WiFi.isConnected())
-        delay(10);
+    {
+        String result;
+        loadDefaultTimers(result);
+        log_i("%s", result.c_str());
+    }
+
+    for (int ch = 0; ch < channelConfig.count; ch++)
+        log_i("ch %i: %i timers", ch, channel[ch].size());
+
+    {
+        String result;
+        loadMoonSettings(result);
+        log_i("%s", result.c_str());
+    }
+
+    {
+        String result;
+        loadEffectSettings(result);
+        log_i("%s", result.c_str());
+    }
+
+    {
+        String result;
+        loadColorSettings(result);
+        log_i("%s", result.c_str());
+    }
+
+    {
+        String result;
+        loadThermostatSettings(result);
+        log_i("%s", result.c_str());
+    }
+
+    bootStageReady(BOOT_STORAGE);
 
 #ifndef HEADLESS_BUILD
-    showIPonDisplay();
-    messageOnLcd("Syncing clock...");
+    if (!WiFi.isConnected())
+        messageOnLcd("Wifi connecting...");
 #endif
 
-    log_i("syncing NTP");
-    sntp_set_time_sync_notification_cb((sntp_sync_time_cb_t)ntpCb);
-    configTzTime(TIMEZONE, NTP_POOL);
-
     vTaskDelete(NULL);
 }
 
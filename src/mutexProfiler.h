@@ -0,0 +1,151 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _MUTEXPROFILER_H_
+#define _MUTEXPROFILER_H_
+
+/*
+    Per call site wait/hold statistics and lock order checking for ScopedMutex.
+    Only compiled in with MUTEX_PROFILING=true - see ScopedMutex.h.
+*/
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <esp32-hal-log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include "runtimeMetrics.h"
+
+static constexpr size_t MAX_LOCK_SITES = 48;
+static constexpr size_t MAX_HELD_LOCKS = 4; /* per task */
+
+struct lockSite_t
+{
+    std::atomic<const char *> file; /* set last - a site is valid once file is set */
+    int line;
+    SemaphoreHandle_t mutex;
+    std::atomic<uint32_t> acquired;
+    std::atomic<uint32_t> timeouts;
+    std::atomic<uint32_t> waitTotalUs;
+    std::atomic<uint32_t> waitMaxUs;
+    std::atomic<uint32_t> holdTotalUs;
+    std::atomic<uint32_t> holdMaxUs;
+};
+
+extern lockSite_t lockSites[MAX_LOCK_SITES];
+extern std::atomic<uint32_t> lockSitesDropped;
+
+/* lockOrder[b] has bit a set once mutex a was held while taking mutex b - indexes into mutexMetrics[] */
+extern std::atomic<uint32_t> lockOrder[MAX_TRACKED_MUTEXES];
+extern std::atomic<uint32_t> lockOrderInversions;
+extern std::atomic<uint32_t> inversionReported[MAX_TRACKED_MUTEXES]; /* same layout as lockOrder[] */
+extern std::atomic<const lockSite_t *> lastInversionSite;
+
+extern lockSite_t *lockSiteFor(const char *file, const int line, const SemaphoreHandle_t mutex);
+
+static inline void raiseMax(std::atomic<uint32_t> &highest, const uint32_t value)
+{
+    uint32_t current = highest.load(std::memory_order_relaxed);
+    while (value > current && !highest.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        ;
+}
+
+/* __builtin_FILE() holds the full build path */
+static inline const char *fileNameOf(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static inline int trackedIndexOf(const SemaphoreHandle_t mutex)
+{
+    const mutexMetrics_t *metrics = metricsFor(mutex);
+    return metrics ? metrics - mutexMetrics : -1;
+}
+
+/* the tracked mutexes the current task holds */
+struct heldLocks_t
+{
+    int8_t index[MAX_HELD_LOCKS];
+    uint8_t count;
+};
+
+extern thread_local heldLocks_t heldLocks;
+
+/* checked before blocking so an inversion is reported even when it ends in a deadlock */
+static inline void checkLockOrder(const SemaphoreHandle_t mutex, const lockSite_t *site)
+{
+    const int taking = trackedIndexOf(mutex);
+    if (taking < 0)
+        return;
+
+    for (uint8_t i = 0; i < heldLocks.count; i++)
+    {
+        const int held = heldLocks.index[i];
+        if (held == taking)
+            continue;
+
+        if (lockOrder[held].load(std::memory_order_relaxed) & (1UL << taking))
+        {
+            lockOrderInversions.fetch_add(1, std::memory_order_relaxed);
+            if (site)
+                lastInversionSite.store(site);
+
+            /* log each pair once */
+            if (!(inversionReported[taking].fetch_or(1UL << held) & (1UL << held)))
+                log_e("lock order inversion: taking %s while holding %s at %s:%i", mutexMetrics[taking].name, mutexMetrics[held].name,
+                      site ? fileNameOf(site->file.load()) : "?", site ? site->line : 0);
+        }
+        else
+            lockOrder[taking].fetch_or(1UL << held, std::memory_order_relaxed);
+    }
+}
+
+static inline void pushHeldLock(const SemaphoreHandle_t mutex)
+{
+    const int index = trackedIndexOf(mutex);
+    if (index >= 0 && heldLocks.count < MAX_HELD_LOCKS)
+        heldLocks.index[heldLocks.count++] = index;
+}
+
+static inline void popHeldLock(const SemaphoreHandle_t mutex)
+{
+    const int index = trackedIndexOf(mutex);
+    if (index < 0)
+        return;
+
+    /* scoped locks are released in reverse order - search from the top anyway */
+    for (int i = heldLocks.count - 1; i >= 0; i--)
+        if (heldLocks.index[i] == index)
+        {
+            for (int j = i; j < heldLocks.count - 1; j++)
+                heldLocks.index[j] = heldLocks.index[j + 1];
+            heldLocks.count--;
+            return;
+        }
+}
+
+#endif
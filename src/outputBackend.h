@@ -0,0 +1,180 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _OUTPUTBACKEND_H_
+#define _OUTPUTBACKEND_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+    Where the dimmer sends its duty cycles.
+    write() may only stage a duty cycle, flush() is called once per dimmer tick to send everything staged.
+*/
+class outputBackend
+{
+public:
+    virtual ~outputBackend() = default;
+
+    /*
+        output is a gpio for LEDC and an output number on external drivers.
+        phase is where in the period the output switches on, in duty cycle steps.
+    */
+    virtual bool write(const uint8_t output, const uint32_t dutyCycle, const uint32_t phase = 0) = 0;
+    virtual bool flush() { return true; }
+};
+
+/* counts transactions and bytes so the batching of the drivers on the bus can be checked */
+class i2cBus
+{
+public:
+    virtual ~i2cBus() = default;
+
+    bool write(const uint8_t address, const uint8_t *data, const size_t length)
+    {
+        transactions++;
+        bytes += length;
+        return transfer(address, data, length);
+    }
+
+    uint32_t transactions = 0;
+    uint32_t bytes = 0;
+
+protected:
+    virtual bool transfer(const uint8_t address, const uint8_t *data, const size_t length) = 0;
+};
+
+/*
+    NXP PCA9685 16 channel 12 bit PWM driver.
+    All outputs share one frequency. Changed outputs are sent as one auto increment burst from the first to the last changed output.
+*/
+class pca9685Backend : public outputBackend
+{
+public:
+    static constexpr int OUTPUTS = 16;
+    static constexpr int BITDEPTH = 12;
+    static constexpr uint32_t MAX_DUTY = (1 << BITDEPTH) - 1;
+    static constexpr uint32_t MIN_FREQUENCY = 24;
+    static constexpr uint32_t MAX_FREQUENCY = 1526;
+
+    pca9685Backend(i2cBus &bus, const uint8_t address) : bus(bus), address(address) {}
+
+    /* all outputs start off */
+    bool begin(const uint32_t frequency)
+    {
+        const uint32_t prescale = (OSCILLATOR_HZ + 2048 * frequency) / (4096 * frequency) - 1;
+        if (prescale < 3 || prescale > 255)
+            return false;
+
+        const uint8_t sleep[] = {MODE1, MODE1_SLEEP | MODE1_AUTO_INCREMENT};
+        const uint8_t setPrescale[] = {PRE_SCALE, uint8_t(prescale)};
+        const uint8_t wake[] = {MODE1, MODE1_AUTO_INCREMENT, MODE2_TOTEM_POLE};
+
+        if (!bus.write(address, sleep, sizeof(sleep)) ||
+            !bus.write(address, setPrescale, sizeof(setPrescale)) ||
+            !bus.write(address, wake, sizeof(wake)))
+            return false;
+
+        for (int output = 0; output < OUTPUTS; output++)
+            encode(output, 0, 0);
+
+        firstChanged = 0;
+        lastChanged = OUTPUTS - 1;
+        return flush();
+    }
+
+    /* a pulse that runs past the end of the period wraps around to the start */
+    bool write(const uint8_t output, const uint32_t dutyCycle, const uint32_t phase = 0) override
+    {
+        if (output >= OUTPUTS)
+            return false;
+
+        if (!encode(output, dutyCycle > MAX_DUTY ? MAX_DUTY : dutyCycle, phase & MAX_DUTY))
+            return true;
+
+        if (output < firstChanged)
+            firstChanged = output;
+        if (output > lastChanged)
+            lastChanged = output;
+        return true;
+    }
+
+    /* unchanged outputs between the first and last changed output are resent - one transaction beats several */
+    bool flush() override
+    {
+        if (lastChanged < firstChanged)
+            return true;
+
+        uint8_t burst[1 + OUTPUTS * REGISTERS_PER_OUTPUT];
+        const size_t length = (lastChanged - firstChanged + 1) * REGISTERS_PER_OUTPUT;
+        burst[0] = LED0_ON_L + firstChanged * REGISTERS_PER_OUTPUT;
+        memcpy(burst + 1, registers[firstChanged], length);
+
+        const bool success = bus.write(address, burst, 1 + length);
+        if (success)
+        {
+            firstChanged = OUTPUTS;
+            lastChanged = -1;
+        }
+        return success;
+    }
+
+private:
+    static constexpr uint32_t OSCILLATOR_HZ = 25 * 1000 * 1000;
+    static constexpr uint8_t MODE1 = 0x00;
+    static constexpr uint8_t LED0_ON_L = 0x06;
+    static constexpr uint8_t PRE_SCALE = 0xFE;
+    static constexpr uint8_t MODE1_SLEEP = 0x10;
+    static constexpr uint8_t MODE1_AUTO_INCREMENT = 0x20;
+    static constexpr uint8_t MODE2_TOTEM_POLE = 0x04;
+    static constexpr uint8_t FULL_ON_OFF = 0x10;
+    static constexpr int REGISTERS_PER_OUTPUT = 4;
+
+    /* ON_L ON_H OFF_L OFF_H - returns false when the registers did not change */
+    bool encode(const int output, const uint32_t dutyCycle, const uint32_t phase)
+    {
+        const uint32_t off = (phase + dutyCycle) & MAX_DUTY;
+        uint8_t value[REGISTERS_PER_OUTPUT] = {uint8_t(phase), uint8_t(phase >> 8), uint8_t(off), uint8_t(off >> 8)};
+        if (dutyCycle == 0 || dutyCycle == MAX_DUTY)
+        {
+            /* the phase does not matter for a constant output */
+            memset(value, 0, sizeof(value));
+            value[dutyCycle ? 1 : 3] = FULL_ON_OFF;
+        }
+
+        if (!memcmp(registers[output], value, sizeof(value)))
+            return false;
+
+        memcpy(registers[output], value, sizeof(value));
+        return true;
+    }
+
+    i2cBus &bus;
+    const uint8_t address;
+    uint8_t registers[OUTPUTS][REGISTERS_PER_OUTPUT] = {};
+    int firstChanged = OUTPUTS;
+    int lastChanged = -1;
+};
+
+#endif
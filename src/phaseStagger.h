@@ -0,0 +1,133 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _PHASESTAGGER_H_
+#define _PHASESTAGGER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "channelConfig.h"
+
+/*
+    Channels that share a PWM period start their pulse where the previous channel in the group ended,
+    so pulses only overlap once the duty cycles of a group add up to more than one period.
+    Times are fractions of one period.
+*/
+class phaseStagger
+{
+public:
+    /* where the pulse of the next channel starts - wraps is false for outputs that cannot run a pulse past the period end */
+    float next(const float width, const bool wraps)
+    {
+        float start = edge;
+        if (!wraps && start + width > 1.0f)
+            start = width < 1.0f ? 1.0f - width : 0.0f;
+
+        hold(start, width);
+        return start;
+    }
+
+    /* a pulse that cannot move - the next channel starts where it ends */
+    void hold(const float start, const float width)
+    {
+        edge = start + width;
+        while (edge >= 1.0f)
+            edge -= 1.0f;
+    }
+
+private:
+    float edge = 0;
+};
+
+/* LEDC channels only run in step with the other channel on their timer - all PCA9685 outputs run on one oscillator */
+static inline int periodGroupOf(const channelConfig_t &config, const int index)
+{
+    return config.output[index] == OUTPUT_PCA9685 ? LEDC_CHANNEL_COUNT / 2 : config.ledcChannel[index] / 2;
+}
+
+/*
+    Where every channel switches on - phase in duty cycle steps, start and width as fractions of the period.
+    With stagger each channel starts where the previous one in its period group ended, otherwise all start at 0.
+    Channels in heldMask keep the phase they have - a running hardware fade cannot move its hpoint - and the
+    others in their group are placed after them. LEDC pulses have to end within the period, PCA9685 pulses wrap around.
+*/
+static inline void planPulses(const channelConfig_t &config, const uint32_t *dutyCycle, const uint32_t heldMask, const bool stagger,
+                              uint32_t *phase, float *start, float *width)
+{
+    phaseStagger group[LEDC_CHANNEL_COUNT / 2 + 1]; /* indexed by periodGroupOf() */
+
+    /* held pulses first so the others are placed around them */
+    for (int pass = 0; pass < 2; pass++)
+        for (int index = 0; index < config.count; index++)
+        {
+            const bool held = heldMask & (1UL << index);
+            if (held != (pass == 0))
+                continue;
+
+            const uint32_t period = config.maxDuty[index] + 1;
+            const uint32_t duty = dutyCycle[index] < period ? dutyCycle[index] : period;
+            const bool wraps = config.output[index] == OUTPUT_PCA9685;
+            phaseStagger &periodGroup = group[periodGroupOf(config, index)];
+
+            width[index] = float(duty) / period;
+            if (held)
+            {
+                start[index] = float(phase[index]) / period;
+                periodGroup.hold(start[index], width[index]);
+                continue;
+            }
+
+            start[index] = stagger ? periodGroup.next(width[index], wraps) : 0.0f;
+
+            const uint32_t steps = start[index] * period;
+            phase[index] = wraps || steps < period - duty ? steps : period - duty;
+        }
+}
+
+/* the most pulses that are high at the same moment - always at the start of one of them */
+static inline int peakOverlap(const float *start, const float *width, const size_t count)
+{
+    int peak = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (width[i] <= 0.0f)
+            continue;
+
+        int high = 0;
+        for (size_t j = 0; j < count; j++)
+        {
+            float since = start[i] - start[j];
+            if (since < 0.0f)
+                since += 1.0f;
+            if (width[j] > 0.0f && (since < width[j] || width[j] >= 1.0f))
+                high++;
+        }
+
+        if (high > peak)
+            peak = high;
+    }
+    return peak;
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _REQUESTARENA_H_
+#define _REQUESTARENA_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+    Scratch memory for one http request.
+    Allocations are handed out from a static block and all of them are released at once with reset().
+    The httpd runs one handler at a time, so one arena serves all handlers.
+*/
+class requestArena
+{
+public:
+    requestArena(uint8_t *memory, const size_t size) : memory(memory), size(size) {}
+
+    /* nullptr when the arena is full */
+    void *allocate(const size_t bytes, const size_t alignment = alignof(max_align_t))
+    {
+        const size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start + bytes > size)
+        {
+            overflows++;
+            return nullptr;
+        }
+
+        used = start + bytes;
+        if (used > highWater)
+            highWater = used;
+        return memory + start;
+    }
+
+    void reset() { used = 0; }
+
+    size_t available() const { return size - used; }
+    size_t capacity() const { return size; }
+    size_t highWaterMark() const { return highWater; }
+    uint32_t overflowCount() const { return overflows; }
+
+private:
+    uint8_t *memory;
+    const size_t size;
+    size_t used = 0;
+    size_t highWater = 0;
+    uint32_t overflows = 0;
+};
+
+/* releases everything allocated in a handler when the handler returns - after the response is sent */
+class scopedArena
+{
+public:
+    explicit scopedArena(requestArena &arena) : arena(arena) {}
+    ~scopedArena() { arena.reset(); }
+
+    scopedArena(const scopedArena &) = delete;
+    scopedArena &operator=(const scopedArena &) = delete;
+
+private:
+    requestArena &arena;
+};
+
+/* response text that takes the rest of the arena - no other allocations until the arena is reset */
+class arenaText
+{
+public:
+    explicit arenaText(requestArena &arena)
+        : capacity(arena.available()), buffer(capacity ? static_cast<char *>(arena.allocate(capacity, 1)) : nullptr)
+    {
+        if (buffer)
+            buffer[0] = 0;
+    }
+
+    bool add(const char *str) { return printf("%s", str); }
+
+    bool printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if (!buffer || length + 1 >= capacity)
+        {
+            truncated = true;
+            return false;
+        }
+
+        va_list args;
+        va_start(args, format);
+        const int written = vsnprintf(buffer + length, capacity - length, format, args);
+        va_end(args);
+
+        if (written < 0 || length + written >= capacity)
+        {
+            truncated = true;
+            length = capacity - 1;
+            return false;
+        }
+
+        length += written;
+        return true;
+    }
+
+    const char *c_str() const { return buffer ? buffer : ""; }
+    size_t size() const { return length; }
+    bool overflowed() const { return truncated; }
+
+private:
+    const size_t capacity;
+    char *buffer;
+    size_t length = 0;
+    bool truncated = false;
+};
+
+#endif
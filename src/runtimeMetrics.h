@@ -0,0 +1,147 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _RUNTIMEMETRICS_H_
+#define _RUNTIMEMETRICS_H_
+
+#include <atomic>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+
+#include "requestArena.h"
+
+/*
+    Always-on counters for /metrics.
+    Recording is a few relaxed atomic adds, so these stay enabled in production builds.
+*/
+
+/* latency histogram with fixed microsecond buckets - any task can record */
+class latencyHistogram
+{
+public:
+    static constexpr size_t BUCKETS = 9;
+    static constexpr uint32_t BOUND_US[BUCKETS] = {10, 50, 100, 500, 1000, 2000, 5000, 10000, 50000};
+
+    void record(const uint32_t us)
+    {
+        size_t index = 0;
+        while (index < BUCKETS && us > BOUND_US[index])
+            index++;
+
+        bucket[index].fetch_add(1, std::memory_order_relaxed);
+        sumUs.fetch_add(us, std::memory_order_relaxed);
+
+        uint32_t highest = maxUs.load(std::memory_order_relaxed);
+        while (us > highest && !maxUs.compare_exchange_weak(highest, us, std::memory_order_relaxed))
+            ;
+    }
+
+    /* samples in bucket index - index BUCKETS holds everything above the last bound */
+    uint32_t countIn(const size_t index) const { return bucket[index].load(std::memory_order_relaxed); }
+
+    /* wraps after 71 minutes of accumulated latency - prometheus rate() sees that as a counter reset */
+    uint32_t totalUs() const { return sumUs.load(std::memory_order_relaxed); }
+    uint32_t highestUs() const { return maxUs.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> bucket[BUCKETS + 1] = {};
+    std::atomic<uint32_t> sumUs{0};
+    std::atomic<uint32_t> maxUs{0};
+};
+
+/* prometheus histogram in seconds - labels is empty or a label list without braces */
+static inline void addHistogram(arenaText &content, const char *name, const char *labels, const latencyHistogram &histogram)
+{
+    const char *separator = *labels ? "," : "";
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < latencyHistogram::BUCKETS; i++)
+    {
+        cumulative += histogram.countIn(i);
+        content.printf("%s_seconds_bucket{%s%sle=\"%g\"} %" PRIu32 "\n", name, labels, separator, latencyHistogram::BOUND_US[i] / 1e6, cumulative);
+    }
+    cumulative += histogram.countIn(latencyHistogram::BUCKETS);
+    content.printf("%s_seconds_bucket{%s%sle=\"+Inf\"} %" PRIu32 "\n", name, labels, separator, cumulative);
+    content.printf("%s_seconds_sum{%s} %.6f\n", name, labels, histogram.totalUs() / 1e6);
+    content.printf("%s_seconds_count{%s} %" PRIu32 "\n", name, labels, cumulative);
+}
+
+/* wait times for the mutexes registered with trackMutex() - all other mutexes are not recorded */
+struct mutexMetrics_t
+{
+    const char *name;
+    std::atomic<SemaphoreHandle_t> handle;
+    latencyHistogram wait;
+    std::atomic<uint32_t> timeouts;
+};
+
+static constexpr size_t MAX_TRACKED_MUTEXES = 4;
+extern mutexMetrics_t mutexMetrics[MAX_TRACKED_MUTEXES];
+
+/* call once after creating the mutex, before other tasks use it */
+extern void trackMutex(const SemaphoreHandle_t mutex, const char *name);
+
+static inline mutexMetrics_t *metricsFor(const SemaphoreHandle_t mutex)
+{
+    for (auto &metrics : mutexMetrics)
+        if (metrics.handle.load(std::memory_order_relaxed) == mutex)
+            return &metrics;
+    return nullptr;
+}
+
+/* time the current task spent per phase - the http middleware takes the difference over one request */
+struct taskPhases_t
+{
+    uint32_t authUs;
+    uint32_t lockWaitUs; /* contended takes of tracked mutexes */
+    uint32_t storageUs;  /* SD card access */
+    uint32_t sendUs;     /* socket writes by the httpd */
+};
+
+extern thread_local taskPhases_t taskPhases;
+
+/* adds the lifetime of the timer to a phase */
+class phaseTimer
+{
+public:
+    explicit phaseTimer(uint32_t &phaseUs) : phaseUs(phaseUs), start(esp_timer_get_time()) {}
+    ~phaseTimer() { phaseUs += esp_timer_get_time() - start; }
+
+    phaseTimer(const phaseTimer &) = delete;
+    phaseTimer &operator=(const phaseTimer &) = delete;
+
+private:
+    uint32_t &phaseUs;
+    const int64_t start;
+};
+
+/* dimmerTask loop - wake interval deviation from the tick period and the time spent in one pass */
+extern latencyHistogram dimmerLoopJitter;
+extern latencyHistogram dimmerLoopDuration;
+extern std::atomic<uint32_t> dimmerLoops;
+extern std::atomic<uint32_t> dimmerOverruns;
+
+#endif
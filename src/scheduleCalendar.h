@@ -0,0 +1,158 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _SCHEDULECALENDAR_H_
+#define _SCHEDULECALENDAR_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "fixedVector.h"
+#include "lightTimer.h"
+
+static constexpr size_t MAX_CALENDAR_RULES = 16;
+static constexpr size_t MAX_PROFILE_NAME = 24;
+
+/* days since 1970-01-01 of a civil date - see http://howardhinnant.github.io/date_algorithms.html */
+static inline int32_t dayNumber(const int year, const unsigned month, const unsigned day)
+{
+    const int y = year - (month <= 2);
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = y - era * 400;
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + int32_t(doe) - 719468;
+}
+
+/* a day in the year as month * 32 + day - ordered, and the same date every year */
+static inline uint16_t monthDay(const unsigned month, const unsigned day) { return month * 32 + day; }
+
+struct calendarRule_t
+{
+    uint8_t weekdays;  /* bit 0 is sunday - 0 when the rule is a date range */
+    uint16_t fromDate; /* monthDay(), wraps past the new year when after toDate */
+    uint16_t toDate;
+    char profile[MAX_PROFILE_NAME];
+
+    bool matches(const struct tm &date) const
+    {
+        if (weekdays)
+            return weekdays & (1U << date.tm_wday);
+
+        const uint16_t today = monthDay(date.tm_mon + 1, date.tm_mday);
+        return fromDate <= toDate ? today >= fromDate && today <= toDate
+                                  : today >= fromDate || today <= toDate;
+    }
+};
+
+/*
+    Which profile runs on a date and at what intensity.
+    The first rule that matches wins, without a match the default timers run.
+*/
+struct scheduleCalendar_t
+{
+    fixedVector<calendarRule_t, MAX_CALENDAR_RULES> rule;
+    int32_t acclimationStart = 0; /* dayNumber() */
+    uint16_t acclimationDays = 0; /* 0 is no acclimation */
+    float acclimationFrom = 1;    /* scale on the first day */
+
+    /* nullptr for the default timers */
+    const char *profileFor(const struct tm &date) const
+    {
+        for (const auto &r : rule)
+            if (r.matches(date))
+                return r.profile;
+        return nullptr;
+    }
+
+    /* rises in daily steps from acclimationFrom to 1 - full intensity before the start and after the last day */
+    float scaleFor(const struct tm &date) const
+    {
+        if (!acclimationDays)
+            return 1;
+
+        const int32_t day = dayNumber(date.tm_year + 1900, date.tm_mon + 1, date.tm_mday) - acclimationStart;
+        if (day < 0 || day >= acclimationDays)
+            return 1;
+
+        return acclimationFrom + (1 - acclimationFrom) * day / acclimationDays;
+    }
+};
+
+/* set together with the timers of a profile, so the dimmer never compiles the new timers with the settings of yesterday */
+struct calendarDay_t
+{
+    float scale;
+    sunTimes_t sun;
+};
+
+/* what the calendar task applied last - for /api/calendar */
+struct calendarState_t
+{
+    char profile[MAX_PROFILE_NAME]; /* empty for the default timers */
+    float scale;
+    size_t rules;
+    time_t appliedAt;
+    int sunrise; /* seconds since local midnight */
+    int sunset;
+};
+
+static constexpr const char *WEEKDAY_NAME[7] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
+
+static inline int weekdayNumber(const char *name, const size_t length)
+{
+    for (int day = 0; day < 7; day++)
+        if (length == 3 && !strncasecmp(name, WEEKDAY_NAME[day], 3))
+            return day;
+    return -1;
+}
+
+/* 'mon-fri' or 'sat,sun' or 'fri-mon' to a weekday mask - 0 when invalid */
+static inline uint8_t parseWeekdays(const char *str)
+{
+    uint8_t mask = 0;
+    while (*str)
+    {
+        const char *end = str + strcspn(str, ",");
+        const char *dash = (const char *)memchr(str, '-', end - str);
+
+        const int from = weekdayNumber(str, (dash ? dash : end) - str);
+        const int to = dash ? weekdayNumber(dash + 1, end - dash - 1) : from;
+        if (from < 0 || to < 0)
+            return 0;
+
+        for (int day = from;; day = (day + 1) % 7)
+        {
+            mask |= 1U << day;
+            if (day == to)
+                break;
+        }
+
+        str = *end ? end + 1 : end;
+    }
+    return mask;
+}
+
+#endif
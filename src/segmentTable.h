@@ -0,0 +1,161 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _SEGMENTTABLE_H_
+#define _SEGMENTTABLE_H_
+
+#include <array>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "lightTimer.h"
+
+struct lightSegment_t
+{
+    uint32_t startMs;
+    uint32_t endMs;
+    float startPercentage;
+    float slope; /* percent per ms */
+};
+
+/*
+    Timers compiled into linear segments with the slope precomputed.
+    evaluate() keeps a cursor so sequential lookups - one every dimmer tick - are O(1).
+    levelAt() does not touch the cursor and can be used for random access.
+*/
+template <size_t CAPACITY>
+class segmentTable
+{
+public:
+    /* TIMER is anything with a time in seconds and a percentage - lightTimer_t or a resolved colorLevel_t */
+    template <typename TIMER>
+    bool compile(const TIMER *timer, const size_t numberOfTimers, const float scale = 1.0f)
+    {
+        count = 0;
+        cursor = 0;
+
+        if (!numberOfTimers)
+            return false;
+
+        if (numberOfTimers == 1)
+        {
+            setConstant(timer[0].percentage * scale);
+            return true;
+        }
+
+        if (numberOfTimers - 1 > CAPACITY)
+            return false;
+
+        for (size_t i = 1; i < numberOfTimers; i++)
+        {
+            const uint32_t startMs = timer[i - 1].time * 1000U;
+            const uint32_t endMs = timer[i].time * 1000U;
+            const float startPercentage = timer[i - 1].percentage * scale;
+            const float endPercentage = timer[i].percentage * scale;
+
+            segment[count++] = {startMs, endMs, startPercentage,
+                                endMs > startMs ? (endPercentage - startPercentage) / (endMs - startMs) : 0.0f};
+        }
+        return true;
+    }
+
+    void setConstant(const float percentage)
+    {
+        segment[0] = {0, UINT32_MAX, percentage, 0.0f};
+        count = 1;
+        cursor = 0;
+    }
+
+    float evaluate(const uint32_t ms)
+    {
+        if (!count)
+            return 0;
+
+        if (ms < segment[cursor].startMs)
+            cursor = 0; /* time wrapped - midnight or a restarted scene */
+
+        while (ms >= segment[cursor].endMs && cursor < count - 1)
+            cursor++;
+
+        return valueOf(segment[cursor], ms);
+    }
+
+    float levelAt(const uint32_t ms) const
+    {
+        if (!count)
+            return 0;
+
+        size_t low = 0;
+        size_t high = count - 1;
+        while (low < high)
+        {
+            const size_t mid = (low + high) / 2;
+            if (ms >= segment[mid].endMs)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return valueOf(segment[low], ms);
+    }
+
+    /* count levels from fromMs on every stepMs - a walk with its own cursor, so it can run next to the dimmer's evaluate() */
+    void sample(const uint32_t fromMs, const uint32_t stepMs, const size_t numberOfSamples, float *level) const
+    {
+        size_t position = 0;
+        uint32_t ms = fromMs;
+        for (size_t i = 0; i < numberOfSamples; i++, ms += stepMs)
+        {
+            if (!count)
+            {
+                level[i] = 0;
+                continue;
+            }
+
+            while (ms >= segment[position].endMs && position < count - 1u)
+                position++;
+
+            level[i] = valueOf(segment[position], ms);
+        }
+    }
+
+    /* end of the segment active at the last evaluate() */
+    uint32_t currentSegmentEndMs() const { return count ? segment[cursor].endMs : UINT32_MAX; }
+
+    size_t size() const { return count; }
+
+private:
+    static inline float valueOf(const lightSegment_t &seg, const uint32_t ms)
+    {
+        if (ms <= seg.startMs)
+            return seg.startPercentage;
+
+        const uint32_t elapsed = (ms < seg.endMs ? ms : seg.endMs) - seg.startMs;
+        return seg.startPercentage + seg.slope * elapsed;
+    }
+
+    std::array<lightSegment_t, CAPACITY> segment;
+    uint16_t count = 0;
+    uint16_t cursor = 0;
+};
+
+#endif
@@ -28,21 +28,101 @@ static void updateDisplay(float temperatureC)
     lcdMessage_t msg;
     msg.type = TEMPERATURE;
     msg.float1 = temperatureC;
-    xQueueSend(lcdQueue, &msg, portMAX_DELAY);
+    sensorToLcd.push(msg);
+}
+
+static temperatureFilter filter;
+static sampleInterval interval;
+
+/* the filtered temperature - DEVICE_DISCONNECTED_C when there is none or the sensor is given up */
+static void publishTemperature(const bool givenUp)
+{
+    const bool valid = !givenUp && filter.hasValue();
+    sensorState.publish({valid ? filter.updatedUs() : esp_timer_get_time(), valid ? filter.value() : DEVICE_DISCONNECTED_C, valid,
+                         filter.raw(), filter.rate(), filter.quality(), interval.current()});
+}
+
+/* °C to the nearest temperature an alarm or a hysteresis thermostat switches at - readings are taken faster around those */
+static float distanceToWatched(const float temperatureC)
+{
+    float distance = INFINITY;
+
+    const temperatureLimits_t limits = temperatureLimits.read();
+    for (size_t i = 0; i < limits.count; i++)
+        distance = fminf(distance, fabsf(temperatureC - limits.value[i]));
+
+    thermostatConfig_t config;
+    thermostatConfig.read(config);
+    if (config.mode == THERMOSTAT_HYSTERESIS)
+        distance = fminf(distance, fabsf(fabsf(temperatureC - config.setpoint) - config.hysteresis / 2));
+
+    return distance;
 }
 
 static void updateWebsocket(const float temp)
 {
     websocketMessage msg;
     msg.type = TEMPERATURE_UPDATE;
-    snprintf(msg.str, sizeof(msg.str), "TEMPERATURE\n%f\n", temp);
-    xQueueSend(websocketQueue, &msg, portMAX_DELAY);
+    msg.count = 1;
+    msg.value[0] = temp;
+    sensorToWebsocket.push(msg);
+}
+
+#if defined(THERMOSTAT_PIN)
+static void driveThermostatPin(const thermostatOutput output, const float level)
+{
+    static bool pwmAttached = false;
+
+    if (output == THERMOSTAT_PWM)
+    {
+        if (!pwmAttached)
+        {
+            waitForBootStages(bootBit(BOOT_DIMMER)); /* the LED channels have their fixed LEDC channels - this takes a free one */
+            pwmAttached = ledcAttach(THERMOSTAT_PIN, THERMOSTAT_PWM_FREQUENCY, THERMOSTAT_PWM_BITDEPTH);
+            if (!pwmAttached)
+                log_e("Could not attach thermostat pin %i to LEDC", THERMOSTAT_PIN);
+        }
+        if (pwmAttached)
+            ledcWrite(THERMOSTAT_PIN, lroundf(level * ((1UL << THERMOSTAT_PWM_BITDEPTH) - 1)));
+        return;
+    }
+
+    if (pwmAttached)
+    {
+        ledcDetach(THERMOSTAT_PIN);
+        pinMode(THERMOSTAT_PIN, OUTPUT);
+        pwmAttached = false;
+    }
+    digitalWrite(THERMOSTAT_PIN, level > 0.5f ? HIGH : LOW);
+}
+#endif
+
+/* on every conversion and when the sensor is given up - from the temperature that was just published */
+static void runThermostat()
+{
+    static thermostat_t thermostat;
+
+    thermostatConfig_t config;
+    thermostatConfig.read(config);
+    const sensorState_t sensor = sensorState.read();
+
+    const float output = thermostat.update(config, sensor.temperature, sensor.valid, millis());
+#if defined(THERMOSTAT_PIN)
+    driveThermostatPin(config.output, output);
+#endif
+
+    thermostatState.publish({esp_timer_get_time(), sensor.temperature, thermostat.demand(), output, thermostat.integral(), thermostat.failsafe()});
 }
 
 void sensorTask(void *parameter)
 {
     pinMode(ONE_WIRE_PIN, INPUT_PULLUP);
 
+#if defined(THERMOSTAT_PIN)
+    pinMode(THERMOSTAT_PIN, OUTPUT);
+    digitalWrite(THERMOSTAT_PIN, LOW);
+#endif
+
     OneWire oneWire(ONE_WIRE_PIN);
     DallasTemperature sensor(&oneWire);
 
@@ -50,12 +130,15 @@ void sensorTask(void *parameter)
     int errorCount = 0;
 
     sensor.begin();
+    bootStageReady(BOOT_SENSOR);
 
     for (;;)
     {
         DeviceAddress sensorAddress;
         if (!sensor.getAddress(sensorAddress, 0))
         {
+            publishTemperature(true);
+            runThermostat();
             updateDisplay(DEVICE_DISCONNECTED_C);
             log_i("No DS18B20 sensor found. Suspending task.");
             vTaskSuspend(NULL);
@@ -63,21 +146,31 @@ void sensorTask(void *parameter)
         }
 
         sensor.setResolution(sensorAddress, 12);
+        /* requestTemperatures() would wait for the conversion and then the task waited again - now only the task waits */
+        sensor.setWaitForConversion(false);
+        const uint32_t conversionMs = sensor.millisToWaitForConversion(12);
+        filter.reset();
         errorCount = 0;
 
         while (1)
         {
+            TickType_t wakeTime = xTaskGetTickCount();
+
             sensor.requestTemperatures();
-            vTaskDelay(pdMS_TO_TICKS(750));
+            vTaskDelay(pdMS_TO_TICKS(conversionMs));
 
-            float temperatureC = sensor.getTempC(sensorAddress);
+            const float rawC = sensor.getTempC(sensorAddress);
+            const bool accepted = filter.add(rawC, esp_timer_get_time());
+            interval.next(filter, distanceToWatched(filter.value()));
 
-            if (temperatureC == DEVICE_DISCONNECTED_C)
+            if (!accepted)
             {
-                log_w("Sensor disconnected or error reading temperature.");
+                log_w("Sensor disconnected or glitch reading temperature: %.2f", rawC);
 
                 if (++errorCount >= MAX_ERROR_COUNT)
                 {
+                    publishTemperature(true);
+                    runThermostat(); /* failsafe */
                     updateDisplay(DEVICE_DISCONNECTED_C);
                     updateWebsocket(DEVICE_DISCONNECTED_C);
 
@@ -85,11 +178,16 @@ void sensorTask(void *parameter)
                     vTaskSuspend(NULL);
                     break; // break inner loop to re-init on resume
                 }
+
+                publishTemperature(false); /* the last good value, flagged as held */
             }
             else
             {
                 errorCount = 0;
+                publishTemperature(false);
+                runThermostat();
 
+                const float temperatureC = filter.value();
                 if (fabs(temperatureC - lastTemperatureC) > TEMPERATURE_THRESHOLD)
                 {
                     updateDisplay(temperatureC);
@@ -97,6 +195,8 @@ void sensorTask(void *parameter)
                     lastTemperatureC = temperatureC;
                 }
             }
+
+            vTaskDelayUntil(&wakeTime, pdMS_TO_TICKS(interval.current()));
         }
     }
 }
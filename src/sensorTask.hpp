@@ -29,12 +29,27 @@ SOFTWARE.
 
 #include "lcdMessage.h"
 #include "websocketMessage.h"
+#include "bootState.h"
+#include "stateBoard.h"
+#include "thermostat.h"
+#include "temperatureFilter.h"
+#include "alarmEngine.h"
 
 static constexpr float TEMPERATURE_THRESHOLD = (0.05f);
 static constexpr int MAX_ERROR_COUNT = 10;
 
-extern QueueHandle_t lcdQueue;
-extern QueueHandle_t websocketQueue;
+extern lcdRing_t sensorToLcd;
+extern websocketRing_t sensorToWebsocket;
 extern bool sensorTaskRunning;
+extern seqlock<temperatureLimits_t> temperatureLimits;
+
+seqlock<sensorState_t> sensorState;
+seqlock<thermostatConfig_t> thermostatConfig; /* published by loadThermostatSettings() with spiMutex held */
+seqlock<thermostatState_t> thermostatState;
+
+#if defined(THERMOSTAT_PIN)
+static constexpr uint32_t THERMOSTAT_PWM_FREQUENCY = 1000;
+static constexpr uint8_t THERMOSTAT_PWM_BITDEPTH = 10;
+#endif
 
 #endif
@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _SOLAREVENTS_H_
+#define _SOLAREVENTS_H_
+
+#include <math.h>
+#include <stdint.h>
+
+/*
+    Sunrise and sunset after the NOAA solar calculator - accurate to about a minute between the polar circles.
+    In double precision, which the ESP32 does in software - this runs once a day, never in the dimmer tick.
+*/
+
+enum solarDayType : uint8_t
+{
+    SUN_RISES_AND_SETS,
+    SUN_ALWAYS_UP,
+    SUN_ALWAYS_DOWN
+};
+
+struct solarDay_t
+{
+    double sunriseMin; /* minutes after 00:00 UTC of the date - can be below 0 or past 1440 far from the time zone meridian */
+    double sunsetMin;
+    solarDayType type;
+};
+
+namespace solar
+{
+    static constexpr double RAD = M_PI / 180;
+
+    /* the hour angle of sunrise in degrees and the equation of time in minutes at jd */
+    static inline double hourAngle(const double jd, const double latitude, double &equationOfTime, solarDayType &type)
+    {
+        const double jc = (jd - 2451545.0) / 36525.0;
+
+        const double meanLong = fmod(280.46646 + jc * (36000.76983 + jc * 0.0003032), 360);
+        const double meanAnomaly = 357.52911 + jc * (35999.05029 - 0.0001537 * jc);
+        const double eccentricity = 0.016708634 - jc * (0.000042037 + 0.0000001267 * jc);
+        const double center = sin(meanAnomaly * RAD) * (1.914602 - jc * (0.004817 + 0.000014 * jc)) +
+                              sin(2 * meanAnomaly * RAD) * (0.019993 - 0.000101 * jc) + sin(3 * meanAnomaly * RAD) * 0.000289;
+        const double omega = (125.04 - 1934.136 * jc) * RAD;
+        const double apparentLong = meanLong + center - 0.00569 - 0.00478 * sin(omega);
+        const double meanObliquity = 23 + (26 + (21.448 - jc * (46.815 + jc * (0.00059 - jc * 0.001813))) / 60) / 60;
+        const double obliquity = meanObliquity + 0.00256 * cos(omega);
+        const double declination = asin(sin(obliquity * RAD) * sin(apparentLong * RAD));
+
+        const double y = tan(obliquity * RAD / 2) * tan(obliquity * RAD / 2);
+        const double L = meanLong * RAD;
+        const double M = meanAnomaly * RAD;
+        equationOfTime = 4 / RAD * (y * sin(2 * L) - 2 * eccentricity * sin(M) + 4 * eccentricity * y * sin(M) * cos(2 * L) -
+                                    0.5 * y * y * sin(4 * L) - 1.25 * eccentricity * eccentricity * sin(2 * M));
+
+        /* 90.833 degrees - the refraction at the horizon and the radius of the sun */
+        const double cosHourAngle = cos(90.833 * RAD) / (cos(latitude * RAD) * cos(declination)) - tan(latitude * RAD) * tan(declination);
+        type = cosHourAngle > 1 ? SUN_ALWAYS_DOWN : cosHourAngle < -1 ? SUN_ALWAYS_UP
+                                                                      : SUN_RISES_AND_SETS;
+        return type == SUN_RISES_AND_SETS ? acos(cosHourAngle) / RAD : type == SUN_ALWAYS_UP ? 180 : 0;
+    }
+
+    /* rising is -1, setting +1 - a second pass at the time of the event itself */
+    static inline double eventMinutes(const double jdMidnight, const double latitude, const double longitude, const int sign, solarDayType &type)
+    {
+        double minutes = 720;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            double equationOfTime;
+            const double angle = hourAngle(jdMidnight + minutes / 1440, latitude, equationOfTime, type);
+            minutes = 720 - 4 * longitude - equationOfTime + sign * 4 * angle;
+        }
+        return minutes;
+    }
+}
+
+/* latitude north and longitude east are positive */
+static inline solarDay_t solarEvents(const int32_t dayNumber, const double latitude, const double longitude)
+{
+    const double jdMidnight = dayNumber + 2440587.5; /* days since 1970-01-01 to julian day */
+
+    solarDay_t day;
+    solarDayType setType;
+    day.sunriseMin = solar::eventMinutes(jdMidnight, latitude, longitude, -1, day.type);
+    day.sunsetMin = solar::eventMinutes(jdMidnight, latitude, longitude, 1, setType);
+    if (day.type != setType) /* on the edge of a polar day - take the day as it is at noon */
+        day.type = setType;
+    return day;
+}
+
+/*
+    Sunrise and sunset in seconds since local midnight - localMidnight is the epoch time of that midnight.
+    A polar day runs from midnight to midnight, a polar night has both at solar noon.
+*/
+static inline void localSolarTimes(const solarDay_t &sun, const int32_t dayNumber, const int64_t localMidnight, int &sunrise, int &sunset)
+{
+    if (sun.type == SUN_ALWAYS_UP)
+    {
+        sunrise = 0;
+        sunset = 86399;
+        return;
+    }
+    const int64_t utcMidnight = int64_t(dayNumber) * 86400;
+    auto secondsOf = [&](const double minutes)
+    {
+        const int64_t seconds = utcMidnight + llround(minutes * 60) - localMidnight;
+        return int(seconds < 0 ? 0 : seconds > 86399 ? 86399 : seconds);
+    };
+    sunrise = secondsOf(sun.sunriseMin);
+    sunset = secondsOf(sun.sunsetMin);
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _SPSCRING_H_
+#define _SPSCRING_H_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/*
+    Lock free ring for exactly one producer and one consumer task.
+    The consumer is woken with a task notification when the ring goes from empty to not empty,
+    so a consumer can wait on ulTaskNotifyTake() for several rings at once.
+*/
+template <typename T, size_t CAPACITY>
+class spscRing
+{
+    static_assert(CAPACITY && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY has to be a power of two");
+
+public:
+    static constexpr size_t CACHE_LINE = 32;
+
+    /* called by the consumer before it starts waiting */
+    void setConsumer(const TaskHandle_t task) { consumer.store(task); }
+
+    /* producer side - returns false when the ring is full */
+    bool push(const T &item)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        const uint32_t depth = h - tail.load(std::memory_order_acquire);
+        if (depth == CAPACITY)
+        {
+            dropped++;
+            return false;
+        }
+
+        if (depth + 1 > highWater)
+            highWater = depth + 1;
+
+        slot[h & (CAPACITY - 1)] = item;
+        head.store(h + 1); /* seq_cst - pairs with the tail reload below and the head load in pop() */
+
+        /* the consumer has taken everything before this item so it might be waiting */
+        const TaskHandle_t task = consumer.load(std::memory_order_relaxed);
+        if (tail.load() == h && task)
+            xTaskNotifyGive(task);
+
+        return true;
+    }
+
+    /* consumer side - returns false when the ring is empty */
+    bool pop(T &item)
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load() == t)
+            return false;
+
+        item = slot[t & (CAPACITY - 1)];
+        tail.store(t + 1);
+        return true;
+    }
+
+    size_t size() const { return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed); }
+    uint32_t droppedItems() const { return dropped; }
+    uint32_t highWaterMark() const { return highWater; }
+    static constexpr size_t capacity() { return CAPACITY; }
+
+private:
+    alignas(CACHE_LINE) std::atomic<uint32_t> head{0};
+    uint32_t dropped = 0;   /* only written by the producer */
+    uint32_t highWater = 0; /* only written by the producer */
+    alignas(CACHE_LINE) std::atomic<uint32_t> tail{0};
+    std::atomic<TaskHandle_t> consumer{nullptr};
+    alignas(CACHE_LINE) T slot[CAPACITY];
+};
+
+#endif
@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _STATEBOARD_H_
+#define _STATEBOARD_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "channelConfig.h"
+
+/*
+    Latest value of T for one writer task and any number of readers, without locks.
+    A reader copies the value and retries when the writer was busy or finished a write in the meantime.
+*/
+template <typename T>
+class seqlock
+{
+public:
+    void publish(const T &value)
+    {
+        const uint32_t s = sequence.load(std::memory_order_relaxed);
+        sequence.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&data, &value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_release);
+        sequence.store(s + 2, std::memory_order_release);
+    }
+
+    T read() const
+    {
+        T copy;
+        read(copy);
+        return copy;
+    }
+
+    /* for large snapshots that should not live on the stack of the reader */
+    void read(T &copy) const
+    {
+        int attempts = 0;
+        while (1)
+        {
+            const uint32_t before = sequence.load(std::memory_order_acquire);
+            if (!(before & 1))
+            {
+                memcpy(&copy, &data, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == before)
+                    return;
+            }
+
+            /* a lower priority writer might be preempted halfway - let it finish */
+            if (++attempts % 8 == 0)
+                vTaskDelay(1);
+        }
+    }
+
+private:
+    std::atomic<uint32_t> sequence{0};
+    T data{};
+};
+
+/* published by dimmerTask every tick */
+struct lightState_t
+{
+    int64_t updatedUs;
+    time_t time;
+    uint32_t scheduleVersion;
+    float moonFraction;
+    uint8_t count;
+    float level[MAX_CHANNELS];
+    float pulseStart[MAX_CHANNELS]; /* fractions of a PWM period */
+    float pulseWidth[MAX_CHANNELS];
+};
+
+/* published by sensorTask after every reading */
+struct sensorState_t
+{
+    int64_t updatedUs; /* when the reading behind temperature was taken */
+    float temperature; /* filtered */
+    bool valid;
+    float raw;           /* the last reading as the sensor gave it */
+    float rate;          /* °C per minute */
+    uint8_t quality;     /* sensorQuality flags */
+    uint32_t intervalMs; /* until the next reading */
+};
+
+#endif
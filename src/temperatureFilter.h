@@ -0,0 +1,165 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _TEMPERATUREFILTER_H_
+#define _TEMPERATUREFILTER_H_
+
+#include <math.h>
+#include <stdint.h>
+
+enum sensorQuality : uint8_t
+{
+    QUALITY_WARMUP = 1 << 0,  /* fewer readings than the median window so far */
+    QUALITY_HELD = 1 << 1,    /* the last reading was a glitch - the temperature is from the one before */
+    QUALITY_OUTLIER = 1 << 2, /* the last reading was far off its neighbours and was voted out by the median */
+};
+
+/*
+    Median of the last MEDIAN_WINDOW readings against single spikes, then a one dimensional Kalman filter.
+    The Kalman filter weighs a reading by the time since the previous one, so it keeps working when the sampling interval changes.
+    DEVICE_DISCONNECTED_C, readings out of the DS18B20 range and the 85°C power-on value are rejected before the median.
+*/
+class temperatureFilter
+{
+public:
+    static constexpr int MEDIAN_WINDOW = 5;
+
+    void reset()
+    {
+        count = 0;
+        head = 0;
+        flags = QUALITY_WARMUP;
+        ratePerMinute = 0;
+    }
+
+    /* false when raw is a glitch - the estimate stays as it was */
+    bool add(const float raw, const int64_t nowUs)
+    {
+        lastRaw = raw;
+        const bool resetValue = raw == POWER_ON_VALUE && (!count || fabsf(estimate - POWER_ON_VALUE) > 1);
+        if (raw < MIN_VALID || raw > MAX_VALID || resetValue)
+        {
+            flags |= QUALITY_HELD;
+            return false;
+        }
+
+        window[head] = raw;
+        head = (head + 1) % MEDIAN_WINDOW;
+        if (count < MEDIAN_WINDOW)
+            count++;
+
+        const float median = medianOfWindow();
+        flags = (count < MEDIAN_WINDOW ? QUALITY_WARMUP : 0) | (fabsf(raw - median) > OUTLIER_C ? QUALITY_OUTLIER : 0);
+
+        if (count == 1)
+        {
+            estimate = median;
+            variance = MEASUREMENT_VARIANCE;
+        }
+        else
+        {
+            const float dt = (nowUs - sampledUs) / 1e6f;
+            const float previous = estimate;
+
+            variance += PROCESS_VARIANCE_PER_SECOND * dt;
+            const float gain = variance / (variance + MEASUREMENT_VARIANCE);
+            estimate += gain * (median - estimate);
+            variance *= 1 - gain;
+
+            if (dt > 0)
+                ratePerMinute += ((estimate - previous) / dt * 60 - ratePerMinute) * RATE_SMOOTHING;
+        }
+
+        sampledUs = nowUs;
+        return true;
+    }
+
+    bool hasValue() const { return count > 0; }
+    float value() const { return estimate; }
+    float raw() const { return lastRaw; }
+    float rate() const { return ratePerMinute; } /* °C per minute */
+    uint8_t quality() const { return flags; }
+    int64_t updatedUs() const { return sampledUs; } /* when the last good reading was taken */
+
+private:
+    static constexpr float MIN_VALID = -55;
+    static constexpr float MAX_VALID = 125;
+    static constexpr float POWER_ON_VALUE = 85;
+    static constexpr float OUTLIER_C = 0.5f;
+    static constexpr float MEASUREMENT_VARIANCE = 0.05f * 0.05f;      /* °C² - noise and the 1/16°C steps of a 12 bit conversion */
+    static constexpr float PROCESS_VARIANCE_PER_SECOND = 0.01f * 0.01f; /* °C² - how fast a tank of water can really change */
+    static constexpr float RATE_SMOOTHING = 0.2f;
+
+    float window[MEDIAN_WINDOW];
+    int count = 0;
+    int head = 0;
+    float estimate = 0;
+    float variance = 0;
+    float ratePerMinute = 0;
+    float lastRaw = 0;
+    int64_t sampledUs = 0;
+    uint8_t flags = QUALITY_WARMUP;
+
+    float medianOfWindow() const
+    {
+        float sorted[MEDIAN_WINDOW];
+        for (int i = 0; i < count; i++)
+        {
+            int j = i;
+            for (; j > 0 && sorted[j - 1] > window[i]; j--)
+                sorted[j] = sorted[j - 1];
+            sorted[j] = window[i];
+        }
+        return count & 1 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    }
+};
+
+/*
+    The time until the next conversion - doubles every reading while the temperature is steady
+    and far from the temperatures that matter, back to the shortest on a change or a doubtful reading.
+*/
+class sampleInterval
+{
+public:
+    static constexpr uint32_t MIN_MS = 1000;
+    static constexpr uint32_t MAX_MS = 16000;
+
+    /* distance in °C to the nearest temperature something acts on - INFINITY when there is none */
+    uint32_t next(const temperatureFilter &filter, const float distance)
+    {
+        const bool busy = fabsf(filter.rate()) > CHANGING_PER_MINUTE || distance < NEAR_C ||
+                          (filter.quality() & (QUALITY_WARMUP | QUALITY_HELD | QUALITY_OUTLIER));
+        intervalMs = busy ? MIN_MS : intervalMs * 2 < MAX_MS ? intervalMs * 2 : MAX_MS;
+        return intervalMs;
+    }
+
+    uint32_t current() const { return intervalMs; }
+
+private:
+    static constexpr float CHANGING_PER_MINUTE = 0.05f;
+    static constexpr float NEAR_C = 0.1f;
+
+    uint32_t intervalMs = MIN_MS;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _THERMOSTAT_H_
+#define _THERMOSTAT_H_
+
+#include <stdint.h>
+
+enum thermostatMode : uint8_t
+{
+    THERMOSTAT_OFF,
+    THERMOSTAT_HYSTERESIS,
+    THERMOSTAT_PID
+};
+
+enum thermostatOutput : uint8_t
+{
+    THERMOSTAT_RELAY,
+    THERMOSTAT_PWM
+};
+
+static constexpr const char *THERMOSTAT_MODE_NAME[] = {"off", "hysteresis", "pid"};
+static constexpr const char *THERMOSTAT_OUTPUT_NAME[] = {"relay", "pwm"};
+
+/* loaded from THERMOSTAT_FILE - a new version resets the controller */
+struct thermostatConfig_t
+{
+    uint32_t version;
+    thermostatMode mode;
+    thermostatOutput output;
+    bool cooling;       /* a chiller - the output rises with the temperature */
+    float setpoint;     /* °C */
+    float hysteresis;   /* °C, the whole band around the setpoint */
+    float kp;           /* output per °C */
+    float ki;           /* output per °C per second */
+    float kd;           /* output per °C per second of change */
+    uint32_t windowMs;  /* a relay in pid mode is on for a part of every window */
+    uint32_t minOnMs;   /* a relay stays on at least this long */
+    uint32_t minOffMs;  /* and off */
+    float failsafe;     /* output 0-1 while there is no temperature */
+};
+
+static constexpr thermostatConfig_t DEFAULT_THERMOSTAT = {0, THERMOSTAT_OFF, THERMOSTAT_RELAY, false, 25, 0.4f, 2, 0.001f, 0, 600000, 60000, 60000, 0};
+
+/* published by sensorTask after every conversion */
+struct thermostatState_t
+{
+    int64_t updatedUs;
+    float temperature;
+    float demand;   /* what the controller asks, 0-1 */
+    float output;   /* what the pin does - 0 or 1 on a relay */
+    float integral; /* the part of demand from the integral term */
+    bool failsafe;
+};
+
+/*
+    Hysteresis or PID on one temperature reading at a time, for a heater or a chiller.
+    The integral only grows while the output is not saturated in the same direction, so it does not wind up
+    while the heater is on full power after a water change.
+    A relay switches at most every minOnMs / minOffMs, except to enter the failsafe or when the thermostat is switched off.
+*/
+class thermostat_t
+{
+public:
+    /* the output for a reading at nowMs - valid is false when the sensor failed for good */
+    float update(const thermostatConfig_t &config, const float temperature, const bool valid, const uint32_t nowMs)
+    {
+        if (config.version != active.version)
+        {
+            active = config;
+            integralTerm = 0;
+            primed = false;
+            windowStartMs = nowMs;
+        }
+
+        inFailsafe = active.mode != THERMOSTAT_OFF && !valid;
+
+        if (active.mode == THERMOSTAT_OFF)
+            demandLevel = 0;
+        else if (inFailsafe)
+        {
+            demandLevel = active.failsafe;
+            integralTerm = 0;
+            primed = false;
+        }
+        else if (active.mode == THERMOSTAT_HYSTERESIS)
+            demandLevel = hysteresis(temperature);
+        else
+            demandLevel = pid(temperature, nowMs);
+
+        return drive(nowMs, active.mode == THERMOSTAT_OFF || inFailsafe);
+    }
+
+    float demand() const { return demandLevel; }
+    float output() const { return outputLevel; }
+    float integral() const { return integralTerm; }
+    bool failsafe() const { return inFailsafe; }
+
+private:
+    thermostatConfig_t active = DEFAULT_THERMOSTAT;
+    float demandLevel = 0;
+    float outputLevel = 0;
+    float integralTerm = 0;
+    float lastTemperature = 0;
+    uint32_t lastMs = 0;
+    uint32_t windowStartMs = 0;
+    uint32_t switchedMs = 0;
+    bool primed = false;
+    bool relayOn = false;
+    bool inFailsafe = false;
+
+    static float clamped(const float value) { return value < 0 ? 0 : value > 1 ? 1 : value; }
+
+    /* positive when the heater - or the chiller - should work */
+    float errorOf(const float temperature) const { return active.cooling ? temperature - active.setpoint : active.setpoint - temperature; }
+
+    float hysteresis(const float temperature) const
+    {
+        const float error = errorOf(temperature);
+        if (error > active.hysteresis / 2)
+            return 1;
+        if (error < -active.hysteresis / 2)
+            return 0;
+        return demandLevel; /* inside the band */
+    }
+
+    float pid(const float temperature, const uint32_t nowMs)
+    {
+        const float error = errorOf(temperature);
+        const float dt = primed ? (nowMs - lastMs) / 1000.0f : 0;
+
+        /* on the measurement, so a new setpoint does not kick the output */
+        const float change = dt > 0 ? (active.cooling ? temperature - lastTemperature : lastTemperature - temperature) / dt : 0;
+
+        lastTemperature = temperature;
+        lastMs = nowMs;
+        primed = true;
+
+        const float proportional = active.kp * error;
+        const float derivative = active.kd * change;
+        const float candidate = integralTerm + active.ki * error * dt;
+        const float unclamped = proportional + candidate + derivative;
+        if ((unclamped < 1 || error < 0) && (unclamped > 0 || error > 0))
+            integralTerm = clamped(candidate);
+
+        return clamped(proportional + integralTerm + derivative);
+    }
+
+    float drive(const uint32_t nowMs, const bool immediate)
+    {
+        if (active.output == THERMOSTAT_PWM)
+            return outputLevel = demandLevel;
+
+        bool wanted;
+        if (active.mode == THERMOSTAT_PID && !immediate)
+        {
+            /* time proportioning - on for demand of every window */
+            if (nowMs - windowStartMs >= active.windowMs)
+                windowStartMs = nowMs;
+            wanted = nowMs - windowStartMs < demandLevel * active.windowMs;
+        }
+        else
+            wanted = demandLevel >= 0.5f;
+
+        if (wanted != relayOn && (immediate || nowMs - switchedMs >= (relayOn ? active.minOnMs : active.minOffMs)))
+        {
+            relayOn = wanted;
+            switchedMs = nowMs;
+        }
+        return outputLevel = relayOn ? 1 : 0;
+    }
+};
+
+#endif
@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _TIMERSIMPLIFIER_H_
+#define _TIMERSIMPLIFIER_H_
+
+#include <math.h>
+#include <stddef.h>
+
+#include "lightTimer.h"
+
+static constexpr size_t MAX_IMPORTED_TIMERS = 1024; /* per channel before simplification, including the closing timer */
+
+using importList_t = fixedVector<lightTimer_t, MAX_IMPORTED_TIMERS>;
+
+struct simplifyResult_t
+{
+    size_t removed;
+    float maxError; /* PWM steps */
+};
+
+/*
+    Ramer-Douglas-Peucker on a sorted timer list, without recursion.
+    A timer is removed when the line between the timers that are kept around it passes within tolerance of it.
+    The error is measured in PWM steps on the curve of the channel, so dutyOf() maps a percentage to an unrounded duty cycle.
+    The first and the last timer and the timers anchored to the sun are always kept.
+*/
+template <size_t CAPACITY>
+class timerSimplifier
+{
+public:
+    template <typename DUTY>
+    simplifyResult_t simplify(fixedVector<lightTimer_t, CAPACITY> &timer, const float tolerance, DUTY dutyOf)
+    {
+        const size_t count = timer.size();
+        if (count < 3)
+            return {0, 0};
+
+        for (size_t i = 0; i < count; i++)
+            keep[i] = i == 0 || i == count - 1 || timer[i].anchor; /* sun timers move every day */
+
+        /* every pass splits each span at its worst timer - a pass per level of the recursion */
+        bool split = true;
+        while (split)
+        {
+            split = false;
+            for (size_t first = 0; first < count - 1;)
+            {
+                size_t last = first + 1;
+                while (!keep[last])
+                    last++;
+
+                float worst;
+                const size_t at = worstBetween(timer, first, last, dutyOf, worst);
+                if (at && worst > tolerance + ON_THE_LINE)
+                {
+                    keep[at] = true;
+                    split = true;
+                }
+                first = last;
+            }
+        }
+
+        simplifyResult_t result = {0, 0};
+        for (size_t first = 0, last = 1; last < count; last++)
+        {
+            if (!keep[last])
+                continue;
+
+            float worst;
+            if (worstBetween(timer, first, last, dutyOf, worst) && worst > result.maxError)
+                result.maxError = worst;
+            first = last;
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++)
+            if (keep[i])
+                timer[kept++] = timer[i];
+
+        result.removed = count - kept;
+        while (timer.size() > kept)
+            timer.pop_back();
+        return result;
+    }
+
+private:
+    static constexpr float ON_THE_LINE = 0.01f; /* float rounding on timers that are exactly on the line */
+
+    /* index of the timer between first and last that is furthest from the line between them - 0 when there is none */
+    template <typename DUTY>
+    static size_t worstBetween(const fixedVector<lightTimer_t, CAPACITY> &timer, const size_t first, const size_t last, DUTY dutyOf, float &worst)
+    {
+        const lightTimer_t &a = timer[first];
+        const lightTimer_t &b = timer[last];
+        const float slope = b.time > a.time ? float(b.percentage - a.percentage) / (b.time - a.time) : 0; /* sun timers can share a time */
+
+        size_t at = 0;
+        worst = 0;
+        for (size_t i = first + 1; i < last; i++)
+        {
+            const float onLine = a.percentage + slope * (timer[i].time - a.time);
+            const float error = fabsf(dutyOf(onLine) - dutyOf(timer[i].percentage));
+            if (error > worst || !at)
+            {
+                worst = error;
+                at = i;
+            }
+        }
+        return at;
+    }
+
+    bool keep[CAPACITY];
+};
+
+#endif
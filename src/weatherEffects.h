@@ -0,0 +1,168 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _WEATHEREFFECTS_H_
+#define _WEATHEREFFECTS_H_
+
+#include <stdint.h>
+
+#include "lightLayer.h"
+
+/*
+    Procedural weather effects that modulate the light level below them.
+    Everything is a pure function of seed, day and time, computed in integer math.
+    No state is kept between ticks so any moment can be replayed - on the device or in a host build - bit for bit.
+*/
+
+struct weatherEffect_t
+{
+    uint32_t seed;
+    uint8_t cloudDepth;        /* percent of the light a dense cloud takes away - 0 is off */
+    uint16_t cloudPeriodSec;   /* average time between cloud passes */
+    uint8_t lightningPerHour;  /* average number of strikes - 0 is off */
+    uint8_t lightningLevel;    /* percent */
+    uint8_t flickerDepth;      /* percent - 0 is off */
+    uint32_t flickerFromSec;   /* window in seconds since midnight, for example the first part of a sunrise */
+    uint32_t flickerToSec;
+
+    bool enabled() const { return cloudDepth || lightningPerHour || flickerDepth; }
+};
+
+namespace weather
+{
+    static constexpr uint32_t Q16_ONE = 1UL << 16;
+    static constexpr uint32_t LIGHTNING_SLOT_MS = 1000;
+    static constexpr uint32_t FLASH_RESOLUTION_MS = 10;
+    static constexpr uint32_t FLICKER_PERIOD_MS = 150;
+
+    static inline uint32_t hash(uint32_t a, uint32_t b)
+    {
+        uint32_t h = a * 0x9E3779B1UL ^ b;
+        h ^= h >> 16;
+        h *= 0x85EBCA6BUL;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35UL;
+        h ^= h >> 16;
+        return h;
+    }
+
+    /* smoothed value noise over time - returns 0..65535 */
+    static inline uint32_t valueNoise(const uint32_t seed, const uint32_t ms, const uint32_t periodMs)
+    {
+        const uint32_t lattice = ms / periodMs;
+        const uint32_t t = (uint64_t(ms % periodMs) << 16) / periodMs;
+        const uint32_t smooth = (((uint64_t(t) * t) >> 16) * (3 * Q16_ONE - 2 * t)) >> 16;
+
+        const int32_t a = hash(seed, lattice) >> 16;
+        const int32_t b = hash(seed, lattice + 1) >> 16;
+        return a + ((int64_t(b - a) * smooth) >> 16);
+    }
+
+    /* multiplier in Q16 - clear sky about half the time, passing clouds the other half */
+    static inline uint32_t cloudFactor(const weatherEffect_t &fx, const uint32_t seed, const uint32_t ms)
+    {
+        if (!fx.cloudDepth || !fx.cloudPeriodSec)
+            return Q16_ONE;
+
+        const uint32_t periodMs = fx.cloudPeriodSec * 1000UL;
+        const uint32_t noise = (2 * valueNoise(seed, ms, periodMs) + valueNoise(seed ^ 0x5bd1e995UL, ms, periodMs / 3 + 1)) / 3;
+        const uint32_t cover = noise > Q16_ONE / 2 ? (noise - Q16_ONE / 2) * 2 : 0;
+        const uint32_t depth = fx.cloudDepth * Q16_ONE / 100;
+
+        return Q16_ONE - ((uint64_t(depth) * cover) >> 16);
+    }
+
+    static inline uint32_t flickerFactor(const weatherEffect_t &fx, const uint32_t seed, const uint32_t msToday)
+    {
+        if (!fx.flickerDepth || msToday < fx.flickerFromSec * 1000UL || msToday >= fx.flickerToSec * 1000UL)
+            return Q16_ONE;
+
+        const uint32_t noise = valueNoise(seed ^ 0x27d4eb2fUL, msToday, FLICKER_PERIOD_MS);
+        const uint32_t depth = fx.flickerDepth * Q16_ONE / 100;
+
+        return Q16_ONE - ((uint64_t(depth) * noise) >> 16);
+    }
+
+    /* a strike is a burst of 1-3 flashes starting somewhere in a one second slot */
+    static inline bool flashInSlot(const weatherEffect_t &fx, const uint32_t seed, const uint32_t slot, const uint32_t ms)
+    {
+        const uint32_t h = hash(seed ^ 0x165667b1UL, slot);
+        if (h % 3600 >= fx.lightningPerHour)
+            return false;
+
+        uint32_t flashStart = slot * LIGHTNING_SLOT_MS + ((h >> 12) % (LIGHTNING_SLOT_MS / FLASH_RESOLUTION_MS)) * FLASH_RESOLUTION_MS;
+        const uint32_t flashes = 1 + (h >> 24) % 3;
+
+        for (uint32_t i = 0; i < flashes && flashStart <= ms; i++)
+        {
+            const uint32_t f = hash(h, i);
+            const uint32_t flashMs = (2 + f % 5) * FLASH_RESOLUTION_MS;         /* 20-60 ms */
+            const uint32_t gapMs = (4 + (f >> 8) % 9) * FLASH_RESOLUTION_MS;    /* 40-120 ms */
+
+            if (ms < flashStart + flashMs)
+                return true;
+
+            flashStart += flashMs + gapMs;
+        }
+        return false;
+    }
+
+    static inline bool lightning(const weatherEffect_t &fx, const uint32_t seed, const uint32_t ms)
+    {
+        if (!fx.lightningPerHour)
+            return false;
+
+        /* a burst lasts at most 540 ms so it can only spill over from the previous slot */
+        const uint32_t slot = ms / LIGHTNING_SLOT_MS;
+        return flashInSlot(fx, seed, slot, ms) || (slot && flashInSlot(fx, seed, slot - 1, ms));
+    }
+
+    static inline float apply(const weatherEffect_t &fx, const uint32_t day, const float level, const uint32_t msToday)
+    {
+        const uint32_t seed = hash(fx.seed, day);
+        const uint32_t factor = (uint64_t(cloudFactor(fx, seed, msToday)) * flickerFactor(fx, seed, msToday)) >> 16;
+        const float modulated = level * (factor / float(Q16_ONE));
+
+        return lightning(fx, seed, msToday) && fx.lightningLevel > modulated ? fx.lightningLevel : modulated;
+    }
+}
+
+template <size_t CHANNELS>
+class weatherEffectLayer : public lightLayer
+{
+public:
+    float evaluate(const int channel, const uint32_t msToday, const uint32_t msActive) override
+    {
+        return apply(channel, 0, msToday, msActive);
+    }
+
+    float apply(const int channel, const float below, const uint32_t msToday, const uint32_t /* msActive */) override
+    {
+        return effect[channel].enabled() ? weather::apply(effect[channel], day, below, msToday) : below;
+    }
+
+    weatherEffect_t effect[CHANNELS] = {};
+    uint32_t day = 0; /* days since epoch - every day gets different weather */
+};
+
+#endif
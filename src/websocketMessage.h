@@ -24,17 +24,24 @@ SOFTWARE.
 #ifndef _WEBSOCKETMESSAGE_H_
 #define _WEBSOCKETMESSAGE_H_
 
+#include "channelConfig.h"
+#include "spscRing.h"
+
 enum websocketMessageType
 {
     LIGHT_UPDATE,
     TEMPERATURE_UPDATE,
+    ALARM_UPDATE, /* websockets only - not in the event stream */
 };
 
+/* the httpTask formats the text - and only when there are clients */
 struct websocketMessage
 {
     websocketMessageType type;
-    char str[64];
-    int32_t int1;
+    uint8_t count;
+    float value[MAX_CHANNELS]; /* a level per channel, the temperature in value[0] or an alarm index, state and value */
 };
 
+using websocketRing_t = spscRing<websocketMessage, 4>;
+
 #endif
\ No newline at end of file
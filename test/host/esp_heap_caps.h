@@ -0,0 +1,47 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _HOST_ESP_HEAP_CAPS_H_
+#define _HOST_ESP_HEAP_CAPS_H_
+
+/* host build stand-in for the ESP-IDF heap api - a test sets the numbers it wants the heap to report */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+struct hostHeap_t
+{
+    size_t freeBytes;
+    size_t minimumFreeBytes;
+    size_t largestFreeBlock;
+};
+
+inline hostHeap_t hostHeap = {};
+
+static inline size_t heap_caps_get_free_size(uint32_t) { return hostHeap.freeBytes; }
+static inline size_t heap_caps_get_minimum_free_size(uint32_t) { return hostHeap.minimumFreeBytes; }
+static inline size_t heap_caps_get_largest_free_block(uint32_t) { return hostHeap.largestFreeBlock; }
+
+#endif
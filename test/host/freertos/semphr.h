@@ -0,0 +1,59 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _HOST_SEMPHR_H_
+#define _HOST_SEMPHR_H_
+
+/* host build stand-in for the FreeRTOS mutex api - a mutex is a std::timed_mutex, a tick is a millisecond */
+
+#include <chrono>
+#include <mutex>
+
+#include "FreeRTOS.h"
+
+struct hostSemaphore
+{
+    std::timed_mutex mutex;
+};
+typedef hostSemaphore *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new hostSemaphore; }
+static inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, const TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS)) ? pdTRUE : pdFALSE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+
+#endif
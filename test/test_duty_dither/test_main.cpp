@@ -0,0 +1,148 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <math.h>
+#include <unity.h>
+
+#include "dutyDither.h"
+
+/* the time averaged duty cycle has to be within 1/16 of a PWM step of the wanted value */
+static constexpr double TOLERANCE = 1.0 / 16;
+static constexpr int TICKS = 4096; /* 41 seconds of dimmer ticks */
+
+/* checks every output is one of the two steps around duty and returns the average */
+static double averageOf(const double duty, const uint32_t maxDuty, bool &neighbours)
+{
+    dutyDither dither;
+    uint64_t sum = 0;
+    neighbours = true;
+    for (int tick = 0; tick < TICKS; tick++)
+    {
+        const uint32_t output = dither.next(duty, maxDuty);
+        neighbours &= output == uint32_t(floor(duty)) || output == uint32_t(ceil(duty));
+        sum += output;
+    }
+    return double(sum) / TICKS;
+}
+
+static void checkBitDepth(const uint8_t bits)
+{
+    const uint32_t maxDuty = (1UL << bits) - 1;
+    const double fractions[] = {0.0, 0.001, 0.0625, 0.1, 0.25, 0.333, 0.5, 0.77, 0.9375, 0.999};
+    const double steps[] = {0, 1, 2, 3, 7, 100, double(maxDuty / 1000), double(maxDuty / 2), double(maxDuty - 1)};
+
+    for (const double step : steps)
+        for (const double fraction : fractions)
+        {
+            const double duty = step + fraction;
+            bool neighbours;
+            const double average = averageOf(duty, maxDuty, neighbours);
+
+            char message[96];
+            snprintf(message, sizeof(message), "%u bits, duty %.4f, average %.6f", bits, duty, average);
+            TEST_ASSERT_TRUE_MESSAGE(neighbours, message);
+            TEST_ASSERT_TRUE_MESSAGE(fabs(average - duty) < TOLERANCE, message);
+        }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_8_bits() { checkBitDepth(8); }
+void test_12_bits() { checkBitDepth(12); }
+void test_16_bits() { checkBitDepth(16); }
+
+/* the widest LEDC timer on the ESP32 - bits=20 at 50 Hz is a valid channel setting */
+void test_20_bits() { checkBitDepth(20); }
+
+/* a float of 1048575 * 99.9999 % is off by up to 1/16 of a step - the dimmer passes a double */
+void test_20_bit_percentages()
+{
+    const uint32_t maxDuty = (1UL << 20) - 1;
+    const float percentages[] = {0.0001f, 0.001f, 1.2345f, 12.345f, 33.3333f, 50.0005f, 87.654f, 99.9f, 99.9999f};
+
+    for (const float percentage : percentages)
+    {
+        const double duty = double(percentage) * maxDuty / 100;
+        bool neighbours;
+        const double average = averageOf(duty, maxDuty, neighbours);
+
+        char message[96];
+        snprintf(message, sizeof(message), "%.4f%%, duty %.6f, average %.6f", percentage, duty, average);
+        TEST_ASSERT_TRUE_MESSAGE(neighbours, message);
+        TEST_ASSERT_TRUE_MESSAGE(fabs(average - duty) < 1.0 / 1024, message);
+    }
+}
+
+void test_limits()
+{
+    dutyDither dither;
+    TEST_ASSERT_EQUAL_UINT32(0, dither.next(0.0, 65535));
+    TEST_ASSERT_EQUAL_UINT32(0, dither.next(-1.0, 65535));
+    TEST_ASSERT_EQUAL_UINT32(65535, dither.next(65535.0, 65535));
+    TEST_ASSERT_EQUAL_UINT32(65535, dither.next(70000.0, 65535));
+    TEST_ASSERT_EQUAL_UINT32(1048575, dither.next(2e6, 1048575));
+}
+
+/* moonlight - 0.01 % of a 16 bit channel is 6.5 steps and has to average out, not round */
+void test_deep_night_fade()
+{
+    const uint32_t maxDuty = 65535;
+    dutyDither dither;
+    double worst = 0;
+    for (int step = 0; step < 1000; step++)
+    {
+        const double duty = maxDuty * (0.0001 + step * 0.000001);
+        uint64_t sum = 0;
+        for (int tick = 0; tick < 256; tick++)
+            sum += dither.next(duty, maxDuty);
+
+        const double error = fabs(double(sum) / 256 - duty);
+        if (error > worst)
+            worst = error;
+    }
+    TEST_ASSERT_LESS_THAN(TOLERANCE, worst);
+}
+
+void test_reset_drops_the_carried_error()
+{
+    dutyDither dither;
+    TEST_ASSERT_EQUAL_UINT32(10, dither.next(10.75, 65535));
+    dither.reset();
+    TEST_ASSERT_EQUAL_UINT32(10, dither.next(10.75, 65535));
+    TEST_ASSERT_EQUAL_UINT32(11, dither.next(10.75, 65535));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_8_bits);
+    RUN_TEST(test_12_bits);
+    RUN_TEST(test_16_bits);
+    RUN_TEST(test_20_bits);
+    RUN_TEST(test_20_bit_percentages);
+    RUN_TEST(test_limits);
+    RUN_TEST(test_deep_night_fade);
+    RUN_TEST(test_reset_drops_the_carried_error);
+    return UNITY_END();
+}
@@ -0,0 +1,215 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <new>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "heapMonitor.h"
+#include "requestArena.h"
+#include "segmentTable.h"
+#include "stateBoard.h"
+
+/*
+    The steady state paths of the memory plan - an api response and a dimmer tick - must not touch the heap.
+    Every operator new in this test binary is counted.
+*/
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *memory = malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete[](void *memory) noexcept { free(memory); }
+void operator delete(void *memory, size_t) noexcept { free(memory); }
+void operator delete[](void *memory, size_t) noexcept { free(memory); }
+
+/* the same sizes as the app */
+static uint8_t arenaMemory[8192];
+static requestArena arena(arenaMemory, sizeof(arenaMemory));
+static timerList_t timers;
+static segmentTable<MAX_TIMERS_PER_CHANNEL> table[MAX_CHANNELS];
+static seqlock<lightState_t> lightState;
+static seqlock<heapHistory_t> heapMonitor;
+
+static void fillTimers()
+{
+    timers.clear();
+    for (int i = 0; i < int(MAX_TIMERS_PER_CHANNEL) - 1; i++)
+        timers.push_back({i * 864, (i * 37) % 101, 0, ANCHOR_MIDNIGHT});
+    timers.push_back({86400, timers.front().percentage, 0, ANCHOR_MIDNIGHT});
+}
+
+void setUp()
+{
+    arena.reset();
+    fillTimers();
+}
+
+void tearDown() {}
+
+void test_arena_alignment_and_overflow()
+{
+    uint8_t memory[64];
+    requestArena small(memory, sizeof(memory));
+
+    TEST_ASSERT_NOT_NULL(small.allocate(3, 1));
+    uint8_t *aligned = static_cast<uint8_t *>(small.allocate(8, 8));
+    TEST_ASSERT_NOT_NULL(aligned);
+    TEST_ASSERT_EQUAL(0, (aligned - memory) % 8);
+    TEST_ASSERT_EQUAL(64 - 16, small.available());
+
+    TEST_ASSERT_NULL(small.allocate(64));
+    TEST_ASSERT_EQUAL_UINT32(1, small.overflowCount());
+    TEST_ASSERT_EQUAL(64 - 16, small.available());
+
+    {
+        scopedArena scratch(small);
+        TEST_ASSERT_NOT_NULL(small.allocate(small.available()));
+    }
+    TEST_ASSERT_EQUAL(64, small.available());
+    TEST_ASSERT_EQUAL(64, small.highWaterMark());
+}
+
+void test_arena_text_truncates()
+{
+    uint8_t memory[16];
+    requestArena small(memory, sizeof(memory));
+    arenaText text(small);
+
+    TEST_ASSERT_TRUE(text.add("0123456789"));
+    TEST_ASSERT_FALSE(text.printf("%s", "abcdefgh"));
+    TEST_ASSERT_TRUE(text.overflowed());
+    TEST_ASSERT_EQUAL(15, text.size());
+    TEST_ASSERT_EQUAL_STRING("0123456789abcde", text.c_str());
+
+    /* the text took the whole arena */
+    TEST_ASSERT_NULL(small.allocate(1));
+}
+
+void test_fixed_vector_insert_keeps_order()
+{
+    fixedVector<int, 4> list;
+    list.push_back(10);
+    list.push_back(30);
+    TEST_ASSERT_EQUAL(20, *list.insert(list.begin() + 1, 20));
+    list.insert(list.begin(), 0);
+
+    TEST_ASSERT_TRUE(list.full());
+    TEST_ASSERT_FALSE(list.push_back(40));
+    TEST_ASSERT_TRUE(list.insert(list.begin(), -10) == list.end());
+
+    int expected = 0;
+    for (const int value : list)
+    {
+        TEST_ASSERT_EQUAL(expected, value);
+        expected += 10;
+    }
+}
+
+void test_heap_history_keeps_the_last_hour()
+{
+    heapHistory_t history = {};
+    for (uint32_t minute = 0; minute < HEAP_HISTORY_SIZE + 10; minute++)
+        history.add({minute * 60, 100000 - minute, 90000, 50000});
+
+    TEST_ASSERT_EQUAL_UINT32(HEAP_HISTORY_SIZE, history.count);
+    TEST_ASSERT_EQUAL_UINT32(10 * 60, history.at(0).uptimeSec);
+    TEST_ASSERT_EQUAL_UINT32((HEAP_HISTORY_SIZE + 9) * 60, history.at(HEAP_HISTORY_SIZE - 1).uptimeSec);
+}
+
+/* what GET /api/timers and a POST with a parsed body do */
+void test_no_allocations_per_request()
+{
+    /* the counter itself works */
+    size_t before = allocations;
+    int *volatile counted = new int;
+    delete counted;
+    TEST_ASSERT_EQUAL(1, allocations - before);
+
+    before = allocations;
+    for (int request = 0; request < 1000; request++)
+    {
+        scopedArena scratch(arena);
+        char *body = static_cast<char *>(arena.allocate(1024, 1));
+        TEST_ASSERT_NOT_NULL(body);
+        snprintf(body, 1024, "%i,%i\n", request, request % 101);
+
+        arenaText content(arena);
+        for (auto &timer : timers)
+            content.printf("%i,%i\n", timer.time, timer.percentage);
+        content.printf("%.2f\n", request / 3.0f);
+        TEST_ASSERT_FALSE(content.overflowed());
+    }
+    TEST_ASSERT_EQUAL(0, allocations - before);
+    TEST_ASSERT_EQUAL(arena.capacity(), arena.available());
+    TEST_ASSERT_EQUAL_UINT32(0, arena.overflowCount());
+}
+
+/* what dimmerTask does every 10 ms plus the minute heap sample of httpTask */
+void test_no_allocations_per_tick()
+{
+    for (auto &channel : table)
+        TEST_ASSERT_TRUE(channel.compile(timers.data(), timers.size()));
+
+    hostHeap = {200000, 150000, 100000};
+    static heapHistory_t history = {};
+
+    const size_t before = allocations;
+    static lightState_t state;
+    for (uint32_t ms = 0; ms < 24 * 3600 * 1000UL; ms += 10)
+    {
+        state.count = MAX_CHANNELS;
+        for (int i = 0; i < MAX_CHANNELS; i++)
+            state.level[i] = table[i].evaluate(ms);
+        lightState.publish(state);
+
+        if (ms % HEAP_SAMPLE_INTERVAL_MS == 0)
+        {
+            history.add(sampleHeap());
+            heapMonitor.publish(history);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, allocations - before);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, timers.front().percentage, lightState.read().level[0]);
+    TEST_ASSERT_EQUAL_UINT32(100000, heapMonitor.read().at(0).largestFreeBlock);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_arena_alignment_and_overflow);
+    RUN_TEST(test_arena_text_truncates);
+    RUN_TEST(test_fixed_vector_insert_keeps_order);
+    RUN_TEST(test_heap_history_keeps_the_last_hour);
+    RUN_TEST(test_no_allocations_per_request);
+    RUN_TEST(test_no_allocations_per_tick);
+    return UNITY_END();
+}
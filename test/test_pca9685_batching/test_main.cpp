@@ -0,0 +1,176 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <string.h>
+#include <unity.h>
+
+#include "outputBackend.h"
+
+/* keeps the last transaction and can be told to fail */
+class mockBus : public i2cBus
+{
+public:
+    uint8_t address = 0;
+    uint8_t data[128] = {};
+    size_t length = 0;
+    bool fail = false;
+
+protected:
+    bool transfer(const uint8_t to, const uint8_t *buffer, const size_t size) override
+    {
+        address = to;
+        length = size;
+        memcpy(data, buffer, size);
+        return !fail;
+    }
+};
+
+static constexpr uint8_t ADDRESS = 0x40;
+static constexpr uint8_t LED0_ON_L = 0x06;
+static constexpr size_t REGISTERS_PER_OUTPUT = 4;
+
+static mockBus *bus;
+static pca9685Backend *pca;
+
+/* the registers of an output in the last burst */
+static const uint8_t *registersOf(const int output)
+{
+    const int first = (bus->data[0] - LED0_ON_L) / REGISTERS_PER_OUTPUT;
+    return bus->data + 1 + (output - first) * REGISTERS_PER_OUTPUT;
+}
+
+void setUp()
+{
+    bus = new mockBus;
+    pca = new pca9685Backend(*bus, ADDRESS);
+    pca->begin(1000);
+    bus->transactions = 0;
+    bus->bytes = 0;
+}
+
+void tearDown()
+{
+    delete pca;
+    delete bus;
+}
+
+void test_begin_clears_all_outputs_in_one_burst()
+{
+    mockBus fresh;
+    pca9685Backend driver(fresh, ADDRESS);
+    TEST_ASSERT_TRUE(driver.begin(1000));
+
+    /* sleep, prescale, wake and one burst */
+    TEST_ASSERT_EQUAL_UINT32(4, fresh.transactions);
+    TEST_ASSERT_EQUAL_HEX8(ADDRESS, fresh.address);
+    TEST_ASSERT_EQUAL_HEX8(LED0_ON_L, fresh.data[0]);
+    TEST_ASSERT_EQUAL(1 + pca9685Backend::OUTPUTS * REGISTERS_PER_OUTPUT, fresh.length);
+}
+
+void test_one_burst_per_tick()
+{
+    for (uint32_t tick = 1; tick <= 100; tick++)
+    {
+        for (int output = 0; output < pca9685Backend::OUTPUTS; output++)
+            pca->write(output, tick * 10 + output);
+        TEST_ASSERT_TRUE(pca->flush());
+        TEST_ASSERT_EQUAL_UINT32(tick, bus->transactions);
+    }
+}
+
+void test_no_transaction_without_change()
+{
+    pca->write(3, 1000);
+    pca->write(7, 2000, 512);
+    pca->flush();
+    TEST_ASSERT_EQUAL_UINT32(1, bus->transactions);
+
+    /* the same duty cycles again */
+    for (int tick = 0; tick < 100; tick++)
+    {
+        pca->write(3, 1000);
+        pca->write(7, 2000, 512);
+        TEST_ASSERT_TRUE(pca->flush());
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, bus->transactions);
+
+    /* nothing written at all */
+    TEST_ASSERT_TRUE(pca->flush());
+    TEST_ASSERT_EQUAL_UINT32(1, bus->transactions);
+}
+
+void test_burst_spans_first_to_last_changed()
+{
+    pca->write(9, 1000, 100);
+    pca->write(3, 2000);
+    pca->flush();
+
+    TEST_ASSERT_EQUAL_UINT32(1, bus->transactions);
+    TEST_ASSERT_EQUAL_HEX8(LED0_ON_L + 3 * REGISTERS_PER_OUTPUT, bus->data[0]);
+    TEST_ASSERT_EQUAL(1 + (9 - 3 + 1) * REGISTERS_PER_OUTPUT, bus->length);
+
+    /* ON at the phase, OFF after the duty cycle */
+    const uint8_t output9[] = {100, 0, 1100 & 0xFF, 1100 >> 8};
+    TEST_ASSERT_EQUAL(0, memcmp(output9, registersOf(9), sizeof(output9)));
+    const uint8_t output3[] = {0, 0, 2000 & 0xFF, 2000 >> 8};
+    TEST_ASSERT_EQUAL(0, memcmp(output3, registersOf(3), sizeof(output3)));
+
+    /* the unchanged outputs in between are resent as they were - off */
+    const uint8_t off[] = {0, 0, 0, 0x10};
+    for (int output = 4; output < 9; output++)
+        TEST_ASSERT_EQUAL(0, memcmp(off, registersOf(output), sizeof(off)));
+
+    /* a single changed output is a burst of one */
+    pca->write(12, 4095);
+    pca->flush();
+    TEST_ASSERT_EQUAL_HEX8(LED0_ON_L + 12 * REGISTERS_PER_OUTPUT, bus->data[0]);
+    TEST_ASSERT_EQUAL(1 + REGISTERS_PER_OUTPUT, bus->length);
+    const uint8_t on[] = {0, 0x10, 0, 0};
+    TEST_ASSERT_EQUAL(0, memcmp(on, registersOf(12), sizeof(on)));
+}
+
+void test_failed_burst_is_resent()
+{
+    bus->fail = true;
+    pca->write(5, 100);
+    TEST_ASSERT_FALSE(pca->flush());
+
+    bus->fail = false;
+    TEST_ASSERT_TRUE(pca->flush());
+    TEST_ASSERT_EQUAL_UINT32(2, bus->transactions);
+    TEST_ASSERT_EQUAL_HEX8(LED0_ON_L + 5 * REGISTERS_PER_OUTPUT, bus->data[0]);
+
+    TEST_ASSERT_TRUE(pca->flush());
+    TEST_ASSERT_EQUAL_UINT32(2, bus->transactions);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_clears_all_outputs_in_one_burst);
+    RUN_TEST(test_one_burst_per_tick);
+    RUN_TEST(test_no_transaction_without_change);
+    RUN_TEST(test_burst_spans_first_to_last_changed);
+    RUN_TEST(test_failed_burst_is_resent);
+    return UNITY_END();
+}
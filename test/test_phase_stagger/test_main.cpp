@@ -0,0 +1,255 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "phaseStagger.h"
+
+/*
+    Host model of the supply current with and without PWM_STAGGER.
+    Every channel draws the same current while its pulse is high, so the peak current is the peak number of overlapping pulses.
+*/
+
+static channelConfig_t config;
+static uint32_t dutyCycle[MAX_CHANNELS];
+static uint32_t phase[MAX_CHANNELS];
+static float start[MAX_CHANNELS];
+static float width[MAX_CHANNELS];
+
+static void useLedc(const int count, const uint8_t bits)
+{
+    config.count = count;
+    for (int index = 0; index < count; index++)
+    {
+        config.setDefault(index, index);
+        config.bitDepth[index] = bits;
+        config.maxDuty[index] = (1UL << bits) - 1;
+    }
+}
+
+static void usePca9685(const int count)
+{
+    useLedc(count, 12);
+    for (int index = 0; index < count; index++)
+    {
+        config.output[index] = OUTPUT_PCA9685;
+        config.frequency[index] = 1000;
+    }
+}
+
+/* peak overlap of the channels in the period group of first */
+static int peakOf(const int first, const bool staggered)
+{
+    float groupStart[MAX_CHANNELS];
+    float groupWidth[MAX_CHANNELS];
+    size_t members = 0;
+    for (int index = 0; index < config.count; index++)
+        if (periodGroupOf(config, index) == periodGroupOf(config, first))
+        {
+            groupStart[members] = staggered ? start[index] : 0.0f;
+            groupWidth[members++] = width[index];
+        }
+    return peakOverlap(groupStart, groupWidth, members);
+}
+
+void setUp()
+{
+    config = {};
+    for (auto &value : phase)
+        value = 0;
+    srand(42);
+}
+
+void tearDown() {}
+
+void test_period_groups()
+{
+    useLedc(5, 16);
+
+    /* LEDC channels 2-6 - timers 1, 1, 2, 2 and 3 */
+    TEST_ASSERT_EQUAL(periodGroupOf(config, 0), periodGroupOf(config, 1));
+    TEST_ASSERT_EQUAL(periodGroupOf(config, 2), periodGroupOf(config, 3));
+    TEST_ASSERT_NOT_EQUAL(periodGroupOf(config, 1), periodGroupOf(config, 2));
+    TEST_ASSERT_NOT_EQUAL(periodGroupOf(config, 3), periodGroupOf(config, 4));
+
+    /* same frequency but another timer is not in step */
+    TEST_ASSERT_EQUAL_UINT32(config.frequency[1], config.frequency[2]);
+    TEST_ASSERT_NOT_EQUAL(periodGroupOf(config, 1), periodGroupOf(config, 2));
+
+    usePca9685(16);
+    for (int index = 1; index < 16; index++)
+        TEST_ASSERT_EQUAL(periodGroupOf(config, 0), periodGroupOf(config, index));
+}
+
+void test_ledc_pair_is_staggered()
+{
+    useLedc(5, 16);
+    const uint32_t period = config.maxDuty[0] + 1;
+    for (int index = 0; index < 5; index++)
+        dutyCycle[index] = period * 0.4;
+
+    planPulses(config, dutyCycle, 0, true, phase, start, width);
+
+    /* the second channel on a timer starts where the first ends, the first channel on every timer starts at 0 */
+    TEST_ASSERT_EQUAL_UINT32(0, phase[0]);
+    TEST_ASSERT_EQUAL_UINT32(dutyCycle[0], phase[1]);
+    TEST_ASSERT_EQUAL_UINT32(0, phase[2]);
+    TEST_ASSERT_EQUAL_UINT32(dutyCycle[2], phase[3]);
+    TEST_ASSERT_EQUAL_UINT32(0, phase[4]);
+
+    TEST_ASSERT_EQUAL(2, peakOf(0, false));
+    TEST_ASSERT_EQUAL(1, peakOf(0, true));
+}
+
+void test_without_stagger_all_start_at_zero()
+{
+    usePca9685(8);
+    for (int index = 0; index < 8; index++)
+        dutyCycle[index] = 500;
+
+    planPulses(config, dutyCycle, 0, false, phase, start, width);
+    for (int index = 0; index < 8; index++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(0, phase[index]);
+        TEST_ASSERT_EQUAL_FLOAT(0.0f, start[index]);
+    }
+    TEST_ASSERT_EQUAL(8, peakOf(0, true));
+}
+
+/* LEDC pulses are cut at the end of the period so they may not start too late */
+void test_ledc_pulses_end_within_the_period()
+{
+    useLedc(16, 12);
+    const uint32_t period = config.maxDuty[0] + 1;
+    for (int round = 0; round < 10000; round++)
+    {
+        for (int index = 0; index < 16; index++)
+            dutyCycle[index] = rand() % (period + 1);
+
+        planPulses(config, dutyCycle, 0, true, phase, start, width);
+        for (int index = 0; index < 16; index++)
+            TEST_ASSERT_LESS_OR_EQUAL(period, phase[index] + dutyCycle[index]);
+    }
+}
+
+/* the staggered peak of a PCA9685 is the lowest possible - the total duty rounded up */
+void test_pca9685_peak_current()
+{
+    usePca9685(16);
+    const uint32_t period = config.maxDuty[0] + 1;
+    double inPhase = 0;
+    double staggered = 0;
+    const int ROUNDS = 2000;
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        float total = 0;
+        for (int index = 0; index < 16; index++)
+        {
+            /* mostly dim channels like a real tank, some bright */
+            dutyCycle[index] = rand() % 4 ? rand() % (period / 8) : rand() % period;
+            total += float(dutyCycle[index]) / period;
+        }
+
+        planPulses(config, dutyCycle, 0, true, phase, start, width);
+        const int peak = peakOf(0, true);
+        TEST_ASSERT_LESS_OR_EQUAL(int(ceilf(total)), peak);
+        inPhase += peakOf(0, false);
+        staggered += peak;
+    }
+
+    char message[96];
+    snprintf(message, sizeof(message), "16 PCA9685 outputs - mean peak %.2f channels in phase, %.2f staggered",
+             inPhase / ROUNDS, staggered / ROUNDS);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(inPhase / 3, staggered);
+}
+
+void test_ledc_peak_current()
+{
+    useLedc(6, 16);
+    const uint32_t period = config.maxDuty[0] + 1;
+    int inPhase = 0;
+    int staggered = 0;
+
+    for (int round = 0; round < 2000; round++)
+    {
+        for (int index = 0; index < 6; index++)
+            dutyCycle[index] = rand() % (period / 2);
+
+        planPulses(config, dutyCycle, 0, true, phase, start, width);
+        for (int first = 0; first < 6; first += 2)
+        {
+            /* two pulses below half a period each never overlap */
+            TEST_ASSERT_LESS_OR_EQUAL(1, peakOf(first, true));
+            inPhase += peakOf(first, false);
+            staggered += peakOf(first, true);
+        }
+    }
+    TEST_ASSERT_LESS_THAN(inPhase, staggered);
+}
+
+/* a channel under a hardware fade keeps its hpoint and the other channel on its timer moves around it */
+void test_held_channel_keeps_its_phase()
+{
+    useLedc(2, 16);
+    const uint32_t period = config.maxDuty[0] + 1;
+    dutyCycle[0] = period / 4;
+    dutyCycle[1] = period / 4;
+
+    /* the fading channel is at a phase that a fresh plan would not give it */
+    phase[1] = period / 8;
+    planPulses(config, dutyCycle, 1UL << 1, true, phase, start, width);
+
+    TEST_ASSERT_EQUAL_UINT32(period / 8, phase[1]);
+    TEST_ASSERT_EQUAL_FLOAT(0.125f, start[1]);
+    TEST_ASSERT_EQUAL_UINT32(period / 8 + period / 4, phase[0]);
+    TEST_ASSERT_EQUAL(1, peakOf(0, true));
+
+    /* the duty of the held channel grows with the fade and the other one moves along */
+    dutyCycle[1] = period / 2;
+    planPulses(config, dutyCycle, 1UL << 1, true, phase, start, width);
+    TEST_ASSERT_EQUAL_UINT32(period / 8, phase[1]);
+    TEST_ASSERT_EQUAL_UINT32(period / 8 + period / 2, phase[0]);
+    TEST_ASSERT_EQUAL(1, peakOf(0, true));
+
+    /* after the fade it is planned again */
+    planPulses(config, dutyCycle, 0, true, phase, start, width);
+    TEST_ASSERT_EQUAL_UINT32(0, phase[0]);
+    TEST_ASSERT_EQUAL_UINT32(period / 4, phase[1]);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_period_groups);
+    RUN_TEST(test_ledc_pair_is_staggered);
+    RUN_TEST(test_without_stagger_all_start_at_zero);
+    RUN_TEST(test_ledc_pulses_end_within_the_period);
+    RUN_TEST(test_pca9685_peak_current);
+    RUN_TEST(test_ledc_peak_current);
+    RUN_TEST(test_held_channel_keeps_its_phase);
+    return UNITY_END();
+}
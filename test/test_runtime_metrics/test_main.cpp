@@ -0,0 +1,213 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <string.h>
+#include <thread>
+#include <unity.h>
+
+#include "ScopedMutex.h"
+#include "runtimeMetrics.h"
+
+/* normally in main.cpp */
+mutexMetrics_t mutexMetrics[MAX_TRACKED_MUTEXES];
+thread_local taskPhases_t taskPhases;
+
+static uint8_t arenaMemory[4096];
+static requestArena arena(arenaMemory, sizeof(arenaMemory));
+
+static SemaphoreHandle_t trackedMutex;
+static SemaphoreHandle_t otherMutex;
+
+void setUp()
+{
+    trackedMutex = xSemaphoreCreateMutex();
+    otherMutex = xSemaphoreCreateMutex();
+
+    /* the histograms keep counting across tests - the tests look at the difference */
+    mutexMetrics[0].name = "trackedMutex";
+    mutexMetrics[0].handle.store(trackedMutex);
+
+    taskPhases = {};
+    arena.reset();
+}
+
+void tearDown()
+{
+    vSemaphoreDelete(trackedMutex);
+    vSemaphoreDelete(otherMutex);
+}
+
+void test_histogram_buckets()
+{
+    latencyHistogram histogram;
+    histogram.record(0);
+    histogram.record(10);    /* on a bound is in that bucket */
+    histogram.record(11);
+    histogram.record(1500);
+    histogram.record(50000);
+    histogram.record(50001); /* above the last bound */
+    histogram.record(900000);
+
+    TEST_ASSERT_EQUAL_UINT32(2, histogram.countIn(0));
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.countIn(1));
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.countIn(5));
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.countIn(latencyHistogram::BUCKETS - 1));
+    TEST_ASSERT_EQUAL_UINT32(2, histogram.countIn(latencyHistogram::BUCKETS));
+    TEST_ASSERT_EQUAL_UINT32(0 + 10 + 11 + 1500 + 50000 + 50001 + 900000, histogram.totalUs());
+    TEST_ASSERT_EQUAL_UINT32(900000, histogram.highestUs());
+}
+
+/* several tasks record into the mutex histograms at once - no sample may get lost */
+void test_histogram_concurrent_recording()
+{
+    static latencyHistogram histogram;
+    static constexpr int THREADS = 4;
+    static constexpr uint32_t SAMPLES = 100000;
+
+    std::thread recorder[THREADS];
+    for (int t = 0; t < THREADS; t++)
+        recorder[t] = std::thread([t]
+                                  {
+                                      for (uint32_t i = 0; i < SAMPLES; i++)
+                                          histogram.record(t * 1000 + i % 7); });
+    for (auto &thread : recorder)
+        thread.join();
+
+    uint32_t total = 0;
+    for (size_t i = 0; i <= latencyHistogram::BUCKETS; i++)
+        total += histogram.countIn(i);
+    TEST_ASSERT_EQUAL_UINT32(THREADS * SAMPLES, total);
+    TEST_ASSERT_EQUAL_UINT32(SAMPLES, histogram.countIn(0));
+    TEST_ASSERT_EQUAL_UINT32(3006, histogram.highestUs());
+}
+
+void test_prometheus_histogram()
+{
+    latencyHistogram histogram;
+    histogram.record(5);
+    histogram.record(70);
+    histogram.record(70000);
+
+    arenaText content(arena);
+    addHistogram(content, "aquacontrol_test", "mutex=\"spiMutex\"", histogram);
+
+    const char *expected =
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"1e-05\"} 1\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"5e-05\"} 1\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"0.0001\"} 2\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"0.0005\"} 2\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"0.001\"} 2\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"0.002\"} 2\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"0.005\"} 2\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"0.01\"} 2\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"0.05\"} 2\n"
+        "aquacontrol_test_seconds_bucket{mutex=\"spiMutex\",le=\"+Inf\"} 3\n"
+        "aquacontrol_test_seconds_sum{mutex=\"spiMutex\"} 0.070075\n"
+        "aquacontrol_test_seconds_count{mutex=\"spiMutex\"} 3\n";
+    TEST_ASSERT_EQUAL_STRING(expected, content.c_str());
+}
+
+void test_untracked_mutex_is_not_recorded()
+{
+    TEST_ASSERT_NULL(metricsFor(otherMutex));
+    const uint32_t before = mutexMetrics[0].wait.countIn(0);
+    {
+        ScopedMutex lock(otherMutex);
+        TEST_ASSERT_TRUE(lock.acquired());
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, mutexMetrics[0].wait.countIn(0));
+}
+
+void test_mutex_wait_times()
+{
+    TEST_ASSERT_TRUE(metricsFor(trackedMutex) == &mutexMetrics[0]);
+    const uint32_t uncontended = mutexMetrics[0].wait.countIn(0);
+    const uint32_t totalUs = mutexMetrics[0].wait.totalUs();
+
+    /* uncontended - recorded as no wait */
+    {
+        ScopedMutex lock(trackedMutex);
+        TEST_ASSERT_TRUE(lock.acquired());
+    }
+    TEST_ASSERT_EQUAL_UINT32(uncontended + 1, mutexMetrics[0].wait.countIn(0));
+    TEST_ASSERT_EQUAL_UINT32(0, taskPhases.lockWaitUs);
+
+    /* another task holds the mutex for 20 ms */
+    xSemaphoreTake(trackedMutex, portMAX_DELAY);
+    std::thread holder([]
+                       {
+                           std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                           xSemaphoreGive(trackedMutex); });
+    {
+        ScopedMutex lock(trackedMutex, pdMS_TO_TICKS(1000));
+        TEST_ASSERT_TRUE(lock.acquired());
+    }
+    holder.join();
+
+    TEST_ASSERT_GREATER_OR_EQUAL(10000, taskPhases.lockWaitUs);
+    TEST_ASSERT_EQUAL_UINT32(totalUs + taskPhases.lockWaitUs, mutexMetrics[0].wait.totalUs());
+    TEST_ASSERT_EQUAL_UINT32(0, mutexMetrics[0].timeouts.load());
+}
+
+void test_mutex_timeouts()
+{
+    bool acquired = true;
+    uint32_t waitedUs = 0;
+
+    xSemaphoreTake(trackedMutex, portMAX_DELAY);
+    std::thread waiter([&]
+                       {
+                           ScopedMutex lock(trackedMutex, pdMS_TO_TICKS(5));
+                           acquired = lock.acquired();
+                           waitedUs = taskPhases.lockWaitUs; });
+    waiter.join();
+    xSemaphoreGive(trackedMutex);
+
+    TEST_ASSERT_FALSE(acquired);
+    TEST_ASSERT_GREATER_OR_EQUAL(5000, waitedUs);
+    TEST_ASSERT_EQUAL_UINT32(1, mutexMetrics[0].timeouts.load());
+}
+
+void test_phase_timer()
+{
+    uint32_t storageUs = 0;
+    {
+        phaseTimer timer(storageUs);
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(3000, storageUs);
+    TEST_ASSERT_LESS_THAN(1000000, storageUs);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_histogram_buckets);
+    RUN_TEST(test_histogram_concurrent_recording);
+    RUN_TEST(test_prometheus_histogram);
+    RUN_TEST(test_untracked_mutex_is_not_recorded);
+    RUN_TEST(test_mutex_wait_times);
+    RUN_TEST(test_mutex_timeouts);
+    RUN_TEST(test_phase_timer);
+    return UNITY_END();
+}
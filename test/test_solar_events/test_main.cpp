@@ -0,0 +1,192 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <unity.h>
+
+#include "scheduleCalendar.h"
+#include "solarEvents.h"
+
+/* sunrise and sunset against published tables - times in UTC, rounded to the minute as the tables print them */
+
+struct reference_t
+{
+    const char *place;
+    double latitude;
+    double longitude;
+    int year;
+    unsigned month;
+    unsigned day;
+    int sunrise; /* minutes after 00:00 UTC */
+    int sunset;
+};
+
+static constexpr int HM(const int hours, const int minutes) { return hours * 60 + minutes; }
+
+static const reference_t REFERENCE[] = {
+    {"equator", 0, 0, 2024, 3, 20, HM(6, 4), HM(18, 10)},
+    {"Amsterdam", 52.37, 4.90, 2024, 3, 20, HM(5, 42), HM(17, 54)},
+    {"Amsterdam", 52.37, 4.90, 2024, 6, 21, HM(3, 18), HM(20, 6)},
+    {"Amsterdam", 52.37, 4.90, 2024, 12, 21, HM(7, 48), HM(15, 29)},
+    {"New York", 40.71, -74.01, 2024, 6, 21, HM(9, 25), HM(0, 31)},
+    {"New York", 40.71, -74.01, 2024, 12, 21, HM(12, 17), HM(21, 32)},
+    {"Cape Town", -33.92, 18.42, 2024, 6, 21, HM(5, 51), HM(15, 45)},
+    {"Sydney", -33.87, 151.21, 2024, 6, 21, HM(21, 0), HM(6, 54)},
+    {"Sydney", -33.87, 151.21, 2024, 12, 21, HM(18, 41), HM(9, 5)},
+    {"Reykjavik", 64.15, -21.94, 2024, 6, 21, HM(2, 55), HM(0, 4)},
+    {"Reykjavik", 64.15, -21.94, 2024, 12, 21, HM(11, 22), HM(15, 29)},
+    {"Tromso", 69.65, 18.96, 2024, 3, 20, HM(4, 42), HM(17, 3)},
+};
+
+static constexpr double TOLERANCE_MIN = 2; /* the tables round, and their refraction model differs a little */
+
+void setUp() {}
+void tearDown() {}
+
+/* the distance between two times of day - the tables print a time of day, the calculation can run past either midnight */
+static double minutesApart(const double calculated, const int published)
+{
+    const double apart = fmod(fabs(calculated - published), 1440);
+    return apart > 720 ? 1440 - apart : apart;
+}
+
+static void test_reference_tables()
+{
+    for (const reference_t &ref : REFERENCE)
+    {
+        const solarDay_t sun = solarEvents(dayNumber(ref.year, ref.month, ref.day), ref.latitude, ref.longitude);
+
+        char message[96];
+        snprintf(message, sizeof(message), "%s %04i-%02u-%02u rise %.1f set %.1f", ref.place, ref.year, ref.month, ref.day,
+                 sun.sunriseMin, sun.sunsetMin);
+        TEST_ASSERT_EQUAL_MESSAGE(SUN_RISES_AND_SETS, sun.type, message);
+        TEST_ASSERT_TRUE_MESSAGE(minutesApart(sun.sunriseMin, ref.sunrise) <= TOLERANCE_MIN, message);
+        TEST_ASSERT_TRUE_MESSAGE(minutesApart(sun.sunsetMin, ref.sunset) <= TOLERANCE_MIN, message);
+    }
+}
+
+/* far east of Greenwich the UTC sunrise falls on the day before - the event keeps its order in the day */
+static void test_events_keep_their_order()
+{
+    for (const reference_t &ref : REFERENCE)
+    {
+        const solarDay_t sun = solarEvents(dayNumber(ref.year, ref.month, ref.day), ref.latitude, ref.longitude);
+        TEST_ASSERT_TRUE(sun.sunriseMin < sun.sunsetMin);
+        TEST_ASSERT_TRUE(sun.sunsetMin - sun.sunriseMin < 1440);
+    }
+    const solarDay_t sydney = solarEvents(dayNumber(2024, 12, 21), -33.87, 151.21);
+    TEST_ASSERT_TRUE(sydney.sunriseMin < 0);
+}
+
+static void test_polar_day_and_night()
+{
+    const struct
+    {
+        double latitude;
+        double longitude;
+        unsigned month;
+        solarDayType type;
+    } polar[] = {
+        {69.65, 18.96, 6, SUN_ALWAYS_UP},     /* Tromso, midnight sun */
+        {69.65, 18.96, 12, SUN_ALWAYS_DOWN},  /* Tromso, polar night */
+        {78.22, 15.65, 6, SUN_ALWAYS_UP},     /* Longyearbyen */
+        {78.22, 15.65, 12, SUN_ALWAYS_DOWN},  /* Longyearbyen */
+        {-77.85, 166.67, 6, SUN_ALWAYS_DOWN}, /* McMurdo */
+        {-77.85, 166.67, 12, SUN_ALWAYS_UP},  /* McMurdo */
+    };
+    for (const auto &place : polar)
+    {
+        const solarDay_t sun = solarEvents(dayNumber(2024, place.month, 21), place.latitude, place.longitude);
+        TEST_ASSERT_EQUAL(place.type, sun.type);
+
+        /* solar noon for the day - 720 minutes of hour angle either side under the sun, none at night */
+        const double noon = (sun.sunriseMin + sun.sunsetMin) / 2;
+        TEST_ASSERT_FLOAT_WITHIN(20, 720 - 4 * place.longitude, noon);
+        TEST_ASSERT_FLOAT_WITHIN(1, place.type == SUN_ALWAYS_UP ? 1440 : 0, sun.sunsetMin - sun.sunriseMin);
+    }
+}
+
+/* the edge of the polar circle - a day that only just rises, a few degrees further north it does not */
+static void test_polar_circle_edge()
+{
+    const int32_t day = dayNumber(2024, 12, 21);
+    const solarDay_t arcticCircle = solarEvents(day, 66.0, 0);
+    const solarDay_t beyond = solarEvents(day, 68.0, 0);
+    TEST_ASSERT_EQUAL(SUN_RISES_AND_SETS, arcticCircle.type);
+    TEST_ASSERT_TRUE(arcticCircle.sunsetMin - arcticCircle.sunriseMin < 180);
+    TEST_ASSERT_EQUAL(SUN_ALWAYS_DOWN, beyond.type);
+}
+
+/* the local times the timers are anchored to - localMidnight is the epoch time of 00:00 local time */
+static int64_t localMidnight(const int32_t day, const int utcOffsetHours) { return int64_t(day) * 86400 - utcOffsetHours * 3600; }
+
+static void test_local_times()
+{
+    int sunrise, sunset;
+
+    /* Amsterdam in summer time - 05:18 and 22:06 */
+    int32_t day = dayNumber(2024, 6, 21);
+    localSolarTimes(solarEvents(day, 52.37, 4.90), day, localMidnight(day, 2), sunrise, sunset);
+    TEST_ASSERT_INT_WITHIN(120, HM(5, 18) * 60, sunrise);
+    TEST_ASSERT_INT_WITHIN(120, HM(22, 6) * 60, sunset);
+
+    /* New York - the UTC sunset is on the next day, the local one at 20:31 */
+    localSolarTimes(solarEvents(day, 40.71, -74.01), day, localMidnight(day, -4), sunrise, sunset);
+    TEST_ASSERT_INT_WITHIN(120, HM(5, 25) * 60, sunrise);
+    TEST_ASSERT_INT_WITHIN(120, HM(20, 31) * 60, sunset);
+
+    /* Sydney in summer time - the UTC sunrise is on the day before, the local one at 05:41 */
+    day = dayNumber(2024, 12, 21);
+    localSolarTimes(solarEvents(day, -33.87, 151.21), day, localMidnight(day, 11), sunrise, sunset);
+    TEST_ASSERT_INT_WITHIN(120, HM(5, 41) * 60, sunrise);
+    TEST_ASSERT_INT_WITHIN(120, HM(20, 5) * 60, sunset);
+}
+
+/* a polar day runs from midnight to midnight, a polar night has both at solar noon */
+static void test_local_polar_times()
+{
+    int sunrise, sunset;
+
+    int32_t day = dayNumber(2024, 6, 21);
+    localSolarTimes(solarEvents(day, 69.65, 18.96), day, localMidnight(day, 2), sunrise, sunset);
+    TEST_ASSERT_EQUAL(0, sunrise);
+    TEST_ASSERT_EQUAL(86399, sunset);
+
+    day = dayNumber(2024, 12, 21);
+    localSolarTimes(solarEvents(day, 69.65, 18.96), day, localMidnight(day, 1), sunrise, sunset);
+    TEST_ASSERT_EQUAL(sunrise, sunset);
+    TEST_ASSERT_INT_WITHIN(300, HM(11, 42) * 60, sunrise);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_reference_tables);
+    RUN_TEST(test_events_keep_their_order);
+    RUN_TEST(test_polar_day_and_night);
+    RUN_TEST(test_polar_circle_edge);
+    RUN_TEST(test_local_times);
+    RUN_TEST(test_local_polar_times);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <unity.h>
+
+#include "websocketMessage.h"
+
+/*
+    Throughput of the spsc ring against the FreeRTOS queue it replaced, with the websocket message as payload.
+    Runs on the board - pio test -e m5stack -f test_spsc_benchmark
+*/
+
+static constexpr int MESSAGES = 20000;
+static constexpr UBaseType_t QUEUE_LENGTH = websocketRing_t::capacity();
+
+static websocketRing_t ring;
+static QueueHandle_t queue;
+static TaskHandle_t benchmarkTask;
+
+static void report(const char *what, const int64_t ringUs, const int64_t queueUs)
+{
+    char str[128];
+    snprintf(str, sizeof(str), "%s: ring %.2f us/msg - queue %.2f us/msg - %.1fx",
+             what, float(ringUs) / MESSAGES, float(queueUs) / MESSAGES, float(queueUs) / ringUs);
+    TEST_MESSAGE(str);
+}
+
+/* one task pushes and pops - the cost of the calls themselves */
+void test_same_task()
+{
+    websocketMessage msg = {LIGHT_UPDATE, uint8_t(MAX_CHANNELS), {}};
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        ring.push(msg);
+        ring.pop(msg);
+    }
+    const int64_t ringUs = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        xQueueSend(queue, &msg, 0);
+        xQueueReceive(queue, &msg, 0);
+    }
+    const int64_t queueUs = esp_timer_get_time() - start;
+
+    report("same task", ringUs, queueUs);
+    TEST_ASSERT_LESS_THAN(queueUs, ringUs);
+}
+
+static void ringProducer(void *parameter)
+{
+    websocketMessage msg = {LIGHT_UPDATE, uint8_t(MAX_CHANNELS), {}};
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        msg.value[0] = i;
+        while (!ring.push(msg))
+            taskYIELD();
+    }
+    vTaskDelete(NULL);
+}
+
+static void queueProducer(void *parameter)
+{
+    websocketMessage msg = {LIGHT_UPDATE, uint8_t(MAX_CHANNELS), {}};
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        msg.value[0] = i;
+        xQueueSend(queue, &msg, portMAX_DELAY);
+    }
+    vTaskDelete(NULL);
+}
+
+/* a producer on the other core and the consumer waking up as it does in lcdTask and httpTask */
+void test_across_cores()
+{
+    websocketMessage msg;
+    int received = 0;
+
+    ring.setConsumer(benchmarkTask);
+    int64_t start = esp_timer_get_time();
+    xTaskCreatePinnedToCore(ringProducer, NULL, 4096, NULL, uxTaskPriorityGet(NULL), NULL, 0);
+    while (received < MESSAGES)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (ring.pop(msg))
+        {
+            TEST_ASSERT_EQUAL_FLOAT(received, msg.value[0]);
+            received++;
+        }
+    }
+    const int64_t ringUs = esp_timer_get_time() - start;
+
+    received = 0;
+    start = esp_timer_get_time();
+    xTaskCreatePinnedToCore(queueProducer, NULL, 4096, NULL, uxTaskPriorityGet(NULL), NULL, 0);
+    while (received < MESSAGES)
+    {
+        xQueueReceive(queue, &msg, portMAX_DELAY);
+        TEST_ASSERT_EQUAL_FLOAT(received, msg.value[0]);
+        received++;
+    }
+    const int64_t queueUs = esp_timer_get_time() - start;
+
+    report("across cores", ringUs, queueUs);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void setup()
+{
+    delay(2000); /* give the serial monitor time to connect */
+
+    benchmarkTask = xTaskGetCurrentTaskHandle();
+    queue = xQueueCreate(QUEUE_LENGTH, sizeof(websocketMessage));
+
+    UNITY_BEGIN();
+    RUN_TEST(test_same_task);
+    RUN_TEST(test_across_cores);
+    UNITY_END();
+}
+
+void loop() { delay(1000); }
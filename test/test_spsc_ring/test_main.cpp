@@ -0,0 +1,156 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <unity.h>
+
+#include "lcdMessage.h"
+#include "websocketMessage.h"
+
+/* on the host a task handle is a counter of the notifications it got - see test/host/freertos/task.h */
+static tskTaskControlBlock consumer;
+
+void setUp() { consumer = {}; }
+void tearDown() {}
+
+void test_push_pop_across_wraparound()
+{
+    spscRing<uint32_t, 8> ring;
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+
+    /* uneven batches so head and tail wrap at different moments */
+    for (int round = 0; round < 1000; round++)
+    {
+        const int batch = 1 + round % 7;
+        for (int i = 0; i < batch; i++)
+            TEST_ASSERT_TRUE(ring.push(pushed++));
+        TEST_ASSERT_EQUAL(batch, ring.size());
+
+        uint32_t value;
+        while (ring.pop(value))
+            TEST_ASSERT_EQUAL_UINT32(popped++, value);
+    }
+    TEST_ASSERT_EQUAL_UINT32(pushed, popped);
+    TEST_ASSERT_EQUAL(0, ring.size());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.droppedItems());
+}
+
+void test_pop_from_empty_ring()
+{
+    lcdRing_t ring;
+    lcdMessage_t msg = {SET_BRIGHTNESS, {42}};
+    TEST_ASSERT_FALSE(ring.pop(msg));
+    TEST_ASSERT_EQUAL(SET_BRIGHTNESS, msg.type);
+    TEST_ASSERT_EQUAL_INT32(42, msg.int1);
+}
+
+void test_payload_is_copied()
+{
+    websocketRing_t ring;
+    websocketMessage msg = {LIGHT_UPDATE, 3, {}};
+    msg.value[0] = 1.5f;
+    msg.value[2] = 99.0f;
+    ring.push(msg);
+    msg.value[0] = 0;
+
+    websocketMessage received = {};
+    TEST_ASSERT_TRUE(ring.pop(received));
+    TEST_ASSERT_EQUAL(LIGHT_UPDATE, received.type);
+    TEST_ASSERT_EQUAL(3, received.count);
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, received.value[0]);
+    TEST_ASSERT_EQUAL_FLOAT(99.0f, received.value[2]);
+}
+
+void test_notify_only_when_ring_was_empty()
+{
+    lcdRing_t ring;
+    lcdMessage_t msg = {TEMPERATURE, {0}};
+
+    /* no consumer yet - nothing to notify */
+    ring.push(msg);
+    ring.pop(msg);
+
+    ring.setConsumer(&consumer);
+    ring.push(msg);
+    TEST_ASSERT_EQUAL_UINT32(1, consumer.notifications);
+
+    ring.push(msg);
+    ring.push(msg);
+    TEST_ASSERT_EQUAL_UINT32(1, consumer.notifications);
+
+    /* taking some but not all does not make the next push a wakeup */
+    ring.pop(msg);
+    ring.push(msg);
+    TEST_ASSERT_EQUAL_UINT32(1, consumer.notifications);
+
+    while (ring.pop(msg))
+        ;
+    ring.push(msg);
+    TEST_ASSERT_EQUAL_UINT32(2, consumer.notifications);
+
+    /* a push into a full ring is dropped and does not notify */
+    while (ring.push(msg))
+        ;
+    TEST_ASSERT_EQUAL_UINT32(2, consumer.notifications);
+}
+
+void test_full_ring_drops_and_counts()
+{
+    lcdRing_t ring;
+    ring.setConsumer(&consumer);
+
+    for (int32_t i = 0; i < int32_t(lcdRing_t::capacity()); i++)
+        TEST_ASSERT_TRUE(ring.push({SET_BRIGHTNESS, {i}}));
+    TEST_ASSERT_EQUAL(lcdRing_t::capacity(), ring.size());
+
+    TEST_ASSERT_FALSE(ring.push({SET_BRIGHTNESS, {100}}));
+    TEST_ASSERT_FALSE(ring.push({SET_BRIGHTNESS, {101}}));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.droppedItems());
+    TEST_ASSERT_EQUAL_UINT32(lcdRing_t::capacity(), ring.highWaterMark());
+    TEST_ASSERT_EQUAL(lcdRing_t::capacity(), ring.size());
+
+    /* the newest messages were dropped, the queued ones are intact */
+    lcdMessage_t msg;
+    TEST_ASSERT_TRUE(ring.pop(msg));
+    TEST_ASSERT_EQUAL_INT32(0, msg.int1);
+
+    /* room again */
+    TEST_ASSERT_TRUE(ring.push({SET_BRIGHTNESS, {102}}));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.droppedItems());
+
+    int32_t expected = 1;
+    while (ring.pop(msg) && expected < int32_t(lcdRing_t::capacity()))
+        TEST_ASSERT_EQUAL_INT32(expected++, msg.int1);
+    TEST_ASSERT_EQUAL_INT32(102, msg.int1);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_push_pop_across_wraparound);
+    RUN_TEST(test_pop_from_empty_ring);
+    RUN_TEST(test_payload_is_copied);
+    RUN_TEST(test_notify_only_when_ring_was_empty);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    return UNITY_END();
+}
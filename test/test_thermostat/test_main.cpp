@@ -0,0 +1,208 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <unity.h>
+
+#include "thermostat.h"
+
+/*
+    The controller against a simulated tank - 100 l of water, a 200 W heater or chiller, 10 W/K loss to the room,
+    a minute of lag in the element and half a minute in the sensor, read in the 1/16 °C steps of a DS18B20.
+*/
+
+static constexpr float HEAT_CAPACITY = 418600; /* J/K */
+static constexpr float LOSS = 10;              /* W/K */
+static constexpr float POWER = 200;            /* W */
+static constexpr uint32_t STEP_MS = 750;       /* a 12 bit conversion */
+static constexpr float SETTLED_BAND = 0.1f;    /* °C */
+
+struct run_t
+{
+    float overshoot;    /* °C past the setpoint, in the direction the output pushes */
+    float settledHours; /* the last time the tank was outside SETTLED_BAND */
+    float ripple;       /* peak to peak over the last 6 hours */
+    int switches; /* changes of the output */
+    uint32_t shortestOnMs;
+    uint32_t shortestOffMs;
+};
+
+void setUp() {}
+void tearDown() {}
+
+static run_t simulate(const thermostatConfig_t &config, const float start, const float room, const float hours)
+{
+    thermostat_t thermostat;
+    const float sign = config.cooling ? -1 : 1;
+    float water = start, element = 0, sensor = start;
+    float furthest = 0, lowest = 1e9f, highest = -1e9f;
+    run_t run = {0, 0, 0, 0, UINT32_MAX, UINT32_MAX};
+
+    float lastOutput = -1;
+    uint32_t switchedMs = 0;
+    const uint32_t steps = hours * 3600 * 1000 / STEP_MS;
+    for (uint32_t step = 0; step < steps; step++)
+    {
+        const uint32_t nowMs = step * STEP_MS;
+        const float output = thermostat.update(config, roundf(sensor * 16) / 16, true, nowMs);
+
+        if (lastOutput >= 0 && output != lastOutput)
+        {
+            /* the first period started with the simulation, not with a switch */
+            if (run.switches)
+            {
+                uint32_t &shortest = lastOutput ? run.shortestOnMs : run.shortestOffMs;
+                if (nowMs - switchedMs < shortest)
+                    shortest = nowMs - switchedMs;
+            }
+            run.switches++;
+            switchedMs = nowMs;
+        }
+        lastOutput = output;
+
+        const float dt = STEP_MS / 1000.0f;
+        element += (sign * output * POWER - element) * dt / 60;
+        water += (element - LOSS * (water - room)) / HEAT_CAPACITY * dt;
+        sensor += (water - sensor) * dt / 30;
+
+        furthest = fmaxf(furthest, sign * (water - config.setpoint));
+        if (fabsf(water - config.setpoint) > SETTLED_BAND)
+            run.settledHours = step * dt / 3600;
+        if (step * dt > (hours - 6) * 3600)
+        {
+            lowest = fminf(lowest, water);
+            highest = fmaxf(highest, water);
+        }
+    }
+    run.overshoot = furthest;
+    run.ripple = highest - lowest;
+
+    char message[96];
+    snprintf(message, sizeof(message), "overshoot %.3f °C, settled after %.2f h, ripple %.3f °C, %i switches", run.overshoot,
+             run.settledHours, run.ripple, run.switches);
+    TEST_MESSAGE(message);
+    return run;
+}
+
+static thermostatConfig_t configured(const thermostatMode mode, const thermostatOutput output)
+{
+    thermostatConfig_t config = DEFAULT_THERMOSTAT;
+    config.version = 1;
+    config.mode = mode;
+    config.output = output;
+    return config;
+}
+
+static void test_pid_pwm_settles()
+{
+    const run_t run = simulate(configured(THERMOSTAT_PID, THERMOSTAT_PWM), 22, 20, 24);
+    TEST_ASSERT_LESS_THAN(0.15f, run.overshoot);
+    TEST_ASSERT_LESS_THAN(3, run.settledHours);
+    TEST_ASSERT_LESS_THAN(0.05f, run.ripple);
+}
+
+/* after a water change the heater runs flat out for hours - the integral must not wind up meanwhile */
+static void test_pid_anti_windup()
+{
+    const run_t run = simulate(configured(THERMOSTAT_PID, THERMOSTAT_PWM), 15, 20, 24);
+    TEST_ASSERT_LESS_THAN(0.15f, run.overshoot);
+    TEST_ASSERT_LESS_THAN(6, run.settledHours);
+}
+
+static void test_pid_relay_settles()
+{
+    const thermostatConfig_t config = configured(THERMOSTAT_PID, THERMOSTAT_RELAY);
+    const run_t run = simulate(config, 22, 20, 24);
+    TEST_ASSERT_LESS_THAN(0.2f, run.overshoot);
+    TEST_ASSERT_LESS_THAN(3, run.settledHours);
+    TEST_ASSERT_LESS_THAN(2 * SETTLED_BAND, run.ripple);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(config.minOnMs, run.shortestOnMs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(config.minOffMs, run.shortestOffMs);
+}
+
+/* a short window asks for pulses shorter than the minimum times - the relay holds them out */
+static void test_relay_minimum_times()
+{
+    thermostatConfig_t config = configured(THERMOSTAT_PID, THERMOSTAT_RELAY);
+    config.windowMs = 120000;
+    config.minOnMs = 90000;
+    config.minOffMs = 45000;
+    const run_t run = simulate(config, 22, 20, 24);
+    TEST_ASSERT_GREATER_THAN(100, run.switches);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(config.minOnMs, run.shortestOnMs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(config.minOffMs, run.shortestOffMs);
+}
+
+static void test_hysteresis_band()
+{
+    const thermostatConfig_t config = configured(THERMOSTAT_HYSTERESIS, THERMOSTAT_RELAY);
+    const run_t run = simulate(config, 22, 20, 24);
+    /* the band plus what the lag of element and sensor carries past its edges */
+    TEST_ASSERT_LESS_THAN(config.hysteresis + 0.2f, run.ripple);
+    TEST_ASSERT_LESS_THAN(config.hysteresis / 2 + 0.2f, run.overshoot);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(config.minOnMs, run.shortestOnMs);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(config.minOffMs, run.shortestOffMs);
+}
+
+/* a chiller in a warm room - the same controller with the sign turned around */
+static void test_pid_cooling_settles()
+{
+    thermostatConfig_t config = configured(THERMOSTAT_PID, THERMOSTAT_PWM);
+    config.cooling = true;
+    config.setpoint = 24;
+    const run_t run = simulate(config, 27, 30, 24);
+    TEST_ASSERT_LESS_THAN(0.15f, run.overshoot);
+    TEST_ASSERT_LESS_THAN(4, run.settledHours);
+}
+
+/* a lost sensor drives the failsafe level at once - a relay does not wait out its minimum on time */
+static void test_failsafe_is_immediate()
+{
+    thermostatConfig_t config = configured(THERMOSTAT_HYSTERESIS, THERMOSTAT_RELAY);
+    config.failsafe = 0;
+    thermostat_t thermostat;
+    const uint32_t startMs = config.minOffMs; /* the relay counts as switched off at boot */
+
+    TEST_ASSERT_EQUAL_FLOAT(1, thermostat.update(config, 20, true, startMs));
+    TEST_ASSERT_EQUAL_FLOAT(0, thermostat.update(config, 20, false, startMs + STEP_MS));
+    TEST_ASSERT_TRUE(thermostat.failsafe());
+
+    /* and back under control once the sensor returns - now the minimum off time applies */
+    TEST_ASSERT_EQUAL_FLOAT(0, thermostat.update(config, 20, true, startMs + 2 * STEP_MS));
+    TEST_ASSERT_FALSE(thermostat.failsafe());
+    TEST_ASSERT_EQUAL_FLOAT(1, thermostat.update(config, 20, true, startMs + STEP_MS + config.minOffMs));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pid_pwm_settles);
+    RUN_TEST(test_pid_anti_windup);
+    RUN_TEST(test_pid_relay_settles);
+    RUN_TEST(test_relay_minimum_times);
+    RUN_TEST(test_hysteresis_band);
+    RUN_TEST(test_pid_cooling_settles);
+    RUN_TEST(test_failsafe_is_immediate);
+    return UNITY_END();
+}
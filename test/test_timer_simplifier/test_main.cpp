@@ -0,0 +1,218 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "segmentTable.h"
+#include "timerSimplifier.h"
+
+/* fidelity of the simplified schedule and the time it takes, on the largest import a channel can have */
+
+static constexpr float MAX_DUTY = 65535;
+
+static importList_t original;
+static importList_t simplified;
+static timerSimplifier<MAX_IMPORTED_TIMERS> simplifier;
+static segmentTable<MAX_IMPORTED_TIMERS> originalTable;
+static segmentTable<MAX_IMPORTED_TIMERS> simplifiedTable;
+
+static float linearDuty(const float percentage) { return percentage / 100 * MAX_DUTY; }
+static float gammaDuty(const float percentage) { return powf(percentage / 100, 2.2f) * MAX_DUTY; }
+
+/* a spreadsheet export - a point every 90 seconds on a sine shaped day, rounded to whole percent */
+static void sineDay()
+{
+    original.clear();
+    for (int time = 0; time < 86400; time += 90)
+    {
+        const float dayFraction = (time - 8 * 3600) / (12.0f * 3600);
+        const int percentage = dayFraction > 0 && dayFraction < 1 ? lroundf(100 * sinf(M_PI * dayFraction)) : 0;
+        original.push_back({time, percentage, 0, ANCHOR_MIDNIGHT});
+    }
+    original.push_back({86400, original.front().percentage, 0, ANCHOR_MIDNIGHT});
+}
+
+static void randomWalk()
+{
+    original.clear();
+    int percentage = 50;
+    for (int i = 0; i < int(MAX_IMPORTED_TIMERS) - 1; i++)
+    {
+        percentage += rand() % 7 - 3;
+        percentage = percentage < 0 ? 0 : percentage > 100 ? 100 : percentage;
+        original.push_back({i * 84, percentage, 0, ANCHOR_MIDNIGHT});
+    }
+    original.push_back({86400, original.front().percentage, 0, ANCHOR_MIDNIGHT});
+}
+
+/* the largest difference in PWM steps between both schedules, every second of the day */
+static float measuredError()
+{
+    originalTable.compile(original.data(), original.size());
+    simplifiedTable.compile(simplified.data(), simplified.size());
+
+    float worst = 0;
+    for (uint32_t second = 0; second < 86400; second++)
+    {
+        const float error = fabsf(linearDuty(originalTable.levelAt(second * 1000)) - linearDuty(simplifiedTable.levelAt(second * 1000)));
+        if (error > worst)
+            worst = error;
+    }
+    return worst;
+}
+
+static void checkTolerance(const float tolerance)
+{
+    simplified = original;
+    const simplifyResult_t result = simplifier.simplify(simplified, tolerance, linearDuty);
+
+    char message[96];
+    snprintf(message, sizeof(message), "tolerance %.0f: %u -> %u timers, max error %.1f steps",
+             tolerance, unsigned(original.size()), unsigned(simplified.size()), result.maxError);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL(original.size() - simplified.size(), result.removed);
+    TEST_ASSERT_EQUAL(original.front().time, simplified.front().time);
+    TEST_ASSERT_EQUAL(original.back().time, simplified.back().time);
+    TEST_ASSERT_EQUAL(original.back().percentage, simplified.back().percentage);
+
+    TEST_ASSERT_LESS_OR_EQUAL(tolerance + 0.01f, result.maxError);
+    const float measured = measuredError();
+    TEST_ASSERT_LESS_OR_EQUAL(tolerance + 0.01f, measured);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, result.maxError, measured);
+
+    for (size_t i = 1; i < simplified.size(); i++)
+        TEST_ASSERT_LESS_THAN(simplified[i].time, simplified[i - 1].time);
+}
+
+void setUp() { srand(7); }
+void tearDown() {}
+
+void test_zero_tolerance_drops_only_points_on_the_line()
+{
+    sineDay();
+    checkTolerance(0);
+    TEST_ASSERT_LESS_THAN(original.size() / 2, simplified.size());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0, measuredError());
+}
+
+void test_fidelity_sine_day()
+{
+    sineDay();
+    for (const float tolerance : {1.0f, 10.0f, 100.0f, 328.0f, 3000.0f})
+        checkTolerance(tolerance);
+}
+
+void test_fidelity_random_walk()
+{
+    randomWalk();
+    for (const float tolerance : {0.0f, 100.0f, 655.0f})
+        checkTolerance(tolerance);
+}
+
+/* the error is measured on the curve of the channel - a steep gamma curve keeps more timers at the top */
+void test_gamma_curve()
+{
+    sineDay();
+    simplified = original;
+    const simplifyResult_t result = simplifier.simplify(simplified, 100, gammaDuty);
+    TEST_ASSERT_LESS_OR_EQUAL(100.01f, result.maxError);
+
+    importList_t linear = original;
+    simplifier.simplify(linear, 100, linearDuty);
+    TEST_ASSERT_NOT_EQUAL(linear.size(), simplified.size());
+}
+
+void test_sun_timers_are_kept()
+{
+    original.clear();
+    original.push_back({0, 0, 0, ANCHOR_MIDNIGHT});
+    original.push_back({20000, 20, -1800, ANCHOR_SUNRISE});
+    original.push_back({30000, 30, 0, ANCHOR_MIDNIGHT});
+    original.push_back({40000, 40, 0, ANCHOR_MIDNIGHT});
+    original.push_back({70000, 0, 3600, ANCHOR_SUNSET});
+    original.push_back({86400, 0, 0, ANCHOR_MIDNIGHT});
+
+    simplified = original;
+    const simplifyResult_t result = simplifier.simplify(simplified, 1, linearDuty);
+
+    /* 30000 is on the line from the sunrise timer to 40000 */
+    TEST_ASSERT_EQUAL(1, result.removed);
+    TEST_ASSERT_EQUAL(ANCHOR_SUNRISE, simplified[1].anchor);
+    TEST_ASSERT_EQUAL(-1800, simplified[1].offset);
+    TEST_ASSERT_EQUAL(40000, simplified[2].time);
+    TEST_ASSERT_EQUAL(ANCHOR_SUNSET, simplified[3].anchor);
+}
+
+void test_short_lists_are_untouched()
+{
+    original.clear();
+    original.push_back({0, 10, 0, ANCHOR_MIDNIGHT});
+    original.push_back({86400, 10, 0, ANCHOR_MIDNIGHT});
+    simplified = original;
+    const simplifyResult_t result = simplifier.simplify(simplified, 1000, linearDuty);
+    TEST_ASSERT_EQUAL(0, result.removed);
+    TEST_ASSERT_EQUAL(2, simplified.size());
+}
+
+void test_benchmark()
+{
+    static constexpr int RUNS = 200;
+    randomWalk();
+
+    double worstUs = 0;
+    double totalUs = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+        simplified = original;
+        const auto start = std::chrono::steady_clock::now();
+        simplifier.simplify(simplified, 100, gammaDuty);
+        const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        totalUs += us;
+        worstUs = us > worstUs ? us : worstUs;
+    }
+
+    char message[96];
+    snprintf(message, sizeof(message), "%u timers with a gamma curve: %.0f us average, %.0f us worst",
+             unsigned(original.size()), totalUs / RUNS, worstUs);
+    TEST_MESSAGE(message);
+
+    /* generous for a slow host - it is well under a millisecond on a desktop */
+    TEST_ASSERT_LESS_THAN(20000.0, totalUs / RUNS);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_zero_tolerance_drops_only_points_on_the_line);
+    RUN_TEST(test_fidelity_sine_day);
+    RUN_TEST(test_fidelity_random_walk);
+    RUN_TEST(test_gamma_curve);
+    RUN_TEST(test_sun_timers_are_kept);
+    RUN_TEST(test_short_lists_are_untouched);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,139 @@
+/*
+MIT License
+
+Copyright (c) 2025 Cellie https://github.com/CelliesProjects/aquacontrol32-pio/
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <string.h>
+#include <unity.h>
+
+#include "weatherEffects.h"
+
+/*
+    Seeded replay of the weather effects.
+    The golden values were recorded once - any change to the noise, the hash or the flash timing breaks them.
+*/
+
+static weatherEffect_t fx;
+static constexpr uint32_t DAY = 20000;
+static constexpr float LEVEL = 50.0f;
+
+static uint32_t bits(const float value)
+{
+    uint32_t result;
+    memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+/* FNV-1a over every 10 ms tick from 06:50 to 07:50 - the flicker window, clouds and some lightning */
+static uint32_t replayHour(const uint32_t day, uint32_t &flashTicks)
+{
+    uint32_t hash = 2166136261UL;
+    flashTicks = 0;
+    for (uint32_t ms = (6 * 3600 + 50 * 60) * 1000UL; ms < (7 * 3600 + 50 * 60) * 1000UL; ms += weather::FLASH_RESOLUTION_MS)
+    {
+        const float level = weather::apply(fx, day, LEVEL, ms);
+        hash = (hash ^ bits(level)) * 16777619UL;
+        flashTicks += level == fx.lightningLevel;
+    }
+    return hash;
+}
+
+void setUp()
+{
+    fx = {};
+    fx.seed = 0xC0FFEE;
+    fx.cloudDepth = 60;
+    fx.cloudPeriodSec = 300;
+    fx.lightningPerHour = 120;
+    fx.lightningLevel = 90;
+    fx.flickerDepth = 30;
+    fx.flickerFromSec = 7 * 3600;
+    fx.flickerToSec = 7 * 3600 + 1800;
+}
+
+void tearDown() {}
+
+void test_golden_levels()
+{
+    TEST_ASSERT_EQUAL_HEX32(0x42480000, bits(weather::apply(fx, DAY, LEVEL, 0)));
+    TEST_ASSERT_EQUAL_HEX32(0x42347800, bits(weather::apply(fx, DAY, LEVEL, 25212345)));
+    TEST_ASSERT_EQUAL_HEX32(0x424198f0, bits(weather::apply(fx, DAY, LEVEL, 26100000)));
+    TEST_ASSERT_EQUAL_HEX32(0x421caa40, bits(weather::apply(fx, DAY, LEVEL, 54123456)));
+    TEST_ASSERT_EQUAL_HEX32(0x421b2dc8, bits(weather::apply(fx, DAY, LEVEL, 86399990)));
+}
+
+void test_golden_factors()
+{
+    const uint32_t seed = weather::hash(fx.seed, DAY);
+    TEST_ASSERT_EQUAL_UINT32(51336, weather::cloudFactor(fx, seed, 54123456));
+    TEST_ASSERT_EQUAL_UINT32(59136, weather::flickerFactor(fx, seed, 25212345));
+    TEST_ASSERT_EQUAL_UINT32(weather::Q16_ONE, weather::flickerFactor(fx, seed, 54123456)); /* outside the window */
+}
+
+void test_golden_lightning()
+{
+    TEST_ASSERT_EQUAL_HEX32(0x42b40000, bits(weather::apply(fx, DAY, LEVEL, 43213500)));
+    TEST_ASSERT_EQUAL_HEX32(0x42b40000, bits(weather::apply(fx, DAY, LEVEL, 43237540)));
+    TEST_ASSERT_EQUAL_HEX32(0x42b40000, bits(weather::apply(fx, DAY, LEVEL, 43273600)));
+    TEST_ASSERT_EQUAL_HEX32(0x42480000, bits(weather::apply(fx, DAY, LEVEL, 43200010)));
+}
+
+void test_replay_hour()
+{
+    uint32_t flashTicks;
+    TEST_ASSERT_EQUAL_HEX32(0xed92ea15, replayHour(DAY, flashTicks));
+    TEST_ASSERT_EQUAL_UINT32(1389, flashTicks);
+
+    /* the next day has different weather */
+    TEST_ASSERT_EQUAL_HEX32(0x0cf5b01d, replayHour(DAY + 1, flashTicks));
+    TEST_ASSERT_EQUAL_UINT32(934, flashTicks);
+}
+
+void test_replay_is_stateless()
+{
+    /* evaluating out of order gives the same result as in order */
+    const float later = weather::apply(fx, DAY, LEVEL, 54123456);
+    weather::apply(fx, DAY, LEVEL, 1000);
+    TEST_ASSERT_EQUAL_HEX32(bits(later), bits(weather::apply(fx, DAY, LEVEL, 54123456)));
+}
+
+void test_disabled_effects_pass_through()
+{
+    weatherEffectLayer<MAX_CHANNELS> layer;
+    layer.day = DAY;
+    TEST_ASSERT_FALSE(layer.effect[0].enabled());
+    TEST_ASSERT_EQUAL_HEX32(bits(12.5f), bits(layer.apply(0, 12.5f, 54123456, 0)));
+
+    layer.effect[0] = fx;
+    TEST_ASSERT_EQUAL_HEX32(0x421caa40, bits(layer.apply(0, LEVEL, 54123456, 0)));
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_golden_levels);
+    RUN_TEST(test_golden_factors);
+    RUN_TEST(test_golden_lightning);
+    RUN_TEST(test_replay_hour);
+    RUN_TEST(test_replay_is_stateless);
+    RUN_TEST(test_disabled_effects_pass_through);
+    return UNITY_END();
+}